@@ -0,0 +1,240 @@
+//
+// coordinator.c
+//
+
+#include "coordinator.h"
+#include "util_fns.h"
+
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+//
+// Each message:  magic[4] type length (uint32_t each), then length bytes of
+// payload.  Nothing legitimate comes close to the size limit; it just keeps
+// a stray connection from making us allocate gigabytes:
+//
+#define COORDINATOR_MSG_MAGIC           "URLC"
+#define COORDINATOR_MSG_HEADER_LENGTH   12
+#define COORDINATOR_MSG_MAX_LENGTH      (1U << 30)
+
+#define COORDINATOR_ASSIGN_LENGTH       (4 * sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(double) + sizeof(uint64_t))
+
+enum {
+  coordinator_assign_flags_shuffle = 1 << 0
+};
+
+//
+
+static int
+__coordinator_socket(
+  const char        *address,
+  bool              is_listen
+)
+{
+  const char        *port;
+  char              *host = split_host_port(address, &port);
+  struct addrinfo   hints, *addrs = NULL, *a;
+  int               fd = -1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if ( is_listen ) hints.ai_flags = AI_PASSIVE;
+  if ( host && ! *host ) {
+    free((void*)host);
+    host = NULL;
+  }
+  // Without a host, listen on every interface (connect to the loopback):
+  if ( getaddrinfo(host ? host : (is_listen ? NULL : "127.0.0.1"), port, &hints, &addrs) != 0 ) {
+    if ( host ) free((void*)host);
+    errno = EINVAL;
+    return -1;
+  }
+  for ( a = addrs; a; a = a->ai_next ) {
+    int             on = 1;
+
+    if ( (fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol)) < 0 ) continue;
+    if ( is_listen ) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if ( (bind(fd, a->ai_addr, a->ai_addrlen) == 0) && (listen(fd, 128) == 0) ) break;
+    } else if ( connect(fd, a->ai_addr, a->ai_addrlen) == 0 ) {
+      // Messages are small and each one is waited on:
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  if ( host ) free((void*)host);
+  return fd;
+}
+
+//
+
+int
+coordinator_listen(
+  const char    *address
+)
+{
+  return __coordinator_socket(address, true);
+}
+
+//
+
+int
+coordinator_connect(
+  const char    *address
+)
+{
+  return __coordinator_socket(address, false);
+}
+
+//
+
+static bool
+__coordinator_write_all(
+  int           fd,
+  const uint8_t *bytes,
+  size_t        length
+)
+{
+  while ( length ) {
+    ssize_t     n = send(fd, bytes, length, MSG_NOSIGNAL);
+
+    if ( n < 0 ) {
+      if ( errno == EINTR ) continue;
+      return false;
+    }
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+//
+
+static bool
+__coordinator_read_all(
+  int           fd,
+  uint8_t       *bytes,
+  size_t        length
+)
+{
+  while ( length ) {
+    ssize_t     n = recv(fd, bytes, length, 0);
+
+    if ( n < 0 ) {
+      if ( errno == EINTR ) continue;
+      return false;
+    }
+    if ( n == 0 ) return false;
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+//
+
+bool
+coordinator_send(
+  int             fd,
+  coordinator_msg type,
+  const void      *payload,
+  size_t          length
+)
+{
+  uint8_t         header[COORDINATOR_MSG_HEADER_LENGTH];
+
+  if ( length > COORDINATOR_MSG_MAX_LENGTH ) return false;
+  memcpy(header, COORDINATOR_MSG_MAGIC, 4);
+  le_put_u32(le_put_u32(header + 4, type), (uint32_t)length);
+  return __coordinator_write_all(fd, header, sizeof(header)) && (! length || __coordinator_write_all(fd, (const uint8_t*)payload, length));
+}
+
+//
+
+bool
+coordinator_recv(
+  int             fd,
+  coordinator_msg *type,
+  void*           *payload,
+  size_t          *length
+)
+{
+  uint8_t         header[COORDINATOR_MSG_HEADER_LENGTH];
+  const uint8_t   *p = header + 4;
+  uint32_t        msg_type, msg_length;
+  uint8_t         *bytes = NULL;
+
+  if ( ! __coordinator_read_all(fd, header, sizeof(header)) || memcmp(header, COORDINATOR_MSG_MAGIC, 4) ) return false;
+  msg_type = le_get_u32(&p);
+  msg_length = le_get_u32(&p);
+  if ( (msg_type < coordinator_msg_hello) || (msg_type >= coordinator_msg_max) || (msg_length > COORDINATOR_MSG_MAX_LENGTH) ) return false;
+  if ( msg_length ) {
+    if ( ! (bytes = malloc(msg_length)) ) return false;
+    if ( ! __coordinator_read_all(fd, bytes, msg_length) ) {
+      free((void*)bytes);
+      return false;
+    }
+  }
+  *type = (coordinator_msg)msg_type;
+  *payload = bytes;
+  *length = msg_length;
+  return true;
+}
+
+//
+
+void*
+coordinator_assignment_encode(
+  const coordinator_assignment  *assignment,
+  size_t                        *length
+)
+{
+  size_t                        n_bytes = COORDINATOR_ASSIGN_LENGTH + assignment->urls_len;
+  uint8_t                       *payload = malloc(n_bytes), *p;
+
+  if ( payload ) {
+    p = le_put_u32(payload, COORDINATOR_PROTOCOL_VERSION);
+    p = le_put_u32(p, assignment->agent_id);
+    p = le_put_u32(p, assignment->n_agents);
+    p = le_put_u32(p, assignment->should_shuffle ? coordinator_assign_flags_shuffle : 0);
+    p = le_put_u64(p, assignment->seed);
+    p = le_put_double(p, assignment->start_time);
+    p = le_put_double(p, assignment->report_interval);
+    p = le_put_u64(p, assignment->urls_len);
+    if ( assignment->urls_len ) memcpy(p, assignment->urls, assignment->urls_len);
+    *length = n_bytes;
+  }
+  return payload;
+}
+
+//
+
+bool
+coordinator_assignment_decode(
+  const void              *payload,
+  size_t                  length,
+  coordinator_assignment  *assignment
+)
+{
+  const uint8_t           *p = (const uint8_t*)payload;
+
+  if ( length < COORDINATOR_ASSIGN_LENGTH ) return false;
+  if ( le_get_u32(&p) != COORDINATOR_PROTOCOL_VERSION ) return false;
+  assignment->agent_id = le_get_u32(&p);
+  assignment->n_agents = le_get_u32(&p);
+  assignment->should_shuffle = (le_get_u32(&p) & coordinator_assign_flags_shuffle) ? true : false;
+  assignment->seed = le_get_u64(&p);
+  assignment->start_time = le_get_double(&p);
+  assignment->report_interval = le_get_double(&p);
+  assignment->urls_len = le_get_u64(&p);
+  if ( assignment->urls_len != length - COORDINATOR_ASSIGN_LENGTH ) return false;
+  assignment->urls = (const char*)p;
+  return true;
+}
@@ -0,0 +1,71 @@
+//
+// coordinator.h
+//
+// The wire protocol between a coordinating urltest_getlist and the agents
+// that do the actual fetching:  length-prefixed messages over a TCP stream,
+// every field little-endian so agents and coordinator need not share a
+// byte order.
+//
+//   agent                              coordinator
+//     hello                  ->
+//                            <-          assign (shard of the url list, seed,
+//                                        start time, report interval)
+//     stats  (every interval) ->         cumulative http_stats snapshot
+//     final                  ->          the run's http_stats snapshot
+//
+
+#ifndef __COORDINATOR_H__
+#define __COORDINATOR_H__
+
+#include "config.h"
+
+#define COORDINATOR_PROTOCOL_VERSION    1
+
+typedef enum {
+  coordinator_msg_hello = 1,
+  coordinator_msg_assign,
+  coordinator_msg_stats,
+  coordinator_msg_final,
+  //
+  coordinator_msg_max
+} coordinator_msg;
+
+//
+// An agent's share of the run.  The URLs are the agent's shard of the list,
+// one per line; start_time is on the wall clock (seconds since the epoch) so
+// agents on different hosts begin together, provided their clocks agree:
+//
+typedef struct {
+  uint32_t        agent_id, n_agents;
+  uint64_t        seed;
+  bool            should_shuffle;
+  double          start_time;
+  double          report_interval;
+  const char      *urls;
+  size_t          urls_len;
+} coordinator_assignment;
+
+//
+// Addresses are <host>:<port> (an IPv6 host in brackets); the coordinator's
+// host may be omitted to listen on every interface.  Both return a socket, or
+// -1 with errno set:
+//
+int coordinator_listen(const char *address);
+int coordinator_connect(const char *address);
+
+bool coordinator_send(int fd, coordinator_msg type, const void *payload, size_t length);
+
+//
+// Blocks until a whole message arrives; the payload is malloc'd (NULL if it
+// is empty) and belongs to the caller.  False at end of stream or on error:
+//
+bool coordinator_recv(int fd, coordinator_msg *type, void* *payload, size_t *length);
+
+void* coordinator_assignment_encode(const coordinator_assignment *assignment, size_t *length);
+
+//
+// The decoded URLs point into payload, which must outlive the assignment:
+//
+bool coordinator_assignment_decode(const void *payload, size_t length, coordinator_assignment *assignment);
+
+#endif /* __COORDINATOR_H__ */
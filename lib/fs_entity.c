@@ -6,7 +6,13 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <fts.h>
+#ifdef HAVE_STATX
+# include <sys/sysmacros.h>
+#endif
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
 
 #include "util_fns.h"
 
@@ -54,235 +60,1385 @@ __fs_entity_state_to_token(
 
 //
 
-fs_entity*
-__fs_entity_create(
-  fs_entity_kind  kind,
-  const char      *path
+static inline fs_entity*
+__fs_entity_child(
+  fs_entity_list          *the_list,
+  fs_entity               *entity
 )
 {
-  fs_entity       *new_entity = NULL;
+  return (entity->child == FS_ENTITY_INDEX_NONE) ? NULL : &the_list->root_entity[entity->child];
+}
+
+//
+
+static inline fs_entity*
+__fs_entity_sibling(
+  fs_entity_list          *the_list,
+  fs_entity               *entity
+)
+{
+  return (entity->sibling == FS_ENTITY_INDEX_NONE) ? NULL : &the_list->root_entity[entity->sibling];
+}
+
+//
+// Names are interned while the tree is built:  each distinct name is stored
+// once in the list's name arena and nodes refer to it by offset.  The hash
+// table used to find duplicates is only needed during the build.
+//
+
+typedef struct {
+  fs_entity_list  *the_list;
+  unsigned int    capacity;
+  size_t          names_capacity;
+  unsigned int    *intern_table;
+  unsigned int    intern_size, intern_count;
+  //
+  // Most recent child of each directory on the current path, indexed by depth:
+  //
+  unsigned int    *last_child;
+  unsigned int    last_child_capacity;
+} fs_entity_builder;
+
+#define FS_ENTITY_BUILDER_INITIAL_CAPACITY  1024
+
+//
+
+static inline uint32_t
+__fs_entity_name_hash(
+  const char      *name,
+  size_t          name_len
+)
+{
+  uint32_t        h = 0x811C9DC5;
   
-  if ( path && *path && (kind >= fs_entity_kind_directory) && (kind < fs_entity_kind_max) ) {
-    size_t        path_len = strlen(path) + 1;
+  while ( name_len-- ) {
+    h ^= (uint8_t)*name++;
+    h *= 0x01000193;
+  }
+  return h;
+}
+
+//
+
+bool
+__fs_entity_builder_intern(
+  fs_entity_builder *builder,
+  const char        *name,
+  size_t            name_len,
+  unsigned int      *offset
+)
+{
+  fs_entity_list    *the_list = builder->the_list;
+  unsigned int      i;
+  
+  //
+  // Keep the table at most half full:
+  //
+  if ( 2 * (builder->intern_count + 1) > builder->intern_size ) {
+    unsigned int    new_size = builder->intern_size ? 2 * builder->intern_size : 4096;
+    unsigned int    *new_table = malloc(new_size * sizeof(unsigned int));
     
-    new_entity = malloc(sizeof(fs_entity) + path_len);
-    if ( new_entity ) {
-      http_ops_method								i_m;
+    if ( ! new_table ) return false;
+    memset(new_table, 0xFF, new_size * sizeof(unsigned int));
+    for ( i = 0; i < builder->intern_size; i++ ) {
+      unsigned int  o = builder->intern_table[i];
       
-      new_entity->kind              = kind;
-      new_entity->generation        = 0;
-      new_entity->size              = 0;
-      new_entity->state             = fs_entity_state_upload;
-      new_entity->disabled_states   = 0;
-      new_entity->sibling           = NULL;
-      new_entity->child             = NULL;
+      if ( o != FS_ENTITY_INDEX_NONE ) {
+        const char  *n = the_list->names + o;
+        unsigned int j = __fs_entity_name_hash(n, strlen(n)) & (new_size - 1);
+        
+        while ( new_table[j] != FS_ENTITY_INDEX_NONE ) j = (j + 1) & (new_size - 1);
+        new_table[j] = o;
+      }
+    }
+    if ( builder->intern_table ) free((void*)builder->intern_table);
+    builder->intern_table = new_table;
+    builder->intern_size = new_size;
+  }
+  
+  i = __fs_entity_name_hash(name, name_len) & (builder->intern_size - 1);
+  while ( builder->intern_table[i] != FS_ENTITY_INDEX_NONE ) {
+    const char      *n = the_list->names + builder->intern_table[i];
+    
+    if ( (strncmp(n, name, name_len) == 0) && (n[name_len] == '\0') ) {
+      *offset = builder->intern_table[i];
+      return true;
+    }
+    i = (i + 1) & (builder->intern_size - 1);
+  }
+  
+  //
+  // Not seen before, add it to the arena:
+  //
+  if ( the_list->names_len + name_len + 1 > builder->names_capacity ) {
+    size_t          new_capacity = builder->names_capacity ? 2 * builder->names_capacity : 65536;
+    char            *new_names;
+    
+    while ( the_list->names_len + name_len + 1 > new_capacity ) new_capacity *= 2;
+    if ( ! (new_names = realloc(the_list->names, new_capacity)) ) return false;
+    the_list->names = new_names;
+    builder->names_capacity = new_capacity;
+  }
+  memcpy(the_list->names + the_list->names_len, name, name_len);
+  the_list->names[the_list->names_len + name_len] = '\0';
+  *offset = builder->intern_table[i] = the_list->names_len;
+  the_list->names_len += name_len + 1;
+  builder->intern_count++;
+  return true;
+}
+
+//
+
+unsigned int
+__fs_entity_builder_append(
+  fs_entity_builder *builder,
+  fs_entity_kind    kind,
+  const char        *path,
+  size_t            size,
+  unsigned int      depth
+)
+{
+  fs_entity_list    *the_list = builder->the_list;
+  const char        *name = strrchr(path, '/');
+  unsigned int      name_offset, idx;
+  fs_entity         *new_entity;
+  
+  name = name ? (name + 1) : path;
+  if ( ! __fs_entity_builder_intern(builder, name, strlen(name), &name_offset) ) return FS_ENTITY_INDEX_NONE;
+  
+  if ( the_list->count == builder->capacity ) {
+    unsigned int    new_capacity = builder->capacity ? 2 * builder->capacity : FS_ENTITY_BUILDER_INITIAL_CAPACITY;
+    fs_entity       *new_nodes = realloc(the_list->root_entity, new_capacity * sizeof(fs_entity));
+    
+    if ( ! new_nodes ) return FS_ENTITY_INDEX_NONE;
+    the_list->root_entity = new_nodes;
+    builder->capacity = new_capacity;
+  }
+  if ( depth + 1 >= builder->last_child_capacity ) {
+    unsigned int    new_capacity = builder->last_child_capacity ? 2 * builder->last_child_capacity : 64;
+    unsigned int    *new_last_child = realloc(builder->last_child, new_capacity * sizeof(unsigned int));
+    
+    if ( ! new_last_child ) return FS_ENTITY_INDEX_NONE;
+    builder->last_child = new_last_child;
+    builder->last_child_capacity = new_capacity;
+  }
+  
+  idx = the_list->count++;
+  new_entity = &the_list->root_entity[idx];
+  new_entity->kind              = kind;
+  new_entity->generation        = 0;
+  new_entity->size              = size;
+  new_entity->state             = fs_entity_state_upload;
+  new_entity->disabled_states   = 0;
+  new_entity->is_busy           = false;
+  new_entity->name              = name_offset;
+  new_entity->parent            = FS_ENTITY_INDEX_NONE;
+  new_entity->child             = FS_ENTITY_INDEX_NONE;
+  new_entity->sibling           = FS_ENTITY_INDEX_NONE;
+  new_entity->child_count       = 0;
+  new_entity->min_generation    = 0;
+  new_entity->min_count         = 0;
+  new_entity->cursor            = FS_ENTITY_INDEX_NONE;
+  new_entity->cursor_generation = FS_ENTITY_INDEX_NONE;
+  
+  // Stats are allocated on first use:
+  new_entity->http_stats        = NULL;
+  
+  //
+  // Link to the parent directory (the node most recently opened one level up):
+  //
+  if ( depth > 0 ) {
+    unsigned int    parent = builder->last_child[depth - 1];
+    unsigned int    prev = builder->last_child[depth];
+    
+    new_entity->parent = parent;
+    the_list->root_entity[parent].child_count++;
+    the_list->root_entity[parent].min_count++;
+    if ( prev != FS_ENTITY_INDEX_NONE && the_list->root_entity[prev].parent == parent ) {
+      the_list->root_entity[prev].sibling = idx;
+    } else {
+      the_list->root_entity[parent].child = idx;
+    }
+  }
+  builder->last_child[depth] = idx;
+  builder->last_child[depth + 1] = FS_ENTITY_INDEX_NONE;
+  return idx;
+}
+
+//
+
+//
+// Directories are read by a pool of threads pulling from a shared work
+// queue; each directory's entries are collected in the order the filesystem
+// returns them (the same order fts would) and the node array is assembled
+// afterwards by a depth-first walk of the results.
+//
+// With a scan index the previous scan's results come along as hints:  a
+// directory whose mtime still matches its index record gets its entries from
+// the index rather than from the filesystem.
+//
+
+typedef struct __fs_entity_scan_dir fs_entity_scan_dir;
+
+typedef struct {
+  fs_entity_kind        kind;
+  bool                  is_cycle;
+  uint64_t              size;
+  int64_t               mtime_sec;
+  uint32_t              mtime_nsec;
+  unsigned int          name;
+  fs_entity_scan_dir    *dir;
+} fs_entity_scan_entry;
+
+//
+// On-disk layout of a scan index:  the header, then one record per entry in
+// depth-first order (the root first), then the root path and the name arena.
+// Each record's next is the index of the record following its subtree, so a
+// directory's children are the records from i + 1 up to its next, hopping by
+// their own next.  Native byte order, it's not meant to move between hosts.
+//
+
+#define FS_ENTITY_INDEX_MAGIC     "urltsidx"
+#define FS_ENTITY_INDEX_VERSION   1
+
+typedef struct {
+  char                  magic[8];
+  uint32_t              version;
+  uint32_t              count;
+  uint64_t              root_path_len;
+  uint64_t              names_len;
+} fs_entity_index_header;
+
+typedef struct {
+  uint64_t              size;
+  uint64_t              dev, ino;
+  int64_t               mtime_sec;
+  uint32_t              mtime_nsec;
+  uint32_t              name;
+  uint32_t              next;
+  uint8_t               kind;
+  uint8_t               is_cycle;
+  uint8_t               reserved[2];
+} fs_entity_index_record;
+
+typedef struct {
+  void                          *base;
+  size_t                        length;
+  const fs_entity_index_record  *records;
+  uint32_t                      count;
+  const char                    *names;
+} fs_entity_index;
+
+struct __fs_entity_scan_dir {
+  char                          *path;
+  uint64_t                      dev, ino;
+  int64_t                       mtime_sec;
+  uint32_t                      mtime_nsec;
+  bool                          has_mtime;
+  const fs_entity_index_record  *hint, *hint_cursor;
+  fs_entity_scan_dir            *parent;
+  fs_entity_scan_dir            *next_queued;
+  fs_entity_scan_entry          *entries;
+  unsigned int                  count, capacity;
+  char                          *names;
+  size_t                        names_len, names_capacity;
+};
+
+typedef struct {
+  pthread_mutex_t       lock;
+  pthread_cond_t        queued;
+  fs_entity_scan_dir    *queue;
+  unsigned int          pending;
+  bool                  is_failed;
+  bool                  is_changed;
+  fs_entity_index       *index;
+} fs_entity_scanner;
+
+typedef struct {
+  mode_t                mode;
+  uint64_t              size, dev, ino;
+  int64_t               mtime_sec;
+  uint32_t              mtime_nsec;
+} fs_entity_scan_info;
+
+#define FS_ENTITY_SCAN_MAX_THREADS    256
+#define FS_ENTITY_SCAN_BUFFER_SIZE    32768
+
+//
+
+bool
+__fs_entity_scan_stat(
+  int                   dir_fd,
+  const char            *name,
+  fs_entity_scan_info   *info
+)
+{
+  //
+  // Symlinks are followed (as with FTS_LOGICAL):
+  //
+#ifdef HAVE_STATX
+  struct statx          finfo;
+  
+  if ( statx(dir_fd, name, AT_STATX_SYNC_AS_STAT, STATX_TYPE | STATX_SIZE | STATX_INO | STATX_MTIME, &finfo) != 0 ) return false;
+  info->mode = finfo.stx_mode;
+  info->size = finfo.stx_size;
+  info->dev = makedev(finfo.stx_dev_major, finfo.stx_dev_minor);
+  info->ino = finfo.stx_ino;
+  info->mtime_sec = finfo.stx_mtime.tv_sec;
+  info->mtime_nsec = finfo.stx_mtime.tv_nsec;
+#else
+  struct stat           finfo;
+  
+  if ( fstatat(dir_fd, name, &finfo, 0) != 0 ) return false;
+  info->mode = finfo.st_mode;
+  info->size = finfo.st_size;
+  info->dev = finfo.st_dev;
+  info->ino = finfo.st_ino;
+  info->mtime_sec = finfo.st_mtime;
+  info->mtime_nsec = 0;
+#endif
+  return true;
+}
+
+//
+
+fs_entity_scan_dir*
+__fs_entity_scan_dir_create(
+  fs_entity_scan_dir            *parent,
+  const char                    *path,
+  const char                    *name,
+  uint64_t                      dev,
+  uint64_t                      ino,
+  const fs_entity_index_record  *hint
+)
+{
+  fs_entity_scan_dir    *new_dir = malloc(sizeof(fs_entity_scan_dir));
+  
+  if ( new_dir ) {
+    memset(new_dir, 0, sizeof(fs_entity_scan_dir));
+    if ( name ) {
+      size_t            path_len = strlen(path), name_len = strlen(name);
       
-      for ( i_m = http_ops_method_get; i_m < http_ops_method_max; i_m++ )
-      	new_entity->http_stats[i_m] = http_stats_create();
+      // Same as fts, a trailing slash on the parent isn't doubled:
+      if ( path_len && (path[path_len - 1] == '/') ) path_len--;
+      if ( (new_dir->path = malloc(path_len + 1 + name_len + 1)) ) {
+        memcpy(new_dir->path, path, path_len);
+        new_dir->path[path_len] = '/';
+        memcpy(new_dir->path + path_len + 1, name, name_len + 1);
+      }
+    } else {
+      new_dir->path = strdup(path);
+    }
+    if ( ! new_dir->path ) {
+      free((void*)new_dir);
+      return NULL;
+    }
+    new_dir->dev = dev;
+    new_dir->ino = ino;
+    new_dir->hint = hint;
+    new_dir->parent = parent;
+  }
+  return new_dir;
+}
+
+//
+
+void
+__fs_entity_scan_dir_destroy(
+  fs_entity_scan_dir    *dir
+)
+{
+  unsigned int          i;
+  
+  for ( i = 0; i < dir->count; i++ ) {
+    if ( dir->entries[i].dir ) __fs_entity_scan_dir_destroy(dir->entries[i].dir);
+  }
+  if ( dir->entries ) free((void*)dir->entries);
+  if ( dir->names ) free((void*)dir->names);
+  free((void*)dir->path);
+  free((void*)dir);
+}
+
+//
+
+fs_entity_scan_entry*
+__fs_entity_scan_dir_add_entry(
+  fs_entity_scan_dir    *dir,
+  const char            *name,
+  fs_entity_kind        kind,
+  uint64_t              size,
+  int64_t               mtime_sec,
+  uint32_t              mtime_nsec
+)
+{
+  size_t                name_len = strlen(name);
+  fs_entity_scan_entry  *new_entry;
+  
+  if ( dir->count == dir->capacity ) {
+    unsigned int          new_capacity = dir->capacity ? 2 * dir->capacity : 16;
+    fs_entity_scan_entry  *new_entries = realloc(dir->entries, new_capacity * sizeof(fs_entity_scan_entry));
+    
+    if ( ! new_entries ) return NULL;
+    dir->entries = new_entries;
+    dir->capacity = new_capacity;
+  }
+  if ( dir->names_len + name_len + 1 > dir->names_capacity ) {
+    size_t                new_capacity = dir->names_capacity ? 2 * dir->names_capacity : 256;
+    char                  *new_names;
+    
+    while ( dir->names_len + name_len + 1 > new_capacity ) new_capacity *= 2;
+    if ( ! (new_names = realloc(dir->names, new_capacity)) ) return NULL;
+    dir->names = new_names;
+    dir->names_capacity = new_capacity;
+  }
+  new_entry = &dir->entries[dir->count++];
+  memset(new_entry, 0, sizeof(fs_entity_scan_entry));
+  new_entry->kind = kind;
+  new_entry->size = size;
+  new_entry->mtime_sec = mtime_sec;
+  new_entry->mtime_nsec = mtime_nsec;
+  new_entry->name = dir->names_len;
+  memcpy(dir->names + dir->names_len, name, name_len + 1);
+  dir->names_len += name_len + 1;
+  return new_entry;
+}
+
+//
+
+const fs_entity_index_record*
+__fs_entity_scan_dir_find_hint(
+  fs_entity_scan_dir    *dir,
+  fs_entity_index       *index,
+  const char            *name,
+  uint64_t              dev,
+  uint64_t              ino
+)
+{
+  const fs_entity_index_record  *first, *end, *r;
+  
+  if ( ! dir->hint || (dir->hint->next == dir->hint - index->records + 1) ) return NULL;
+  first = dir->hint + 1;
+  end = index->records + dir->hint->next;
+  
+  //
+  // Entries usually come back in the same order as last time, so start
+  // looking just past the previous match:
+  //
+  r = dir->hint_cursor ? dir->hint_cursor : first;
+  do {
+    if ( (r->kind == fs_entity_kind_directory) && ! r->is_cycle && (r->dev == dev) && (r->ino == ino) && (strcmp(index->names + r->name, name) == 0) ) {
+      dir->hint_cursor = index->records + r->next;
+      if ( dir->hint_cursor == end ) dir->hint_cursor = first;
+      return r;
+    }
+    r = index->records + r->next;
+    if ( r == end ) r = first;
+  } while ( r != (dir->hint_cursor ? dir->hint_cursor : first) );
+  return NULL;
+}
+
+//
+
+bool
+__fs_entity_scan_dir_add(
+  fs_entity_scan_dir    *dir,
+  fs_entity_index       *index,
+  int                   dir_fd,
+  const char            *name,
+  unsigned char         d_type,
+  fs_entity_scan_dir*   *subdirs
+)
+{
+  bool                  is_hidden = (name[0] == '.') && (strcmp(name, ".htaccess") != 0);
+  fs_entity_scan_entry  *new_entry;
+  fs_entity_scan_info   info;
+  
+  if ( (name[0] == '.') && ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0'))) ) return true;
+  
+  //
+  // Hidden files are dropped (directories are not); no need to stat them if
+  // the filesystem already says what they are:
+  //
+  if ( is_hidden && (d_type == DT_REG) ) return true;
+  
+  // Anything that can't be stat'ed is skipped:
+  if ( ! __fs_entity_scan_stat(dir_fd, name, &info) ) return true;
+  
+  if ( S_ISDIR(info.mode) ) {
+    fs_entity_scan_dir  *ancestor = dir;
+    
+    if ( ! (new_entry = __fs_entity_scan_dir_add_entry(dir, name, fs_entity_kind_directory, info.size, info.mtime_sec, info.mtime_nsec)) ) return false;
+    
+    //
+    // A directory that's also one of its own ancestors is not descended:
+    //
+    while ( ancestor ) {
+      if ( (ancestor->dev == info.dev) && (ancestor->ino == info.ino) ) {
+        new_entry->is_cycle = true;
+        return true;
+      }
+      ancestor = ancestor->parent;
+    }
+    new_entry->dir = __fs_entity_scan_dir_create(dir, dir->path, name, info.dev, info.ino, index ? __fs_entity_scan_dir_find_hint(dir, index, name, info.dev, info.ino) : NULL);
+    if ( ! new_entry->dir ) return false;
+    new_entry->dir->mtime_sec = info.mtime_sec;
+    new_entry->dir->mtime_nsec = info.mtime_nsec;
+    new_entry->dir->has_mtime = true;
+    new_entry->dir->next_queued = *subdirs;
+    *subdirs = new_entry->dir;
+  } else if ( S_ISREG(info.mode) && ! is_hidden ) {
+    if ( ! __fs_entity_scan_dir_add_entry(dir, name, fs_entity_kind_file, info.size, info.mtime_sec, info.mtime_nsec) ) return false;
+  }
+  return true;
+}
+
+//
+
+bool
+__fs_entity_scan_dir_read(
+  fs_entity_scan_dir    *dir,
+  fs_entity_index       *index,
+  char                  *buffer,
+  fs_entity_scan_dir*   *subdirs
+)
+{
+  int                   dir_fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  bool                  ok = true;
+  
+  // An unreadable directory is kept, it just has no children:
+  if ( dir_fd < 0 ) return true;
+  
+#ifdef HAVE_GETDENTS64
+  {
+    ssize_t             n_bytes;
+    
+    while ( ok && ((n_bytes = getdents64(dir_fd, buffer, FS_ENTITY_SCAN_BUFFER_SIZE)) > 0) ) {
+      ssize_t           offset = 0;
       
-      new_entity->path = ((void*)new_entity) + sizeof(fs_entity);
-      strncpy((char*)new_entity->path, path, path_len);
+      while ( ok && (offset < n_bytes) ) {
+        struct dirent64 *dentry = (struct dirent64*)(buffer + offset);
+        
+        ok = __fs_entity_scan_dir_add(dir, index, dir_fd, dentry->d_name, dentry->d_type, subdirs);
+        offset += dentry->d_reclen;
+      }
+    }
+  }
+  close(dir_fd);
+#else
+  {
+    DIR                 *dir_stream = fdopendir(dir_fd);
+    struct dirent       *dentry;
+    
+    if ( ! dir_stream ) {
+      close(dir_fd);
+      return true;
+    }
+    while ( ok && (dentry = readdir(dir_stream)) ) {
+      ok = __fs_entity_scan_dir_add(dir, index, dirfd(dir_stream), dentry->d_name, dentry->d_type, subdirs);
+    }
+    closedir(dir_stream);
+  }
+#endif
+  return ok;
+}
+
+//
+
+bool
+__fs_entity_scan_dir_restore(
+  fs_entity_scan_dir    *dir,
+  fs_entity_index       *index,
+  fs_entity_scan_dir*   *subdirs
+)
+{
+  const fs_entity_index_record  *r = dir->hint + 1;
+  const fs_entity_index_record  *end = index->records + dir->hint->next;
+  
+  while ( r < end ) {
+    fs_entity_scan_entry        *new_entry = __fs_entity_scan_dir_add_entry(dir, index->names + r->name, r->kind, r->size, r->mtime_sec, r->mtime_nsec);
+    
+    if ( ! new_entry ) return false;
+    if ( r->is_cycle ) {
+      new_entry->is_cycle = true;
+    } else if ( r->kind == fs_entity_kind_directory ) {
+      if ( ! (new_entry->dir = __fs_entity_scan_dir_create(dir, dir->path, index->names + r->name, r->dev, r->ino, r)) ) return false;
+      new_entry->dir->next_queued = *subdirs;
+      *subdirs = new_entry->dir;
+    }
+    r = index->records + r->next;
+  }
+  return true;
+}
+
+//
+
+bool
+__fs_entity_scan_dir_process(
+  fs_entity_scan_dir    *dir,
+  fs_entity_index       *index,
+  char                  *buffer,
+  fs_entity_scan_dir*   *subdirs,
+  bool                  *is_changed
+)
+{
+  if ( dir->hint ) {
+    if ( ! dir->has_mtime ) {
+      fs_entity_scan_info info;
       
-      char       *last_slash = strrchr(new_entity->path, '/');
+      if ( __fs_entity_scan_stat(AT_FDCWD, dir->path, &info) ) {
+        dir->mtime_sec = info.mtime_sec;
+        dir->mtime_nsec = info.mtime_nsec;
+        dir->has_mtime = true;
+      }
+    }
+    if ( dir->has_mtime && (dir->mtime_sec == dir->hint->mtime_sec) && (dir->mtime_nsec == dir->hint->mtime_nsec) ) {
+      return __fs_entity_scan_dir_restore(dir, index, subdirs);
+    }
+  }
+  *is_changed = true;
+  return __fs_entity_scan_dir_read(dir, index, buffer, subdirs);
+}
+
+//
+
+void*
+__fs_entity_scanner_worker(
+  void                  *context
+)
+{
+  fs_entity_scanner     *scanner = (fs_entity_scanner*)context;
+  char                  *buffer = malloc(FS_ENTITY_SCAN_BUFFER_SIZE);
+  
+  pthread_mutex_lock(&scanner->lock);
+  if ( ! buffer ) scanner->is_failed = true;
+  while ( ! scanner->is_failed ) {
+    fs_entity_scan_dir  *dir, *subdirs = NULL;
+    unsigned int        n_subdirs = 0;
+    bool                ok, is_changed = false;
+    
+    while ( ! scanner->queue && scanner->pending && ! scanner->is_failed ) pthread_cond_wait(&scanner->queued, &scanner->lock);
+    if ( ! scanner->queue ) break;
+    dir = scanner->queue;
+    scanner->queue = dir->next_queued;
+    pthread_mutex_unlock(&scanner->lock);
+    
+    ok = __fs_entity_scan_dir_process(dir, scanner->index, buffer, &subdirs, &is_changed);
+    
+    pthread_mutex_lock(&scanner->lock);
+    while ( subdirs ) {
+      fs_entity_scan_dir  *next = subdirs->next_queued;
       
-      new_entity->name = last_slash ? (last_slash + 1) : new_entity->path;
+      subdirs->next_queued = scanner->queue;
+      scanner->queue = subdirs;
+      subdirs = next;
+      n_subdirs++;
     }
+    scanner->pending += n_subdirs;
+    scanner->pending--;
+    if ( is_changed ) scanner->is_changed = true;
+    if ( ! ok ) scanner->is_failed = true;
+    if ( n_subdirs || ! scanner->pending || scanner->is_failed ) pthread_cond_broadcast(&scanner->queued);
   }
-  return new_entity;
+  pthread_mutex_unlock(&scanner->lock);
+  if ( buffer ) free((void*)buffer);
+  return NULL;
 }
 
 //
 
-fs_entity*
-__fs_entity_create_with_scanner(
-  FTS           *scanner,
-  unsigned int  *count
+bool
+__fs_entity_scanner_run(
+  fs_entity_scan_dir    *root,
+  fs_entity_index       *index,
+  unsigned int          n_threads,
+  bool                  *is_changed
 )
 {
-  fs_entity   *root_entity = NULL;
-  FTSENT      *entity_info = fts_read(scanner);
+  fs_entity_scanner     scanner;
+  pthread_t             threads[FS_ENTITY_SCAN_MAX_THREADS];
+  unsigned int          i, n_started = 0;
   
-  if ( entity_info ) {
-    bool      keep_going = true;
+  if ( n_threads == 0 ) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long                n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
     
-    do {
-      fs_entity   *this_entity = NULL;
+    n_threads = (n_cpus > 0) ? n_cpus : 1;
+#else
+    n_threads = 1;
+#endif
+  }
+  if ( n_threads > FS_ENTITY_SCAN_MAX_THREADS ) n_threads = FS_ENTITY_SCAN_MAX_THREADS;
+  
+  pthread_mutex_init(&scanner.lock, NULL);
+  pthread_cond_init(&scanner.queued, NULL);
+  scanner.queue = root;
+  scanner.pending = 1;
+  scanner.is_failed = false;
+  scanner.is_changed = false;
+  scanner.index = index;
+  
+  //
+  // The calling thread is always one of the workers:
+  //
+  for ( i = 1; i < n_threads; i++ ) {
+    if ( pthread_create(&threads[n_started], NULL, __fs_entity_scanner_worker, &scanner) == 0 ) n_started++;
+  }
+  __fs_entity_scanner_worker(&scanner);
+  for ( i = 0; i < n_started; i++ ) pthread_join(threads[i], NULL);
+  
+  pthread_cond_destroy(&scanner.queued);
+  pthread_mutex_destroy(&scanner.lock);
+  *is_changed = scanner.is_changed;
+  return ! scanner.is_failed;
+}
+
+//
+
+bool
+__fs_entity_builder_add_scan(
+  fs_entity_builder     *builder,
+  fs_entity_scan_dir    *dir,
+  unsigned int          depth
+)
+{
+  unsigned int          i;
+  
+  for ( i = 0; i < dir->count; i++ ) {
+    fs_entity_scan_entry  *entry = &dir->entries[i];
+    const char            *name = dir->names + entry->name;
+    
+    if ( entry->is_cycle ) {
+      size_t              path_len = strlen(dir->path);
       
-      switch (entity_info->fts_info) {
+      if ( path_len && (dir->path[path_len - 1] == '/') ) path_len--;
+      fprintf(stderr, "WARNING:  directory cycle would result for %.*s/%s\n", (int)path_len, dir->path, name);
+      continue;
+    }
+    if ( __fs_entity_builder_append(builder, entry->kind, name, entry->size, depth + 1) == FS_ENTITY_INDEX_NONE ) return false;
+    if ( entry->dir && ! __fs_entity_builder_add_scan(builder, entry->dir, depth + 1) ) return false;
+  }
+  return true;
+}
+
+//
+
+fs_entity_index*
+__fs_entity_index_open(
+  const char            *index_path,
+  const char            *root_path
+)
+{
+  fs_entity_index       *index = NULL;
+  int                   fd = open(index_path, O_RDONLY | O_CLOEXEC);
+  struct stat           finfo;
+  
+  if ( fd < 0 ) return NULL;
+  if ( (fstat(fd, &finfo) == 0) && (finfo.st_size >= (off_t)sizeof(fs_entity_index_header)) && (index = malloc(sizeof(fs_entity_index))) ) {
+    index->length = finfo.st_size;
+    index->base = mmap(NULL, index->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( index->base == MAP_FAILED ) {
+      free((void*)index);
+      index = NULL;
+    } else {
+      const fs_entity_index_header  *header = (const fs_entity_index_header*)index->base;
+      const char                    *index_root_path;
+      bool                          ok = false;
       
-        case FTS_D:
-          this_entity = __fs_entity_create(fs_entity_kind_directory, entity_info->fts_path);
-          if ( this_entity ) {
-            *count = *count + 1;
-            this_entity->size = entity_info->fts_statp->st_size;
-            this_entity->child = __fs_entity_create_with_scanner(scanner, count);
-          }
-          break;
-        
-        case FTS_DP:
-          keep_going = false;
-          break;
+      //
+      // Check that everything fits and that the records nest properly, then the
+      // scan can follow them without any further checks:
+      //
+      index->records = (const fs_entity_index_record*)(header + 1);
+      index->count = header->count;
+      index_root_path = (const char*)(index->records + index->count);
+      index->names = index_root_path + header->root_path_len;
+      if ( (memcmp(header->magic, FS_ENTITY_INDEX_MAGIC, sizeof(header->magic)) == 0)
+              && (header->version == FS_ENTITY_INDEX_VERSION)
+              && (header->count > 0)
+              && (header->root_path_len > 0) && (header->names_len > 0)
+              && (index->length == sizeof(fs_entity_index_header) + (uint64_t)header->count * sizeof(fs_entity_index_record) + header->root_path_len + header->names_len)
+              && (index_root_path[header->root_path_len - 1] == '\0') && (strcmp(index_root_path, root_path) == 0)
+              && (index->names[header->names_len - 1] == '\0')
+              && (index->records[0].kind == fs_entity_kind_directory) && (index->records[0].next == index->count) )
+      {
+        uint32_t                    *ends = malloc(index->count * sizeof(uint32_t));
+        uint32_t                    i, depth = 0;
         
-        case FTS_DC:
-          fprintf(stderr, "WARNING:  directory cycle would result for %s\n", entity_info->fts_path);
-          break;
-          
-        case FTS_F:
-          if ( (entity_info->fts_name[0] != '.') || (strcmp(entity_info->fts_name, ".htaccess") == 0) ) {
-            this_entity = __fs_entity_create(fs_entity_kind_file, entity_info->fts_path);
-            if ( this_entity ) {
-              *count = *count + 1;
-              this_entity->size = entity_info->fts_statp->st_size;
-            }
+        if ( ends ) {
+          ok = true;
+          for ( i = 0; ok && (i < index->count); i++ ) {
+            const fs_entity_index_record  *r = &index->records[i];
+            
+            while ( depth && (ends[depth - 1] <= i) ) depth--;
+            ok = (r->name < header->names_len) && (r->next > i) && (! depth || (r->next <= ends[depth - 1]))
+                    && ((r->kind == fs_entity_kind_directory) || (r->kind == fs_entity_kind_file))
+                    && ((r->next == i + 1) || ((r->kind == fs_entity_kind_directory) && ! r->is_cycle));
+            ends[depth++] = r->next;
           }
-          break;
-      
+          free((void*)ends);
+        }
       }
-      if ( this_entity ) {
-        this_entity->sibling = root_entity;
-        root_entity = this_entity;
+      if ( ! ok ) {
+        fprintf(stderr, "WARNING:  ignoring scan index %s (invalid, or not made from %s)\n", index_path, root_path);
+        munmap(index->base, index->length);
+        free((void*)index);
+        index = NULL;
       }
-    } while ( keep_going && (entity_info = fts_read(scanner)) );
+    }
+  }
+  close(fd);
+  return index;
+}
+
+//
+
+void
+__fs_entity_index_close(
+  fs_entity_index       *index
+)
+{
+  munmap(index->base, index->length);
+  free((void*)index);
+}
+
+//
+
+typedef struct {
+  fs_entity_index_record  *records;
+  uint32_t                count, capacity;
+  char                    *names;
+  size_t                  names_len, names_capacity;
+} fs_entity_index_writer;
+
+//
+
+bool
+__fs_entity_index_writer_append(
+  fs_entity_index_writer  *writer,
+  const char              *name,
+  fs_entity_kind          kind,
+  bool                    is_cycle,
+  uint64_t                size,
+  uint64_t                dev,
+  uint64_t                ino,
+  int64_t                 mtime_sec,
+  uint32_t                mtime_nsec
+)
+{
+  size_t                  name_len = strlen(name);
+  fs_entity_index_record  *r;
+  
+  if ( writer->count == writer->capacity ) {
+    uint32_t                new_capacity = writer->capacity ? 2 * writer->capacity : 4096;
+    fs_entity_index_record  *new_records = realloc(writer->records, new_capacity * sizeof(fs_entity_index_record));
+    
+    if ( ! new_records ) return false;
+    writer->records = new_records;
+    writer->capacity = new_capacity;
+  }
+  if ( writer->names_len + name_len + 1 > writer->names_capacity ) {
+    size_t                  new_capacity = writer->names_capacity ? 2 * writer->names_capacity : 65536;
+    char                    *new_names;
+    
+    while ( writer->names_len + name_len + 1 > new_capacity ) new_capacity *= 2;
+    if ( ! (new_names = realloc(writer->names, new_capacity)) ) return false;
+    writer->names = new_names;
+    writer->names_capacity = new_capacity;
+  }
+  r = &writer->records[writer->count++];
+  memset(r, 0, sizeof(fs_entity_index_record));
+  r->size = size;
+  r->dev = dev;
+  r->ino = ino;
+  r->mtime_sec = mtime_sec;
+  r->mtime_nsec = mtime_nsec;
+  r->name = writer->names_len;
+  r->next = writer->count;
+  r->kind = kind;
+  r->is_cycle = is_cycle;
+  memcpy(writer->names + writer->names_len, name, name_len + 1);
+  writer->names_len += name_len + 1;
+  return true;
+}
+
+//
+
+bool
+__fs_entity_index_writer_add_scan(
+  fs_entity_index_writer  *writer,
+  fs_entity_scan_dir      *dir
+)
+{
+  unsigned int            i;
+  
+  for ( i = 0; i < dir->count; i++ ) {
+    fs_entity_scan_entry  *entry = &dir->entries[i];
+    uint32_t              r;
+    
+    r = writer->count;
+    if ( entry->dir ) {
+      // The directory's own mtime is fresher than what its parent recorded:
+      if ( ! __fs_entity_index_writer_append(writer, dir->names + entry->name, entry->kind, false, entry->size, entry->dir->dev, entry->dir->ino, entry->dir->mtime_sec, entry->dir->mtime_nsec) ) return false;
+      if ( ! __fs_entity_index_writer_add_scan(writer, entry->dir) ) return false;
+      writer->records[r].next = writer->count;
+    } else {
+      if ( ! __fs_entity_index_writer_append(writer, dir->names + entry->name, entry->kind, entry->is_cycle, entry->size, 0, 0, entry->mtime_sec, entry->mtime_nsec) ) return false;
+    }
   }
-  return root_entity;
+  return true;
+}
+
+//
+
+bool
+__fs_entity_index_write(
+  const char              *index_path,
+  const char              *root_path,
+  fs_entity_scan_dir      *root,
+  uint64_t                root_size
+)
+{
+  fs_entity_index_writer  writer;
+  bool                    ok = false;
+  
+  memset(&writer, 0, sizeof(writer));
+  if ( __fs_entity_index_writer_append(&writer, root_path, fs_entity_kind_directory, false, root_size, root->dev, root->ino, root->mtime_sec, root->mtime_nsec)
+          && __fs_entity_index_writer_add_scan(&writer, root) )
+  {
+    fs_entity_index_header  header;
+    char                    *tmp_path = NULL;
+    FILE                    *fptr;
+    
+    writer.records[0].next = writer.count;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FS_ENTITY_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FS_ENTITY_INDEX_VERSION;
+    header.count = writer.count;
+    header.root_path_len = strlen(root_path) + 1;
+    header.names_len = writer.names_len;
+    
+    //
+    // Written alongside and renamed into place, so a reader never sees a
+    // partial index:
+    //
+    if ( asprintf(&tmp_path, "%s.%ld", index_path, (long)getpid()) > 0 ) {
+      if ( (fptr = fopen(tmp_path, "w")) ) {
+        ok = (fwrite(&header, sizeof(header), 1, fptr) == 1)
+                && (fwrite(writer.records, sizeof(fs_entity_index_record), writer.count, fptr) == writer.count)
+                && (fwrite(root_path, header.root_path_len, 1, fptr) == 1)
+                && (fwrite(writer.names, writer.names_len, 1, fptr) == 1);
+        if ( fclose(fptr) != 0 ) ok = false;
+        if ( ok ) ok = (rename(tmp_path, index_path) == 0);
+        if ( ! ok ) unlink(tmp_path);
+      }
+      free((void*)tmp_path);
+    }
+  }
+  if ( writer.records ) free((void*)writer.records);
+  if ( writer.names ) free((void*)writer.names);
+  return ok;
+}
+
+//
+
+fs_entity_list*
+__fs_entity_builder_finish(
+  fs_entity_builder *builder,
+  bool              ok
+)
+{
+  fs_entity_list    *the_list = builder->the_list;
+  
+  if ( builder->intern_table ) free((void*)builder->intern_table);
+  if ( builder->last_child ) free((void*)builder->last_child);
+  
+  if ( ! ok || ! the_list->count || ! the_list->base_path || ! the_list->root_path ) {
+    fs_entity_list_destroy(the_list);
+    return NULL;
+  }
+  
+  //
+  // Drop the slack from the node array now that it's complete:
+  //
+  if ( the_list->count < builder->capacity ) {
+    fs_entity       *nodes = realloc(the_list->root_entity, the_list->count * sizeof(fs_entity));
+    
+    if ( nodes ) the_list->root_entity = nodes;
+  }
+  the_list->generation        = 0;
+  the_list->generation_sum    = 0;
+  the_list->disabled_states   = (1 << fs_entity_state_download_range);
+  the_list->stats_pool        = http_stats_pool_create(0);
+  return the_list;
 }
 
 //
 
 fs_entity_list*
 fs_entity_list_create_with_path(
-  const char    *path
+  const char    *path,
+  unsigned int  scan_threads,
+  const char    *index_path
 )
 {
-  fs_entity     *root_entity = NULL;
-  unsigned int  count = 0;
-  struct stat   finfo;
-  const char    *base_path = NULL;
+  fs_entity_list    *the_list = malloc(sizeof(fs_entity_list));
+  fs_entity_builder builder;
+  struct stat       finfo;
+  bool              ok = false;
+  
+  if ( ! the_list ) return NULL;
+  memset(the_list, 0, sizeof(fs_entity_list));
+  memset(&builder, 0, sizeof(builder));
+  builder.the_list = the_list;
   
   if ( stat(path, &finfo) == 0 ) {
     if ( S_ISDIR(finfo.st_mode) ) {
       char          *resolved_path = realpath(path, NULL);
       
       if ( resolved_path ) {
-        //
-        // Setup for a filesystem traversal:
-        //
-        const char  *paths[2] = { resolved_path, NULL };
-        FTS         *scanner = fts_open(
-                                    (char * const *)paths,
-                                    FTS_LOGICAL,
-                                    NULL
-                                  );
-        if ( scanner ) {
-          root_entity = __fs_entity_create_with_scanner(scanner, &count);
-          fts_close(scanner);
+        fs_entity_index     *index = index_path ? __fs_entity_index_open(index_path, resolved_path) : NULL;
+        fs_entity_scan_dir  *root = __fs_entity_scan_dir_create(NULL, resolved_path, NULL, finfo.st_dev, finfo.st_ino, index ? index->records : NULL);
+        fs_entity_scan_info root_info;
+        bool                is_changed = false;
+        
+        if ( root ) {
+          if ( __fs_entity_scan_stat(AT_FDCWD, resolved_path, &root_info) ) {
+            root->mtime_sec = root_info.mtime_sec;
+            root->mtime_nsec = root_info.mtime_nsec;
+            root->has_mtime = true;
+          }
+          if ( __fs_entity_scanner_run(root, index, scan_threads, &is_changed) ) {
+            ok = (__fs_entity_builder_append(&builder, fs_entity_kind_directory, resolved_path, finfo.st_size, 0) != FS_ENTITY_INDEX_NONE)
+                    && __fs_entity_builder_add_scan(&builder, root, 0);
+          }
+          if ( index ) __fs_entity_index_close(index);
+          
+          //
+          // Only rewrite the index if something was actually read from disk:
+          //
+          if ( ok && index_path && (is_changed || ! index) ) {
+            if ( ! __fs_entity_index_write(index_path, resolved_path, root, finfo.st_size) ) {
+              fprintf(stderr, "WARNING:  unable to write scan index %s (errno = %d)\n", index_path, errno);
+            }
+          }
+          __fs_entity_scan_dir_destroy(root);
         }
-        base_path = resolved_path;
+        the_list->base_path = resolved_path;
+        the_list->root_path = strdup(resolved_path);
       }
     } else if ( S_ISREG(finfo.st_mode) || S_ISLNK(finfo.st_mode) ) {
-      root_entity = __fs_entity_create(fs_entity_kind_file, path);
-      if ( root_entity ) {
+      if ( __fs_entity_builder_append(&builder, fs_entity_kind_file, path, finfo.st_size, 0) != FS_ENTITY_INDEX_NONE ) {
         char        *last_slash;
         
-        count++;
-        root_entity->size = finfo.st_size;
-        
         // The base path should be the parent directory of this item:
         last_slash = strrchr(path, '/');
         if ( last_slash ) {
-          char      *sub_path = malloc(last_slash - path);
+          char      *sub_path = malloc(last_slash - path + 1);
           if ( sub_path ) {
             memcpy(sub_path, path, last_slash - path);
             sub_path[last_slash - path] = '\0';
             
-            base_path = (const char*)sub_path;
+            the_list->base_path = (const char*)sub_path;
           }
         } else {
-          base_path = strdup("");
+          the_list->base_path = strdup("");
         }
+        the_list->root_path = strdup(path);
+        ok = true;
       }
     }
   }
+  return __fs_entity_builder_finish(&builder, ok);
+}
+
+//
+
+bool
+__fs_entity_synthetic_add(
+  fs_entity_builder *builder,
+  unsigned int      node,
+  unsigned int      count,
+  unsigned int      fanout,
+  unsigned int      depth
+)
+{
+  unsigned int      first_child = fanout * node + 1, i;
+  bool              is_directory = (node == 0) || (first_child < count);
+  char              name[32];
+  
+  //
+  // Names are the ordinal within the parent, so they repeat across directories
+  // the way real trees' names do:
+  //
+  if ( node == 0 ) {
+    strcpy(name, "synthetic");
+  } else {
+    snprintf(name, sizeof(name), is_directory ? "dir-%u" : "file-%u.dat", (node - 1) % fanout);
+  }
+  if ( __fs_entity_builder_append(builder, is_directory ? fs_entity_kind_directory : fs_entity_kind_file, name,
+            is_directory ? 4096 : 1024 * (1 + node % 64), depth) == FS_ENTITY_INDEX_NONE ) return false;
+  for ( i = first_child; (i < count) && (i < first_child + fanout); i++ ) {
+    if ( ! __fs_entity_synthetic_add(builder, i, count, fanout, depth + 1) ) return false;
+  }
+  return true;
+}
+
+//
+
+fs_entity_list*
+fs_entity_list_create_synthetic(
+  unsigned int  count,
+  unsigned int  fanout
+)
+{
+  fs_entity_list    *the_list;
+  fs_entity_builder builder;
+  bool              ok;
+  
+  if ( (count == 0) || (fanout < 2) ) return NULL;
+  if ( ! (the_list = malloc(sizeof(fs_entity_list))) ) return NULL;
+  memset(the_list, 0, sizeof(fs_entity_list));
+  memset(&builder, 0, sizeof(builder));
+  builder.the_list = the_list;
+  
+  //
+  // Node n's children are nodes fanout * n + 1 through fanout * n + fanout (a
+  // complete tree numbered breadth-first), appended depth-first:
+  //
+  ok = __fs_entity_synthetic_add(&builder, 0, count, fanout, 0);
+  the_list->base_path = strdup("");
+  the_list->root_path = strdup("synthetic");
+  return __fs_entity_builder_finish(&builder, ok);
+}
+
+//
+
+void
+fs_entity_list_destroy(
+  fs_entity_list    *the_list
+)
+{
+  if ( the_list->root_entity ) {
+    unsigned int    i;
+    
+    // The stats themselves belong to the pool, only the per-entity tables are freed:
+    for ( i = 0; i < the_list->count; i++ ) {
+      if ( the_list->root_entity[i].http_stats ) free((void*)the_list->root_entity[i].http_stats);
+    }
+    free((void*)the_list->root_entity);
+  }
+  if ( the_list->ready ) free((void*)the_list->ready);
+  if ( the_list->urls ) free((void*)the_list->urls);
+  if ( the_list->url_offsets ) free((void*)the_list->url_offsets);
+  if ( the_list->names ) free((void*)the_list->names);
+  if ( the_list->base_path ) free((void*)the_list->base_path);
+  if ( the_list->root_path ) free((void*)the_list->root_path);
+  if ( the_list->stats_pool ) http_stats_pool_destroy(the_list->stats_pool);
+  free(the_list);
+}
+
+//
+
+const char*
+fs_entity_list_name_for_entity(
+  fs_entity_list    *the_list,
+  fs_entity         *the_entity
+)
+{
+  return the_list->names + the_entity->name;
+}
+
+//
+
+bool
+fs_entity_list_copy_path_for_entity(
+  fs_entity_list    *the_list,
+  fs_entity         *the_entity,
+  char*             *buffer,
+  size_t            *capacity
+)
+{
+  size_t            root_len = strlen(the_list->root_path);
+  size_t            path_len = root_len;
+  bool              root_has_trailing_slash = (root_len && (the_list->root_path[root_len - 1] == '/'));
+  fs_entity         *e = the_entity;
+  char              *p;
+  
+  //
+  // Paths aren't stored; walk up to the root to size the path, then fill it
+  // in back-to-front:
+  //
+  while ( e->parent != FS_ENTITY_INDEX_NONE ) {
+    path_len += 1 + strlen(the_list->names + e->name);
+    e = &the_list->root_entity[e->parent];
+  }
+  if ( root_has_trailing_slash && (the_entity != the_list->root_entity) ) path_len--;
   
-  if ( root_entity ) {
-    fs_entity_list  *the_list = malloc(sizeof(fs_entity_list));
+  if ( path_len + 1 > *capacity ) {
+    char            *new_buffer = realloc(*buffer, path_len + 1);
     
-    if ( the_list ) {
-      the_list->count             = count;
-      the_list->generation        = 0;
-      the_list->disabled_states   = (1 << fs_entity_state_download_range);
-      the_list->root_entity       = root_entity;
-      the_list->base_path         = base_path;
-    }
-    return the_list;
+    if ( ! new_buffer ) return false;
+    *buffer = new_buffer;
+    *capacity = path_len + 1;
   }
-  return NULL;
+  p = *buffer + path_len;
+  *p = '\0';
+  e = the_entity;
+  while ( e->parent != FS_ENTITY_INDEX_NONE ) {
+    const char      *name = the_list->names + e->name;
+    size_t          name_len = strlen(name);
+    
+    p -= name_len;
+    memcpy(p, name, name_len);
+    e = &the_list->root_entity[e->parent];
+    if ( (e->parent != FS_ENTITY_INDEX_NONE) || ! root_has_trailing_slash ) *(--p) = '/';
+  }
+  memcpy(*buffer, the_list->root_path, root_len);
+  return true;
 }
 
 //
 
-void
-__fs_entity_destroy(
-  fs_entity     *root_entity
+const char*
+fs_entity_list_path_for_entity(
+  fs_entity_list    *the_list,
+  fs_entity         *the_entity
 )
 {
-  if ( root_entity ) {
-  	http_ops_method		i_m;
-    fs_entity   			*e = root_entity->sibling;
-    
-    if ( root_entity->child ) __fs_entity_destroy(root_entity->child);
-    
-    for ( i_m = http_ops_method_get; i_m < http_ops_method_max; i_m++ )
-    	http_stats_destroy(root_entity->http_stats[i_m]);
-    	
-    free(root_entity);
+  char              *path = NULL;
+  size_t            capacity = 0;
+  
+  if ( ! fs_entity_list_copy_path_for_entity(the_list, the_entity, &path, &capacity) ) {
+    if ( path ) free((void*)path);
+    return NULL;
+  }
+  return (const char*)path;
+}
+
+//
+
+unsigned int
+fs_entity_list_generation_average(
+  fs_entity_list        *the_list
+)
+{
+  // Rounded down, the average only moves on once every node has:
+  return (unsigned int)(the_list->generation_sum / the_list->count);
+}
+
+//
+// The random walk keeps a ready set per directory:  the children of each
+// directory own a contiguous slice of the_list->ready, with the eligible ones
+// (generation below the one being worked on) packed at the front.  Children
+// that complete a generation are swapped out of the front in O(1); when the
+// list's generation changes the slice is re-partitioned the next time the
+// directory is visited.
+//
+
+bool
+__fs_entity_list_ready_create(
+  fs_entity_list        *the_list
+)
+{
+  unsigned int          i, next_base = 0;
+  
+  if ( ! (the_list->ready = malloc(the_list->count * sizeof(unsigned int))) ) return false;
+  for ( i = 0; i < the_list->count; i++ ) {
+    fs_entity           *e = &the_list->root_entity[i];
+    unsigned int        c = e->child, slot = 0;
     
-    if ( e ) __fs_entity_destroy(e);
+    e->ready_base = next_base;
+    e->ready_count = 0;
+    e->ready_generation = FS_ENTITY_INDEX_NONE;
+    while ( c != FS_ENTITY_INDEX_NONE ) {
+      the_list->ready[next_base + slot] = c;
+      the_list->root_entity[c].ready_slot = slot++;
+      c = the_list->root_entity[c].sibling;
+    }
+    next_base += slot;
   }
+  return true;
 }
 
 //
 
-void
-fs_entity_list_destroy(
-  fs_entity_list    *the_list
+static inline void
+__fs_entity_ready_swap(
+  fs_entity_list        *the_list,
+  fs_entity             *directory,
+  unsigned int          slot_a,
+  unsigned int          slot_b
 )
 {
-  if ( the_list->base_path ) free((void*)the_list->base_path);
-  if ( the_list->root_entity ) __fs_entity_destroy(the_list->root_entity);
-  free(the_list);
+  unsigned int          *ready = the_list->ready + directory->ready_base;
+  unsigned int          a = ready[slot_a], b = ready[slot_b];
+  
+  ready[slot_a] = b; the_list->root_entity[b].ready_slot = slot_a;
+  ready[slot_b] = a; the_list->root_entity[a].ready_slot = slot_b;
 }
 
 //
 
-unsigned int
-__fs_entity_generation_average(
-  fs_entity             *root_entity,
-  double                mean,
-  unsigned long long    *n
+static inline void
+__fs_entity_ready_sync(
+  fs_entity_list        *the_list,
+  fs_entity             *directory,
+  unsigned int          generation
 )
 {
-  while ( root_entity ) {
-    mean += (root_entity->generation - mean) / *n;
-    *n = *n + 1;
+  if ( directory->ready_generation != the_list->generation ) {
+    unsigned int        *ready = the_list->ready + directory->ready_base;
+    unsigned int        slot;
     
-    if ( root_entity->child ) mean = __fs_entity_generation_average(root_entity->child, mean, n);
-    root_entity = root_entity->sibling;
+    directory->ready_generation = the_list->generation;
+    directory->ready_count = 0;
+    for ( slot = 0; slot < directory->child_count; slot++ ) {
+      if ( the_list->root_entity[ready[slot]].generation < generation ) __fs_entity_ready_swap(the_list, directory, slot, directory->ready_count++);
+    }
   }
-  return mean;
 }
 
+//
+// Each directory tracks the lowest generation among its children and how many
+// children are at it, so whether a row has anything left to do is known
+// without walking it.  Generations only ever increase, so the minimum only
+// needs to be recomputed when the last child at the old minimum moves on.
 //
 
-unsigned int
-fs_entity_generation_average(
-  fs_entity   *root_entity
+static inline void
+__fs_entity_list_generation_completed(
+  fs_entity_list        *the_list,
+  fs_entity             *entity
 )
 {
-  unsigned long long    n = 1;
-  double                avg = __fs_entity_generation_average(root_entity, 0.0, &n);
+  unsigned int          generation = entity->generation++;
   
-  return (unsigned int)ceil(avg);
+  the_list->generation_sum++;
+  if ( entity->parent != FS_ENTITY_INDEX_NONE ) {
+    fs_entity           *parent = &the_list->root_entity[entity->parent];
+    
+    // No longer eligible, drop it from the parent's ready set:
+    if ( the_list->ready && (parent->ready_generation == the_list->generation) && (entity->generation > the_list->generation) ) {
+      __fs_entity_ready_swap(the_list, parent, entity->ready_slot, --parent->ready_count);
+    }
+    
+    if ( (generation == parent->min_generation) && (--parent->min_count == 0) ) {
+      unsigned int      i = parent->child;
+      
+      parent->min_generation = entity->generation;
+      while ( i != FS_ENTITY_INDEX_NONE ) {
+        fs_entity       *e = &the_list->root_entity[i];
+        
+        if ( e->generation < parent->min_generation ) {
+          parent->min_generation = e->generation;
+          parent->min_count = 1;
+        } else if ( e->generation == parent->min_generation ) {
+          parent->min_count++;
+        }
+        i = e->sibling;
+      }
+    }
+  }
 }
 
 //
@@ -291,9 +1447,13 @@ void
 fs_entity_fprint(
   FILE                    *fptr,
   fs_entity_print_format  format,
+  fs_entity_list          *the_list,
   fs_entity               *entity
 )
 {
+  const char              *path = NULL;
+  
+
   if ( (format & fs_entity_print_format_kind) == fs_entity_print_format_kind ) {
     fprintf(fptr, "%s ", __fs_entity_kind_to_token(format, entity->kind));
   }
@@ -312,15 +1472,17 @@ fs_entity_fprint(
     fprintf(fptr, "%-8llu ", (unsigned long long)entity->size);
   }
   
+  if ( (format & fs_entity_print_format_path) == fs_entity_print_format_path ) path = fs_entity_list_path_for_entity(the_list, entity);
   if ( (format & fs_entity_print_format_name) == fs_entity_print_format_name ) {
-    if ( (format & fs_entity_print_format_path) == fs_entity_print_format_path ) {
-      fprintf(fptr, "%s (%s)\n", entity->name, entity->path);
+    if ( path ) {
+      fprintf(fptr, "%s (%s)\n", fs_entity_list_name_for_entity(the_list, entity), path);
     } else {
-      fprintf(fptr, "%s\n", entity->name);
+      fprintf(fptr, "%s\n", fs_entity_list_name_for_entity(the_list, entity));
     }
-  } else if ( (format & fs_entity_print_format_path) == fs_entity_print_format_path ) {
-    fprintf(fptr, "%s\n", entity->path);
+  } else if ( path ) {
+    fprintf(fptr, "%s\n", path);
   }
+  if ( path ) free((void*)path);
 }
 
 //
@@ -328,10 +1490,11 @@ fs_entity_fprint(
 void
 fs_entity_print(
   fs_entity_print_format  format,
+  fs_entity_list          *the_list,
   fs_entity               *entity
 )
 {
-  return fs_entity_fprint(stdout, format, entity);
+  return fs_entity_fprint(stdout, format, the_list, entity);
 }
 
 //
@@ -372,6 +1535,7 @@ void
 __fs_entity_fprint(
   FILE                    *fptr,
   fs_entity_print_format  format,
+  fs_entity_list          *the_list,
   fs_entity               *entity,
   int                     indent
 )
@@ -381,15 +1545,14 @@ __fs_entity_fprint(
   
   while ( e ) {
     int         i;
-    char        kind;
     
     i = indent;
     while ( i-- ) fprintf(fptr, "%s", indent_str);
     
-    fs_entity_fprint(fptr, format, e);
+    fs_entity_fprint(fptr, format, the_list, e);
     
-    if ( e->kind == fs_entity_kind_directory ) __fs_entity_fprint(fptr, format, e->child, indent + 1);
-    e = e->sibling;
+    if ( e->kind == fs_entity_kind_directory ) __fs_entity_fprint(fptr, format, the_list, __fs_entity_child(the_list, e), indent + 1);
+    e = __fs_entity_sibling(the_list, e);
   }
 }
 
@@ -403,7 +1566,7 @@ fs_entity_list_fprint(
 )
 {
   fprintf(fptr, "%s base path '%s'\n", ( (format & fs_entity_print_format_ascii) == fs_entity_print_format_ascii ) ? " _" : "┌ ", the_list->base_path);
-  __fs_entity_fprint(fptr, format, the_list->root_entity, 0);
+  __fs_entity_fprint(fptr, format, the_list, the_list->root_entity, 0);
   if ( (format & fs_entity_print_format_summary) == fs_entity_print_format_summary ) {
     const char    *indent_str = ( (format & fs_entity_print_format_ascii) == fs_entity_print_format_ascii ) ? "|_" : "└ ";
     
@@ -468,7 +1631,7 @@ try_again:
           break;
         
         case fs_entity_state_delete:
-          root_entity->generation++;
+          __fs_entity_list_generation_completed(the_list, root_entity);
           root_entity->state = fs_entity_state_upload;
           break;
       
@@ -503,7 +1666,7 @@ try_again:
           break;
         
         case fs_entity_state_delete:
-          root_entity->generation++;
+          __fs_entity_list_generation_completed(the_list, root_entity);
           root_entity->state = fs_entity_state_upload;
           break;
         
@@ -537,194 +1700,184 @@ try_again:
 
 //
 
+typedef fs_entity* (*__fs_entity_row_selector_fn)(fs_entity_list *the_list, fs_entity *directory, unsigned int generation);
+
+//
+// Selection distinguishes "nothing left to do" (NULL) from "nothing can be done
+// until an entity that's in flight is released":
+//
+static fs_entity __fs_entity_blocked;
+
+#define FS_ENTITY_BLOCKED   (&__fs_entity_blocked)
+
+//
+
 fs_entity*
-__fs_entity_next_node(
-  fs_entity_list  *the_list,
-  fs_entity       *root_entity,
-  unsigned int    generation
+__fs_entity_select(
+  fs_entity_list              *the_list,
+  fs_entity                   *e,
+  unsigned int                generation,
+  __fs_entity_row_selector_fn row_selector
 )
 {
-  fs_entity     *e;
   fs_entity     *node = NULL;
-  unsigned int  n = 0;
-  unsigned int  min_gen = generation;
-  unsigned int  iteration = 0;
   
-  e = root_entity;
-  while ( e ) {
-    n++;
-    if ( e->generation < min_gen ) min_gen = e->generation;
-    e = e->sibling;
-  }
+  //
+  // An entity that's in flight blocks everything beneath it, too:
+  //
+  if ( e->is_busy ) return FS_ENTITY_BLOCKED;
   
-  // Everything in this row is current generation.
-  if ( min_gen == generation ) return NULL;
+  switch ( e->kind ) {
   
-  e = root_entity;
-  while ( e ) {
-    if ( e->generation < generation ) {
-      switch ( e->kind ) {
+    case fs_entity_kind_directory: {
+      //
+      // For directories in a *_sub state, first try for a child element:
+      //
+      switch ( e->state ) {
       
-        case fs_entity_kind_directory: {
+        case fs_entity_state_upload_sub:
+        case fs_entity_state_download_sub:
+        case fs_entity_state_delete_sub: {
+          node = row_selector(the_list, e, generation);
           //
-          // For directories in a *_sub state, first try for a child element:
+          // If nothing was returned, then the child chain has completed and
+          // this node can step forward and be returned:
           //
-          switch ( e->state ) {
-          
-            case fs_entity_state_upload_sub:
-            case fs_entity_state_download_sub:
-            case fs_entity_state_delete_sub: {
-              node = __fs_entity_next_node(the_list, e->child, generation);
-              //
-              // If nothing was returned, then the child chain has completed and
-              // this node can step forward and be returned:
-              //
-              if ( ! node ) {
-                fs_entity_list_advance_entity_state(the_list, e);
-                // If the state advanced into the fs_entity_state_download_sub state 
-                // (from fs_entity_state_upload_sub) and no children were waiting to
-                // change state then it's implied that theres nothing to download
-                // anyway, so advance again: 
-                if ( e->state == fs_entity_state_download_sub ) fs_entity_list_advance_entity_state(the_list, e);
-                node = e;
-              }
-              return node;
-            }
-            
-            default:
-              return e;
-          
+          if ( ! node ) {
+            fs_entity_list_advance_entity_state(the_list, e);
+            // If the state advanced into the fs_entity_state_download_sub state 
+            // (from fs_entity_state_upload_sub) and no children were waiting to
+            // change state then it's implied that theres nothing to download
+            // anyway, so advance again: 
+            if ( e->state == fs_entity_state_download_sub ) fs_entity_list_advance_entity_state(the_list, e);
+            node = e;
           }
-          break;
+          return node;
         }
         
-        case fs_entity_kind_file:
+        default:
           return e;
       
-        case fs_entity_kind_max:
-          break;
       }
+      break;
     }
-    e = e->sibling;
     
-    if ( ! e ) {
-      iteration++;
-      e = root_entity;
-    }
-  }
+    case fs_entity_kind_file:
+      return e;
   
-  // Should never get here:
+    case fs_entity_kind_max:
+      break;
+  }
   return NULL;
 }
 
 //
 
 fs_entity*
-fs_entity_list_next_node(
+__fs_entity_next_node(
   fs_entity_list  *the_list,
-  unsigned int    max_generation
+  fs_entity       *directory,
+  unsigned int    generation
+)
+{
+  fs_entity     *e;
+  bool          is_blocked = false;
+  
+  // Everything in this row is current generation.
+  if ( (directory->child_count == 0) || (directory->min_generation >= generation) ) return NULL;
+  
+  //
+  // While the list's generation holds steady the set of eligible children can
+  // only shrink, so the first of them is found by moving a cursor forward:
+  //
+  if ( directory->cursor_generation != the_list->generation ) {
+    directory->cursor_generation = the_list->generation;
+    directory->cursor = directory->child;
+  }
+  e = &the_list->root_entity[directory->cursor];
+  while ( e->generation >= generation ) {
+    directory->cursor = e->sibling;
+    e = &the_list->root_entity[directory->cursor];
+  }
+  
+  //
+  // Without anything in flight the first eligible child is always the answer;
+  // otherwise move on to its eligible siblings:
+  //
+  while ( e ) {
+    if ( e->generation < generation ) {
+      fs_entity *node = __fs_entity_select(the_list, e, generation, __fs_entity_next_node);
+      
+      if ( node != FS_ENTITY_BLOCKED ) return node;
+      is_blocked = true;
+    }
+    e = __fs_entity_sibling(the_list, e);
+  }
+  return is_blocked ? FS_ENTITY_BLOCKED : NULL;
+}
+
+//
+
+fs_entity*
+__fs_entity_list_select(
+  fs_entity_list              *the_list,
+  unsigned int                max_generation,
+  __fs_entity_row_selector_fn row_selector
 )
 {
   if ( the_list->generation < max_generation ) {
-    //
-    // Calculate the average hit count:
-    //
-    double        avg = fs_entity_generation_average(the_list->root_entity);
-    
-    // If the average is > the generation, increase the generation:
-    if ( avg >= (double)(1 + the_list->generation) ) {
+    // If every node has completed the next generation, move to it:
+    if ( fs_entity_list_generation_average(the_list) >= 1 + the_list->generation ) {
       the_list->generation++;
     }
-    if ( the_list->generation < max_generation ) return __fs_entity_next_node(the_list, the_list->root_entity, 1 + the_list->generation);
+    if ( (the_list->generation < max_generation) && (the_list->root_entity->generation <= the_list->generation) ) {
+      return __fs_entity_select(the_list, the_list->root_entity, 1 + the_list->generation, row_selector);
+    }
   }
   return NULL;
 }
 
 //
 
+fs_entity*
+fs_entity_list_next_node(
+  fs_entity_list  *the_list,
+  unsigned int    max_generation
+)
+{
+  fs_entity       *node = __fs_entity_list_select(the_list, max_generation, __fs_entity_next_node);
+  
+  return (node == FS_ENTITY_BLOCKED) ? NULL : node;
+}
+
+//
+
 fs_entity*
 __fs_entity_random_node(
   fs_entity_list  *the_list,
-  fs_entity       *root_entity,
+  fs_entity       *directory,
   unsigned int    generation
 )
 {
-  fs_entity     *e;
-  fs_entity     *node = NULL;
-  unsigned int  n = 0;
-  unsigned int  min_gen = generation;
-  unsigned int  iteration = 0;
-  
-  e = root_entity;
-  while ( e ) {
-    n++;
-    if ( e->generation < min_gen ) min_gen = e->generation;
-    e = e->sibling;
-  }
+  unsigned int  start, i;
   
   // Everything in this row is current generation.
-  if ( min_gen == generation ) return NULL;
+  if ( (directory->child_count == 0) || (directory->min_generation >= generation) ) return NULL;
   
-  e = root_entity;
-  while ( e ) {
-    if ( e->generation < generation ) {
-      //
-      // This node is eligible, should we use it?
-      //
-      if ( (iteration == 20) || (random_long_int() % n == 0) ) {
-        switch ( e->kind ) {
-        
-          case fs_entity_kind_directory: {
-            //
-            // For directories in a *_sub state, first try for a child element:
-            //
-            switch ( e->state ) {
-            
-              case fs_entity_state_upload_sub:
-              case fs_entity_state_download_sub:
-              case fs_entity_state_delete_sub: {
-                node = __fs_entity_random_node(the_list, e->child, generation);
-                //
-                // If nothing was returned, then the child chain has completed and
-                // this node can step forward and be returned:
-                //
-                if ( ! node ) {
-                  fs_entity_list_advance_entity_state(the_list, e);
-                  // If the state advanced into the fs_entity_state_download_sub state 
-                  // (from fs_entity_state_upload_sub) and no children were waiting to
-                  // change state then it's implied that theres nothing to download
-                  // anyway, so advance again: 
-                  if ( e->state == fs_entity_state_download_sub ) fs_entity_list_advance_entity_state(the_list, e);
-                  node = e;
-                }
-                return node;
-              }
-              
-              default:
-                return e;
-            
-            }
-            break;
-          }
-          
-          case fs_entity_kind_file:
-            return e;
-        
-          case fs_entity_kind_max:
-            break;
-        }
-      }
-    }
-    e = e->sibling;
+  __fs_entity_ready_sync(the_list, directory, generation);
+  
+  //
+  // Every child in the ready set is eligible, so any of them is a uniform
+  // choice; if it's blocked by something in flight, try the others in turn:
+  //
+  start = random_long_int() % directory->ready_count;
+  for ( i = 0; i < directory->ready_count; i++ ) {
+    fs_entity   *e = &the_list->root_entity[the_list->ready[directory->ready_base + (start + i) % directory->ready_count]];
+    fs_entity   *node = __fs_entity_select(the_list, e, generation, __fs_entity_random_node);
     
-    if ( ! e ) {
-      iteration++;
-      e = root_entity;
-    }
+    if ( node != FS_ENTITY_BLOCKED ) return node;
   }
-  
-  // Should never get here:
-  return NULL;
+  return FS_ENTITY_BLOCKED;
 }
 
 //
@@ -735,19 +1888,51 @@ fs_entity_list_random_node(
   unsigned int    max_generation
 )
 {
-  if ( the_list->generation < max_generation ) {
-    //
-    // Calculate the average hit count:
-    //
-    double        avg = fs_entity_generation_average(the_list->root_entity);
-    
-    // If the average is > the generation, increase the generation:
-    if ( avg >= (double)(1 + the_list->generation) ) {
-      the_list->generation++;
-    }
-    if ( the_list->generation < max_generation ) return __fs_entity_random_node(the_list, the_list->root_entity, 1 + the_list->generation);
+  fs_entity       *node;
+  
+  if ( ! the_list->ready && ! __fs_entity_list_ready_create(the_list) ) return NULL;
+  node = __fs_entity_list_select(the_list, max_generation, __fs_entity_random_node);
+  return (node == FS_ENTITY_BLOCKED) ? NULL : node;
+}
+
+//
+
+fs_entity*
+fs_entity_list_claim_node(
+  fs_entity_list  *the_list,
+  unsigned int    max_generation,
+  bool            is_random_walk,
+  bool            *is_blocked
+)
+{
+  fs_entity       *node;
+  
+  if ( is_random_walk ) {
+    if ( ! the_list->ready && ! __fs_entity_list_ready_create(the_list) ) return NULL;
+    node = __fs_entity_list_select(the_list, max_generation, __fs_entity_random_node);
+  } else {
+    node = __fs_entity_list_select(the_list, max_generation, __fs_entity_next_node);
   }
-  return NULL;
+  if ( node == FS_ENTITY_BLOCKED ) {
+    *is_blocked = true;
+    return NULL;
+  }
+  *is_blocked = false;
+  if ( node ) node->is_busy = true;
+  return node;
+}
+
+//
+
+void
+fs_entity_list_release_node(
+  fs_entity_list  *the_list,
+  fs_entity       *the_entity,
+  bool            should_advance
+)
+{
+  the_entity->is_busy = false;
+  if ( should_advance ) fs_entity_list_advance_entity_state(the_list, the_entity);
 }
 
 //
@@ -784,37 +1969,153 @@ fs_entity_list_set_state_is_enabled(
 
 //
 
-const char*
-fs_entity_list_url_for_entity(
+//
+// Names are percent-encoded as URL path segments:  everything but the RFC 3986
+// unreserved characters, sub-delimiters, ':' and '@' is escaped.
+//
+
+static inline bool
+__fs_entity_url_char_is_safe(
+  unsigned char     c
+)
+{
+  return ( isalnum(c) && (c < 0x80) ) || (c && strchr("-._~!$&'()*+,;=:@", c));
+}
+
+//
+
+size_t
+__fs_entity_url_encoded_len(
+  const char        *name
+)
+{
+  size_t            len = 0;
+  
+  while ( *name ) len += __fs_entity_url_char_is_safe(*name++) ? 1 : 3;
+  return len;
+}
+
+//
+
+char*
+__fs_entity_url_encode(
+  char              *dst,
+  const char        *name
+)
+{
+  static const char *hex_digits = "0123456789ABCDEF";
+  
+  while ( *name ) {
+    unsigned char   c = *name++;
+    
+    if ( __fs_entity_url_char_is_safe(c) ) {
+      *dst++ = c;
+    } else {
+      *dst++ = '%';
+      *dst++ = hex_digits[c >> 4];
+      *dst++ = hex_digits[c & 0xF];
+    }
+  }
+  return dst;
+}
+
+//
+
+bool
+fs_entity_list_set_base_url(
   fs_entity_list    *the_list,
-  const char        *base_url,
-  fs_entity         *the_entity
+  const char        *base_url
 )
 {
-  char              *url;
-  const char        *path = the_entity->path + strlen(the_list->base_path);
-  bool              path_has_leading_slash = (*path == '/') ? true : false;
-  bool              url_has_trailing_slash = (base_url[strlen(base_url) - 1] == '/') ? true : false;
-  const char        *trailing = (the_entity->kind == fs_entity_kind_directory) ? "/" : NULL;
+  size_t            base_url_len = strlen(base_url);
+  size_t            prefix_len = base_url_len + ((base_url_len && (base_url[base_url_len - 1] == '/')) ? 0 : 1);
+  size_t            *lengths = malloc(the_list->count * sizeof(size_t));
+  size_t            *offsets = malloc(the_list->count * sizeof(size_t));
+  size_t            total_len = 0, offset = 0;
+  char              *urls;
+  unsigned int      i;
+  
+  if ( ! lengths || ! offsets ) {
+    if ( lengths ) free((void*)lengths);
+    if ( offsets ) free((void*)offsets);
+    return false;
+  }
   
-  if ( path_has_leading_slash ) {
-    if ( url_has_trailing_slash ) {
-      url = strmcat(base_url, path + 1, trailing, NULL);
+  //
+  // Every URL is its parent's URL (which always ends in a slash) plus its own
+  // encoded name, so a first pass can size the arena exactly.  The root is the
+  // base URL, or for a lone file the base URL plus the file's name:
+  //
+  for ( i = 0; i < the_list->count; i++ ) {
+    fs_entity       *e = &the_list->root_entity[i];
+    
+    if ( i == 0 ) {
+      lengths[i] = prefix_len + ((e->kind == fs_entity_kind_directory) ? 0 : __fs_entity_url_encoded_len(the_list->names + e->name));
     } else {
-      url = strmcat(base_url, path, trailing, NULL);
+      lengths[i] = lengths[e->parent] + __fs_entity_url_encoded_len(the_list->names + e->name) + ((e->kind == fs_entity_kind_directory) ? 1 : 0);
     }
+    total_len += lengths[i] + 1;
   }
-  else if ( url_has_trailing_slash ) {
-    url = strmcat(base_url, path, trailing, NULL);
+  if ( ! (urls = malloc(total_len)) ) {
+    free((void*)lengths);
+    free((void*)offsets);
+    return false;
   }
-  else {
-    if ( strlen(path) > 0 ) {
-      url = strmcat(base_url, "/", path, trailing, NULL);
+  for ( i = 0; i < the_list->count; i++ ) {
+    fs_entity       *e = &the_list->root_entity[i];
+    char            *p = urls + offset;
+    
+    offsets[i] = offset;
+    if ( i == 0 ) {
+      memcpy(p, base_url, base_url_len);
+      p += base_url_len;
+      if ( prefix_len > base_url_len ) *p++ = '/';
+      if ( e->kind != fs_entity_kind_directory ) p = __fs_entity_url_encode(p, the_list->names + e->name);
     } else {
-      url = strmcat(base_url, trailing, NULL);
+      memcpy(p, urls + offsets[e->parent], lengths[e->parent]);
+      p = __fs_entity_url_encode(p + lengths[e->parent], the_list->names + e->name);
+      if ( e->kind == fs_entity_kind_directory ) *p++ = '/';
     }
+    *p = '\0';
+    offset += lengths[i] + 1;
+  }
+  free((void*)lengths);
+  if ( the_list->urls ) free((void*)the_list->urls);
+  if ( the_list->url_offsets ) free((void*)the_list->url_offsets);
+  the_list->urls = urls;
+  the_list->url_offsets = offsets;
+  return true;
+}
+
+//
+
+const char*
+fs_entity_list_url_for_entity(
+  fs_entity_list    *the_list,
+  fs_entity         *the_entity
+)
+{
+  if ( ! the_list->urls ) return NULL;
+  return the_list->urls + the_list->url_offsets[the_entity - the_list->root_entity];
+}
+
+//
+
+http_stats_ref
+fs_entity_list_stats_for_entity(
+  fs_entity_list    *the_list,
+  fs_entity         *the_entity,
+  http_ops_method   method
+)
+{
+  if ( (method < http_ops_method_get) || (method >= http_ops_method_max) ) return NULL;
+  if ( ! the_entity->http_stats ) {
+    if ( ! (the_entity->http_stats = calloc(http_ops_method_max, sizeof(http_stats_ref))) ) return NULL;
   }
-  return (const char*)url;
+  if ( ! the_entity->http_stats[method] ) {
+    the_entity->http_stats[method] = the_list->stats_pool ? http_stats_pool_alloc(the_list->stats_pool) : NULL;
+  }
+  return the_entity->http_stats[method];
 }
 
 //
@@ -836,13 +2137,23 @@ __fs_entity_stats_fprint(
   FILE                    *fptr,
   http_stats_format 			format,
   http_stats_print_flags	flags, 
-  fs_entity               *entity
+  fs_entity_list          *the_list,
+  http_stats_ref          empty_stats
 )
 {
+	unsigned int						i;
+	char										*path = NULL;
+	size_t									path_capacity = 0;
+	
+	//
+	// The node array is already in depth-first order, so there's no need to
+	// walk the tree:
+	//
 	switch ( format ) {
 	
 		case http_stats_format_table: {
-			while ( entity ) {
+			for ( i = 0; i < the_list->count; i++ ) {
+				fs_entity							*entity = &the_list->root_entity[i];
 				http_ops_method				i_m;
 		
 				if ( (format & fs_entity_print_format_kind) == fs_entity_print_format_kind ) {
@@ -851,26 +2162,22 @@ __fs_entity_stats_fprint(
 		
 				if ( (format & fs_entity_print_format_name) == fs_entity_print_format_name ) {
 					if ( (format & fs_entity_print_format_path) == fs_entity_print_format_path ) {
-						fprintf(fptr, "%s (%s)\n", entity->name, entity->path);
+						if ( fs_entity_list_copy_path_for_entity(the_list, entity, &path, &path_capacity) ) fprintf(fptr, "%s (%s)\n", fs_entity_list_name_for_entity(the_list, entity), path);
 					} else {
-						fprintf(fptr, "%s\n", entity->name);
+						fprintf(fptr, "%s\n", fs_entity_list_name_for_entity(the_list, entity));
 					}
 				} else if ( (format & fs_entity_print_format_path) == fs_entity_print_format_path ) {
-					fprintf(fptr, "%s\n", entity->path);
+					if ( fs_entity_list_copy_path_for_entity(the_list, entity, &path, &path_capacity) ) fprintf(fptr, "%s\n", path);
 				}
-				for ( i_m = http_ops_method_get; i_m < http_ops_method_max; i_m++ ) {
-					if ( ! http_stats_is_empty(entity->http_stats[i_m]) ) {
-						fprintf(fptr, "[%s]\n", http_ops_method_get_string(i_m));
-						http_stats_fprint(fptr, format, flags, entity->http_stats[i_m]);
-						fprintf(fptr, "\n");
+				if ( entity->http_stats ) {
+					for ( i_m = http_ops_method_get; i_m < http_ops_method_max; i_m++ ) {
+						if ( entity->http_stats[i_m] && ! http_stats_is_empty(entity->http_stats[i_m]) ) {
+							fprintf(fptr, "[%s]\n", http_ops_method_get_string(i_m));
+							http_stats_fprint(fptr, format, flags, entity->http_stats[i_m]);
+							fprintf(fptr, "\n");
+						}
 					}
 				}
-		
-				// Handle all children:
-				if ( (entity->kind == fs_entity_kind_directory) && entity->child ) __fs_entity_stats_fprint(fptr, format, flags, entity->child);
-	
-				// Next sibling:
-				entity = entity->sibling;
 			}
 			break;
 		}
@@ -887,24 +2194,22 @@ __fs_entity_stats_fprint(
 				case http_stats_format_max:
 					break;
 			}
-			while ( entity ) {
+			for ( i = 0; i < the_list->count; i++ ) {
+				fs_entity							*entity = &the_list->root_entity[i];
 				http_ops_method				i_m;
 				
+				if ( ! fs_entity_list_copy_path_for_entity(the_list, entity, &path, &path_capacity) ) break;
 				for ( i_m = http_ops_method_get; i_m < http_ops_method_max; i_m++ ) {
+					http_stats_ref			stats = (entity->http_stats && entity->http_stats[i_m]) ? entity->http_stats[i_m] : empty_stats;
+					
 					fprintf(fptr,
 							"\"%s\"%c\"%s\"%c\"%s\"%c",
 							__fs_entity_kind_to_string(entity->kind), delim,
-							entity->path, delim,
+							path, delim,
 							http_ops_method_get_string(i_m), delim
 						);
-					http_stats_fprint(fptr, format, (flags | http_stats_print_flags_no_header) & ~http_stats_print_flags_header_only, entity->http_stats[i_m]);
+					http_stats_fprint(fptr, format, (flags | http_stats_print_flags_no_header) & ~http_stats_print_flags_header_only, stats);
 				}
-		
-				// Handle all children:
-				if ( (entity->kind == fs_entity_kind_directory) && entity->child ) __fs_entity_stats_fprint(fptr, format, (flags | http_stats_print_flags_no_header) & ~http_stats_print_flags_header_only, entity->child);
-	
-				// Next sibling:
-				entity = entity->sibling;
 			}
 			break;
 		}
@@ -913,6 +2218,7 @@ __fs_entity_stats_fprint(
 			break;
 		
 	}
+	if ( path ) free((void*)path);
 }
 
 void
@@ -951,5 +2257,27 @@ fs_entity_list_stats_fprint(
 				break;
 		}
 	}
-  __fs_entity_stats_fprint(fptr, format, flags, the_list->root_entity);
+	switch ( format ) {
+		case http_stats_format_table:
+			__fs_entity_stats_fprint(fptr, format, flags, the_list, NULL);
+			break;
+			
+		case http_stats_format_csv:
+		case http_stats_format_tsv: {
+			//
+			// Entities never operated on have no stats, but every entity still gets
+			// a (blank) row:
+			//
+			http_stats_ref	empty_stats = http_stats_create();
+			
+			if ( empty_stats ) {
+				__fs_entity_stats_fprint(fptr, format, flags, the_list, empty_stats);
+				http_stats_destroy(empty_stats);
+			}
+			break;
+		}
+			
+		case http_stats_format_max:
+			break;
+	}
 }
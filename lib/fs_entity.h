@@ -33,33 +33,83 @@ typedef enum {
   fs_entity_state_max
 } fs_entity_state;
 
+#define FS_ENTITY_INDEX_NONE  ((unsigned int)-1)
+
+//
+// Entities don't carry their own paths:  the name is an offset into the list's
+// name arena and the tree is linked by index into the list's node array (see
+// fs_entity_list_path_for_entity() to rebuild a full path).
+//
 typedef struct _fs_entity {
   fs_entity_kind      kind;
-  const char          *path;
-  const char          *name;
-  
-  unsigned int        generation;
-  size_t              size;
   fs_entity_state     state;
+  unsigned int        generation;
   unsigned int        disabled_states;
-  http_stats_ref      http_stats[http_ops_method_max];
+  bool                is_busy;
+  size_t              size;
+  
+  unsigned int        name;
+  unsigned int        parent, child, sibling;
   
-  struct _fs_entity   *sibling, *child;
+  //
+  // For directories:  the lowest generation among the children (and how many
+  // are at it), and where a sequential walk should resume:
+  //
+  unsigned int        child_count;
+  unsigned int        min_generation, min_count;
+  unsigned int        cursor, cursor_generation;
+  
+  //
+  // Random walk ready set (see fs_entity_list_random_node()):  a directory's
+  // slice of the list's ready array, and each entity's slot within its parent's:
+  //
+  unsigned int        ready_base, ready_count, ready_generation;
+  unsigned int        ready_slot;
+  
+  http_stats_ref      *http_stats;
 } fs_entity;
 
+//
+// All entities live in a single array in depth-first order, the root at index
+// zero.
+//
 typedef struct _fs_entity_list {
   unsigned int        count;
   unsigned int        generation;
+  unsigned long long  generation_sum;
   unsigned int        disabled_states;
   const char          *base_path;
+  const char          *root_path;
   fs_entity           *root_entity;
+  char                *names;
+  size_t              names_len;
+  unsigned int        *ready;
+  char                *urls;
+  size_t              *url_offsets;
+  http_stats_pool_ref stats_pool;
 } fs_entity_list;
 
-fs_entity_list* fs_entity_list_create_with_path(const char *path);
+//
+// Directories are scanned by scan_threads threads at once (0 selects the number
+// of online CPUs); more threads than CPUs pays off on high-latency storage.
+//
+// If index_path is not NULL the scan results are saved there, and the next scan
+// of the same path only reads directories whose mtime has changed since.  A
+// file rewritten in place does not change its directory's mtime, so its size
+// is not picked up until the index is removed.
+//
+fs_entity_list* fs_entity_list_create_with_path(const char *path, unsigned int scan_threads, const char *index_path);
+
+//
+// A tree of count entities built in memory (no filesystem involved), each
+// directory holding up to fanout children; for benchmarking the list itself:
+//
+fs_entity_list* fs_entity_list_create_synthetic(unsigned int count, unsigned int fanout);
 
 void fs_entity_list_destroy(fs_entity_list *the_list);
 
 unsigned int fs_entity_list_hits_average(fs_entity_list *the_list);
+unsigned int fs_entity_list_generation_average(fs_entity_list *the_list);
 
 typedef enum {
   fs_entity_print_format_kind       = 1 << 0,
@@ -79,8 +129,8 @@ typedef enum {
   fs_entity_print_format_short      = fs_entity_print_format_kind | fs_entity_print_format_name
 } fs_entity_print_format;
 
-void fs_entity_print(fs_entity_print_format format, fs_entity *entity);
-void fs_entity_fprint(FILE *fptr, fs_entity_print_format format, fs_entity *entity);
+void fs_entity_print(fs_entity_print_format format, fs_entity_list *the_list, fs_entity *entity);
+void fs_entity_fprint(FILE *fptr, fs_entity_print_format format, fs_entity_list *the_list, fs_entity *entity);
 
 bool fs_entity_get_state_is_enabled(fs_entity *entity, fs_entity_state state);
 void fs_entity_set_state_is_enabled(fs_entity *entity, fs_entity_state state, bool is_enabled);
@@ -91,12 +141,43 @@ void fs_entity_list_fprint(FILE *fptr, fs_entity_print_format format, fs_entity_
 fs_entity* fs_entity_list_next_node(fs_entity_list *the_list, unsigned int max_generation);
 fs_entity* fs_entity_list_random_node(fs_entity_list *the_list, unsigned int max_generation);
 
+//
+// For running several operations at once:  a claimed entity is in flight and
+// neither it nor anything that depends on it will be selected again until it's
+// released (advancing its state if the operation succeeded).  NULL is returned
+// when no work remains, or with *is_blocked set when all remaining work waits
+// on entities in flight.  The caller must serialize all calls on a list.
+//
+fs_entity* fs_entity_list_claim_node(fs_entity_list *the_list, unsigned int max_generation, bool is_random_walk, bool *is_blocked);
+void fs_entity_list_release_node(fs_entity_list *the_list, fs_entity *the_entity, bool should_advance);
+
 bool fs_entity_list_get_state_is_enabled(fs_entity_list *the_list, fs_entity_state state);
 void fs_entity_list_set_state_is_enabled(fs_entity_list *the_list, fs_entity_state state, bool is_enabled);
 
 void fs_entity_list_advance_entity_state(fs_entity_list *the_list, fs_entity *root_entity);
 
-const char* fs_entity_list_url_for_entity(fs_entity_list *the_list, const char *base_url, fs_entity *the_entity);
+const char* fs_entity_list_name_for_entity(fs_entity_list *the_list, fs_entity *the_entity);
+
+//
+// Paths are rebuilt on demand; the _copy_ variant reuses (and grows as necessary)
+// the caller's buffer, the other returns a string the caller must free:
+//
+bool fs_entity_list_copy_path_for_entity(fs_entity_list *the_list, fs_entity *the_entity, char* *buffer, size_t *capacity);
+const char* fs_entity_list_path_for_entity(fs_entity_list *the_list, fs_entity *the_entity);
+
+//
+// URLs are built for every entity at once when the base URL is set, with the
+// names percent-encoded; the strings belong to the list (NULL is returned if
+// no base URL has been set) and stay valid until the base URL changes:
+//
+bool fs_entity_list_set_base_url(fs_entity_list *the_list, const char *base_url);
+const char* fs_entity_list_url_for_entity(fs_entity_list *the_list, fs_entity *the_entity);
+
+//
+// Entities start out with no stats; this returns the entity's stats for the
+// given method, allocating them (from the list's pool) on first use:
+//
+http_stats_ref fs_entity_list_stats_for_entity(fs_entity_list *the_list, fs_entity *the_entity, http_ops_method method);
 
 void fs_entity_list_stats_print(http_stats_format format, http_stats_print_flags flags, fs_entity_list *the_list);
 void fs_entity_list_stats_fprint(FILE *fptr, http_stats_format format, http_stats_print_flags flags, fs_entity_list *the_list);
@@ -0,0 +1,297 @@
+//
+// http_multi.c
+//
+
+#include "http_multi.h"
+#include "util_fns.h"
+
+//
+
+typedef struct {
+  CURL          *curl_request;
+  unsigned int  attempt;
+  void          *context;
+  double        scheduled_time;
+  double        start_time;
+  char          *url;
+  size_t        url_capacity;
+  char          curl_error_buffer[CURL_ERROR_SIZE];
+} http_multi_slot;
+
+//
+
+typedef struct _http_multi {
+  http_ops_ref        ops;
+  CURLM               *multi_handle;
+  unsigned int        concurrency;
+  unsigned int        in_flight;
+  http_multi_slot     *slots;
+  unsigned int        *free_slots;
+} http_multi;
+
+//
+
+http_multi_ref
+http_multi_create(
+  http_ops_ref    ops,
+  unsigned int    concurrency
+)
+{
+  http_multi      *new_multi = NULL;
+
+  if ( concurrency > 0 ) {
+    new_multi = malloc(sizeof(http_multi) + concurrency * (sizeof(http_multi_slot) + sizeof(unsigned int)));
+    if ( new_multi ) {
+      unsigned int    i;
+
+      memset(new_multi, 0, sizeof(http_multi));
+      new_multi->ops = ops;
+      new_multi->concurrency = concurrency;
+      new_multi->slots = ((void*)new_multi) + sizeof(http_multi);
+      new_multi->free_slots = (unsigned int*)(new_multi->slots + concurrency);
+      memset(new_multi->slots, 0, concurrency * sizeof(http_multi_slot));
+
+      if ( ! (new_multi->multi_handle = curl_multi_init()) ) {
+        free((void*)new_multi);
+        return NULL;
+      }
+      curl_multi_setopt(new_multi->multi_handle, CURLMOPT_MAXCONNECTS, (long)concurrency);
+
+      //
+      // All slots start out free; the free list is a stack so the most
+      // recently used (and likely still connected) handle is reused first:
+      //
+      for ( i = 0; i < concurrency; i++ ) {
+        http_multi_slot   *slot = &new_multi->slots[i];
+
+        slot->curl_request = http_ops_curl_handle_create(ops, http_ops_curl_request_get, &slot->curl_error_buffer[0]);
+        if ( ! slot->curl_request ) {
+          http_multi_destroy(new_multi);
+          return NULL;
+        }
+        curl_easy_setopt(slot->curl_request, CURLOPT_PRIVATE, (char*)slot);
+        // Response bodies are only timed, never kept:
+        curl_easy_setopt(slot->curl_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
+        curl_easy_setopt(slot->curl_request, CURLOPT_WRITEDATA, NULL);
+        new_multi->free_slots[i] = concurrency - i - 1;
+      }
+    }
+  }
+  return new_multi;
+}
+
+//
+
+void
+http_multi_destroy(
+  http_multi_ref  multi
+)
+{
+  unsigned int    i;
+
+  for ( i = 0; i < multi->concurrency; i++ ) {
+    http_multi_slot   *slot = &multi->slots[i];
+
+    if ( slot->curl_request ) {
+      curl_multi_remove_handle(multi->multi_handle, slot->curl_request);
+      curl_easy_cleanup(slot->curl_request);
+    }
+    if ( slot->url ) free((void*)slot->url);
+  }
+  if ( multi->multi_handle ) curl_multi_cleanup(multi->multi_handle);
+  free((void*)multi);
+}
+
+//
+
+unsigned int
+http_multi_get_concurrency(
+  http_multi_ref  multi
+)
+{
+  return multi->concurrency;
+}
+
+//
+
+unsigned int
+http_multi_get_in_flight(
+  http_multi_ref  multi
+)
+{
+  return multi->in_flight;
+}
+
+//
+
+bool
+http_multi_has_free_slot(
+  http_multi_ref  multi
+)
+{
+  return (multi->in_flight < multi->concurrency) ? true : false;
+}
+
+//
+
+bool
+http_multi_download(
+  http_multi_ref  multi,
+  const char      *url,
+  void            *context
+)
+{
+  return http_multi_download_scheduled(multi, url, 0.0, context);
+}
+
+//
+
+bool
+http_multi_download_scheduled(
+  http_multi_ref  multi,
+  const char      *url,
+  double          scheduled_time,
+  void            *context
+)
+{
+  http_multi_slot   *slot;
+  size_t            url_len = strlen(url) + 1;
+  http_progress_ref progress;
+
+  if ( multi->in_flight >= multi->concurrency ) return false;
+
+  slot = &multi->slots[multi->free_slots[multi->concurrency - multi->in_flight - 1]];
+
+  //
+  // The slot keeps its own copy of the URL so that it can be handed back
+  // to the completion callback; the buffer only ever grows:
+  //
+  if ( url_len > slot->url_capacity ) {
+    char          *new_url = realloc(slot->url, url_len);
+
+    if ( ! new_url ) return false;
+    slot->url = new_url;
+    slot->url_capacity = url_len;
+  }
+  memcpy(slot->url, url, url_len);
+  slot->attempt = 0;
+  slot->context = context;
+  slot->curl_error_buffer[0] = '\0';
+  
+  //
+  // Without an intended start time the request is considered to have been
+  // scheduled for right now:
+  //
+  slot->start_time = monotonic_seconds();
+  slot->scheduled_time = (scheduled_time > 0.0) ? scheduled_time : slot->start_time;
+
+  curl_easy_setopt(slot->curl_request, CURLOPT_URL, slot->url);
+  if ( curl_multi_add_handle(multi->multi_handle, slot->curl_request) != CURLM_OK ) return false;
+  if ( (progress = http_ops_get_progress(multi->ops)) ) http_progress_note_start(progress);
+  multi->in_flight++;
+  return true;
+}
+
+//
+
+int
+__http_multi_drain(
+  http_multi                *multi,
+  http_multi_completion_fn  callback,
+  void                      *callback_context
+)
+{
+  CURLMsg       *msg;
+  int           msgs_left;
+  int           n_done = 0;
+  http_progress_ref progress = http_ops_get_progress(multi->ops);
+
+  while ( (msg = curl_multi_info_read(multi->multi_handle, &msgs_left)) ) {
+    if ( msg->msg == CURLMSG_DONE ) {
+      http_multi_slot     *slot = NULL;
+      http_multi_result   result;
+      bool                should_retry = false;
+
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&slot);
+
+      result.curl_request = msg->easy_handle;
+      result.ccode = msg->data.result;
+      result.url = slot->url;
+      result.error_buffer = &slot->curl_error_buffer[0];
+      result.attempt = slot->attempt;
+      result.context = slot->context;
+      result.scheduled_time = slot->scheduled_time;
+      result.start_time = slot->start_time;
+      result.http_status = -1;
+      result.has_stats = (result.ccode == CURLE_OK) ? http_stats_record_from_curl(slot->curl_request, &result.http_status, &result.req_stats) : false;
+
+      curl_multi_remove_handle(multi->multi_handle, slot->curl_request);
+      n_done++;
+      
+      if ( progress ) {
+        if ( result.has_stats ) {
+          http_progress_note_finish(progress, result.http_status, result.req_stats[http_stats_field_total], result.req_stats[http_stats_field_content_bytes]);
+        } else {
+          http_progress_note_failure(progress);
+        }
+      }
+
+      if ( callback ) should_retry = callback(&result, callback_context);
+      while ( should_retry ) {
+        CURLMcode         mcode;
+        
+        slot->attempt++;
+        slot->curl_error_buffer[0] = '\0';
+        slot->start_time = monotonic_seconds();
+        if ( progress ) http_progress_note_start(progress);
+        if ( (mcode = curl_multi_add_handle(multi->multi_handle, slot->curl_request)) == CURLM_OK ) break;
+        
+        //
+        // The retry could not even be issued, so it fails like any other
+        // attempt and the callback gets to report it (or try again):
+        //
+        if ( progress ) http_progress_note_failure(progress);
+        snprintf(slot->curl_error_buffer, CURL_ERROR_SIZE, "unable to re-issue request:  %s", curl_multi_strerror(mcode));
+        result.ccode = CURLE_FAILED_INIT;
+        result.attempt = slot->attempt;
+        result.start_time = slot->start_time;
+        result.has_stats = false;
+        should_retry = callback(&result, callback_context);
+      }
+      if ( should_retry ) continue;
+
+      // Return the slot to the free list:
+      multi->in_flight--;
+      multi->free_slots[multi->concurrency - multi->in_flight - 1] = slot - multi->slots;
+    }
+  }
+  return n_done;
+}
+
+//
+
+int
+http_multi_perform(
+  http_multi_ref            multi,
+  int                       timeout_ms,
+  http_multi_completion_fn  callback,
+  void                      *callback_context
+)
+{
+  int           still_running = 0;
+  int           n_done;
+
+  if ( curl_multi_perform(multi->multi_handle, &still_running) != CURLM_OK ) return -1;
+  n_done = __http_multi_drain(multi, callback, callback_context);
+
+  //
+  // Nothing finished yet, so block until there's socket activity or
+  // the timeout expires:
+  //
+  if ( (n_done == 0) && (multi->in_flight > 0) ) {
+    if ( curl_multi_wait(multi->multi_handle, NULL, 0, timeout_ms, NULL) != CURLM_OK ) return -1;
+    if ( curl_multi_perform(multi->multi_handle, &still_running) != CURLM_OK ) return -1;
+    n_done = __http_multi_drain(multi, callback, callback_context);
+  }
+  return n_done;
+}
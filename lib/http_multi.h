@@ -0,0 +1,51 @@
+//
+// http_multi.h
+//
+
+#ifndef __HTTP_MULTI_H__
+#define __HTTP_MULTI_H__
+
+#include "http_ops.h"
+
+#include <curl/curl.h>
+
+typedef struct _http_multi * http_multi_ref;
+
+//
+// When a transfer succeeds its status and timings are read from cURL once,
+// into http_status and req_stats; has_stats is false if the transfer failed
+// or produced no usable status:
+//
+typedef struct {
+  CURL              *curl_request;
+  CURLcode          ccode;
+  const char        *url;
+  const char        *error_buffer;
+  unsigned int      attempt;
+  void              *context;
+  double            scheduled_time;
+  double            start_time;
+  bool              has_stats;
+  long              http_status;
+  http_stats_record req_stats;
+} http_multi_result;
+
+//
+// Called once for each transfer that finishes; returning true re-issues
+// the same request (e.g. for a retry) in the same slot.
+//
+typedef bool (*http_multi_completion_fn)(http_multi_result *result, void *callback_context);
+
+http_multi_ref http_multi_create(http_ops_ref ops, unsigned int concurrency);
+void http_multi_destroy(http_multi_ref multi);
+
+unsigned int http_multi_get_concurrency(http_multi_ref multi);
+unsigned int http_multi_get_in_flight(http_multi_ref multi);
+bool http_multi_has_free_slot(http_multi_ref multi);
+
+bool http_multi_download(http_multi_ref multi, const char *url, void *context);
+bool http_multi_download_scheduled(http_multi_ref multi, const char *url, double scheduled_time, void *context);
+
+int http_multi_perform(http_multi_ref multi, int timeout_ms, http_multi_completion_fn callback, void *callback_context);
+
+#endif /* __HTTP_MULTI_H__ */
@@ -7,6 +7,8 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 //
 
@@ -30,7 +32,7 @@ http_ops_method_get_string(
 //
 
 size_t
-__http_ops_null_write(
+http_ops_null_write(
   char      *ptr,
   size_t    size,
   size_t    nmemb,
@@ -107,69 +109,136 @@ __http_ops_null_read(
 }
 
 //
-
-static const char   *__http_ops_propfind_read_data =
-        "<?xml version=\"1.0\"?>"
-        "<a:propfind xmlns:a=\"DAV:\">"
-        "<a:allprop/>"
-        "</a:propfind>";
-static size_t       __http_ops_propfind_read_data_offset = 0;
-static size_t       __http_ops_propfind_read_data_length = -1;
-
-void
-__http_ops_propfind_read_data_reset(void)
-{
-  __http_ops_propfind_read_data_offset = 0;
-  __http_ops_propfind_read_data_length = strlen(__http_ops_propfind_read_data);
-}
-
+// PUT bodies are fed straight from the file:  mapped into memory when
+// possible, otherwise pread() directly into cURL's upload buffer.  Either way
+// the request carries a real Content-Length rather than being chunked.
 //
 
+typedef struct {
+  int                     fd;
+  const char              *map;
+  payload_generator_ref   payload;
+  uint64_t                payload_offset;
+  curl_off_t              length, offset;
+} http_ops_upload_source;
+
 size_t
-__http_ops_propfind_read(
-  void      *ptr,
+__http_ops_upload_read(
+  char      *ptr,
   size_t    size,
   size_t    nmemb,
   void      *stream
 )
 {
-  size_t    total_size = size * nmemb;
-  size_t    remnant_size = __http_ops_propfind_read_data_length - __http_ops_propfind_read_data_offset;
+  http_ops_upload_source  *S = (http_ops_upload_source*)stream;
+  size_t                  bytes_try = size * nmemb;
   
-  if ( remnant_size == 0 ) return 0;
-
-  if ( total_size < remnant_size ) {
-    memcpy(
-        ptr,
-        __http_ops_propfind_read_data + __http_ops_propfind_read_data_offset,
-        total_size
-      );
-    __http_ops_propfind_read_data_offset += total_size;
-    return total_size;
+  if ( S->offset >= S->length ) return 0;
+  if ( (curl_off_t)bytes_try > (S->length - S->offset) ) bytes_try = (size_t)(S->length - S->offset);
+  if ( S->map ) {
+    memcpy(ptr, S->map + S->offset, bytes_try);
+  } else if ( S->payload ) {
+    payload_generator_fill(S->payload, S->payload_offset, S->offset, ptr, bytes_try);
+  } else {
+    ssize_t               bytes_read = pread(S->fd, ptr, bytes_try, S->offset);
+    
+    // The file shrank out from under us, so the Content-Length is a lie:
+    if ( bytes_read <= 0 ) return CURL_READFUNC_ABORT;
+    bytes_try = bytes_read;
   }
-  
-  memcpy(
-      ptr,
-      __http_ops_propfind_read_data + __http_ops_propfind_read_data_offset,
-      remnant_size
-    );
-  return remnant_size;
+  S->offset += bytes_try;
+  return bytes_try;
+}
 
+int
+__http_ops_upload_seek(
+  void        *userp,
+  curl_off_t  offset,
+  int         origin
+)
+{
+  http_ops_upload_source  *S = (http_ops_upload_source*)userp;
+  
+  //
+  // cURL rewinds the body when it has to resend it (e.g. after a redirect or
+  // an authentication challenge):
+  //
+  switch ( origin ) {
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += S->offset;
+      break;
+    case SEEK_END:
+      offset += S->length;
+      break;
+    default:
+      return CURL_SEEKFUNC_CANTSEEK;
+  }
+  if ( offset < 0 || offset > S->length ) return CURL_SEEKFUNC_FAIL;
+  S->offset = offset;
+  return CURL_SEEKFUNC_OK;
 }
 
 //
 
+static const char   *__http_ops_propfind_read_data =
+        "<?xml version=\"1.0\"?>"
+        "<a:propfind xmlns:a=\"DAV:\">"
+        "<a:allprop/>"
+        "</a:propfind>";
+
+//
+
 typedef struct _http_ops {
   bool                is_verbose;
   struct curl_slist   *resolve_list;
   const char          *username, *password;
+  const char          *unix_socket_path;
   bool                should_verify_peer;
   bool                should_follow_redirects;
+  long                upload_buffer_size;
+  http_stats_series_ref stats_series;
+  http_progress_ref   progress;
+  CURLSH              *share;
   CURL*               request_objs[http_ops_curl_request_max];
   struct curl_slist*  request_headers[http_ops_curl_request_max];
+  unsigned int        needs_configure;
+  size_t              propfind_read_offset;
+  struct curl_slist   range_header;
+  bool                is_range_header_set;
+  char                range_header_buffer[24 + 32 + 32];
   char                curl_error_buffer[CURL_ERROR_SIZE];
 } http_ops;
 
+//
+// Any change to the ops' settings means every cached handle must be reset and
+// configured again before its next use:
+//
+#define HTTP_OPS_NEEDS_CONFIGURE_ALL    ((1 << http_ops_curl_request_max) - 1)
+
+//
+
+size_t
+__http_ops_propfind_read(
+  void      *ptr,
+  size_t    size,
+  size_t    nmemb,
+  void      *stream
+)
+{
+  http_ops  *ops = (http_ops*)stream;
+  size_t    total_size = size * nmemb;
+  size_t    remnant_size = strlen(__http_ops_propfind_read_data) - ops->propfind_read_offset;
+  
+  if ( total_size > remnant_size ) total_size = remnant_size;
+  if ( total_size ) {
+    memcpy(ptr, __http_ops_propfind_read_data + ops->propfind_read_offset, total_size);
+    ops->propfind_read_offset += total_size;
+  }
+  return total_size;
+}
+
 //
 
 bool
@@ -186,38 +255,27 @@ __http_ops_add_header(
 
 //
 
-CURL*
-__http_ops_get_curl_request(
+size_t __http_ops_options_header_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+
+//
+
+void
+__http_ops_configure_curl_request(
   http_ops                *ops,
-  http_ops_curl_request   request
+  http_ops_curl_request   request,
+  CURL                    *new_request,
+  char                    *error_buffer
 )
 {
-  CURL        *new_request = NULL;
-  
-  if ( ops->request_objs[request] ) {
-    new_request = ops->request_objs[request];
-    curl_easy_reset(new_request);
-    
-    // Dispose of the cached request headers?
-    if ( ops->request_headers[request] ) {
-      switch ( request ) {
-        case http_ops_curl_request_get:
-        case http_ops_curl_request_put: {
-          curl_slist_free_all(ops->request_headers[request]);
-          ops->request_headers[request] = NULL;
-        }
-        default:
-          break;
-      }
-    }
-  } else {
-    ops->request_objs[request] = new_request = curl_easy_init();
-  }
   if ( new_request ) {
     curl_easy_setopt(new_request, CURLOPT_VERBOSE, ops->is_verbose ? 1L : 0L);
     curl_easy_setopt(new_request, CURLOPT_FOLLOWLOCATION, ops->should_follow_redirects ? 1L : 0L);
-    curl_easy_setopt(new_request, CURLOPT_ERRORBUFFER, &ops->curl_error_buffer[0]);
+    curl_easy_setopt(new_request, CURLOPT_ERRORBUFFER, error_buffer);
     if ( ops->resolve_list ) curl_easy_setopt(new_request, CURLOPT_RESOLVE, ops->resolve_list);
+    if ( ops->share ) curl_easy_setopt(new_request, CURLOPT_SHARE, ops->share);
+#if LIBCURL_VERSION_NUM >= 0x072800
+    curl_easy_setopt(new_request, CURLOPT_UNIX_SOCKET_PATH, ops->unix_socket_path);
+#endif
     if ( ops->username ) {
       curl_easy_setopt(new_request, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
       curl_easy_setopt(new_request, CURLOPT_USERNAME, ops->username);
@@ -239,9 +297,14 @@ __http_ops_get_curl_request(
     
       case http_ops_curl_request_put:
         curl_easy_setopt(new_request, CURLOPT_UPLOAD, 1L);
-        curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_null_read);
+        curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_upload_read);
         curl_easy_setopt(new_request, CURLOPT_READDATA, NULL);
-        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+        curl_easy_setopt(new_request, CURLOPT_SEEKFUNCTION, __http_ops_upload_seek);
+        curl_easy_setopt(new_request, CURLOPT_SEEKDATA, NULL);
+#if LIBCURL_VERSION_NUM >= 0x073E00
+        if ( ops->upload_buffer_size > 0 ) curl_easy_setopt(new_request, CURLOPT_UPLOAD_BUFFERSIZE, ops->upload_buffer_size);
+#endif
+        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
         curl_easy_setopt(new_request, CURLOPT_WRITEDATA, NULL);
         break;
         
@@ -249,7 +312,7 @@ __http_ops_get_curl_request(
         curl_easy_setopt(new_request, CURLOPT_CUSTOMREQUEST, "DELETE");
         curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_null_read);
         curl_easy_setopt(new_request, CURLOPT_READDATA, NULL);
-        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
         curl_easy_setopt(new_request, CURLOPT_WRITEDATA, NULL);
         break;
     
@@ -257,7 +320,7 @@ __http_ops_get_curl_request(
         curl_easy_setopt(new_request, CURLOPT_CUSTOMREQUEST, "MKCOL");
         curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_null_read);
         curl_easy_setopt(new_request, CURLOPT_READDATA, NULL);
-        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
         curl_easy_setopt(new_request, CURLOPT_WRITEDATA, NULL);
         break;
       
@@ -270,8 +333,8 @@ __http_ops_get_curl_request(
         }
         curl_easy_setopt(new_request, CURLOPT_HTTPHEADER, ops->request_headers[request]);
         curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_propfind_read);
-        curl_easy_setopt(new_request, CURLOPT_READDATA, NULL);
-        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+        curl_easy_setopt(new_request, CURLOPT_READDATA, ops);
+        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
         curl_easy_setopt(new_request, CURLOPT_WRITEDATA, NULL);
         break;
       
@@ -279,15 +342,93 @@ __http_ops_get_curl_request(
         curl_easy_setopt(new_request, CURLOPT_CUSTOMREQUEST, "OPTIONS");
         curl_easy_setopt(new_request, CURLOPT_READFUNCTION, __http_ops_null_read);
         curl_easy_setopt(new_request, CURLOPT_READDATA, NULL);
-        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+        curl_easy_setopt(new_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
         curl_easy_setopt(new_request, CURLOPT_WRITEDATA, NULL);
+        curl_easy_setopt(new_request, CURLOPT_HEADERFUNCTION, __http_ops_options_header_callback);
       
       case http_ops_curl_request_max:
         break;
     
     }
   }
-  return new_request;
+}
+
+//
+
+CURL*
+__http_ops_get_curl_request(
+  http_ops                *ops,
+  http_ops_curl_request   request
+)
+{
+  CURL        *the_request = ops->request_objs[request];
+  
+  //
+  // Handles are configured once and keep their options from one request to
+  // the next; only a change to the ops' settings forces a reset:
+  //
+  if ( ! the_request ) {
+    if ( ! (ops->request_objs[request] = the_request = curl_easy_init()) ) return NULL;
+  } else if ( (ops->needs_configure & (1 << request)) ) {
+    curl_easy_reset(the_request);
+    if ( request == http_ops_curl_request_get ) ops->is_range_header_set = false;
+  } else {
+    return the_request;
+  }
+  __http_ops_configure_curl_request(ops, request, the_request, &ops->curl_error_buffer[0]);
+  ops->needs_configure &= ~(1 << request);
+  return the_request;
+}
+
+//
+// The Range header for a GET lives in the ops itself (a single-node slist
+// over a fixed buffer) so that it can change with every request without any
+// allocations.  Pass s < 0 to drop the header again.
+//
+void
+__http_ops_set_range_header(
+  http_ops    *ops,
+  CURL        *curl_request,
+  long int    s,
+  long int    e
+)
+{
+  if ( s >= 0 ) {
+    snprintf(ops->range_header_buffer, sizeof(ops->range_header_buffer), "Range: bytes=%ld-%ld", s, e);
+    if ( ! ops->is_range_header_set ) {
+      ops->range_header.data = &ops->range_header_buffer[0];
+      ops->range_header.next = NULL;
+      curl_easy_setopt(curl_request, CURLOPT_HTTPHEADER, &ops->range_header);
+      ops->is_range_header_set = true;
+    }
+  } else if ( ops->is_range_header_set ) {
+    curl_easy_setopt(curl_request, CURLOPT_HTTPHEADER, NULL);
+    ops->is_range_header_set = false;
+  }
+}
+
+//
+// All of the handles belonging to an http_ops share one connection cache,
+// DNS cache and TLS session cache, so e.g. a PUT following a MKCOL to the
+// same server reuses the MKCOL's connection just as a real client would.
+// An http_ops is only ever used by one thread at a time, so the share needs
+// no lock callbacks.
+//
+CURLSH*
+__http_ops_share_create(void)
+{
+  CURLSH      *share = curl_share_init();
+  
+  if ( share ) {
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x071700
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+  }
+  return share;
 }
 
 //
@@ -301,6 +442,41 @@ http_ops_create()
   if ( new_ops ) {
     memset(new_ops, 0, sizeof(http_ops));
     new_ops->should_follow_redirects    = true;
+    
+    // Without a share each handle just keeps its own caches:
+    new_ops->share = __http_ops_share_create();
+  }
+  return new_ops;
+}
+
+//
+
+http_ops_ref
+http_ops_create_copy(
+  http_ops_ref  ops
+)
+{
+  http_ops    *new_ops = http_ops_create();
+  
+  if ( new_ops ) {
+    struct curl_slist   *mapping = ops->resolve_list;
+    
+    new_ops->is_verbose                 = ops->is_verbose;
+    new_ops->should_verify_peer         = ops->should_verify_peer;
+    new_ops->should_follow_redirects    = ops->should_follow_redirects;
+    new_ops->upload_buffer_size         = ops->upload_buffer_size;
+    new_ops->progress                   = ops->progress;
+    if ( ! http_ops_set_username(new_ops, ops->username) || ! http_ops_set_password(new_ops, ops->password) || ! http_ops_set_unix_socket_path(new_ops, ops->unix_socket_path) ) {
+      http_ops_destroy(new_ops);
+      return NULL;
+    }
+    while ( mapping ) {
+      if ( ! http_ops_add_host_mapping_string(new_ops, mapping->data) ) {
+        http_ops_destroy(new_ops);
+        return NULL;
+      }
+      mapping = mapping->next;
+    }
   }
   return new_ops;
 }
@@ -318,9 +494,11 @@ http_ops_destroy(
     if ( ops->request_objs[i_r] ) curl_easy_cleanup(ops->request_objs[i_r]);
     if ( ops->request_headers[i_r] ) curl_slist_free_all(ops->request_headers[i_r]);
   }
+  if ( ops->share ) curl_share_cleanup(ops->share);
   if ( ops->resolve_list ) curl_slist_free_all(ops->resolve_list);
   if ( ops->username ) free((void*)ops->username);
   if ( ops->password ) free((void*)ops->password);
+  if ( ops->unix_socket_path ) free((void*)ops->unix_socket_path);
   free((void*)ops);
 }
 
@@ -353,6 +531,7 @@ http_ops_set_is_verbose(
 )
 {
   ops->is_verbose = is_verbose;
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
 }
 
 //
@@ -374,6 +553,7 @@ http_ops_set_should_follow_redirects(
 )
 {
   ops->should_follow_redirects = should_follow_redirects;
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
 }
 
 //
@@ -395,6 +575,29 @@ http_ops_set_ssl_verify_peer(
 )
 {
   ops->should_verify_peer = should_verify_peer;
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
+}
+
+//
+
+long
+http_ops_get_upload_buffer_size(
+  http_ops_ref  ops
+)
+{
+  return ops->upload_buffer_size;
+}
+
+//
+
+void
+http_ops_set_upload_buffer_size(
+  http_ops_ref  ops,
+  long          upload_buffer_size
+)
+{
+  ops->upload_buffer_size = upload_buffer_size;
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
 }
 
 //
@@ -419,6 +622,7 @@ http_ops_set_username(
     free((void*)ops->username);
     ops->username = NULL;
   }
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
   if ( username && ! (ops->username = strdup(username)) ) return false;
   return true;
 }
@@ -445,12 +649,125 @@ http_ops_set_password(
     free((void*)ops->password);
     ops->password = NULL;
   }
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
   if ( password && ! (ops->password = strdup(password)) ) return false;
   return true;
 }
 
 //
 
+const char*
+http_ops_get_unix_socket_path(
+  http_ops_ref  ops
+)
+{
+  return ops->unix_socket_path;
+}
+
+//
+
+bool
+http_ops_set_unix_socket_path(
+  http_ops_ref  ops,
+  const char    *unix_socket_path
+)
+{
+  if ( ops->unix_socket_path ) {
+    free((void*)ops->unix_socket_path);
+    ops->unix_socket_path = NULL;
+  }
+  ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
+  if ( unix_socket_path && ! (ops->unix_socket_path = strdup(unix_socket_path)) ) return false;
+  return true;
+}
+
+//
+
+http_stats_series_ref
+http_ops_get_stats_series(
+  http_ops_ref  ops
+)
+{
+  return ops->stats_series;
+}
+
+//
+
+void
+http_ops_set_stats_series(
+  http_ops_ref          ops,
+  http_stats_series_ref stats_series
+)
+{
+  ops->stats_series = stats_series;
+}
+
+//
+
+http_progress_ref
+http_ops_get_progress(
+  http_ops_ref  ops
+)
+{
+  return ops->progress;
+}
+
+//
+
+void
+http_ops_set_progress(
+  http_ops_ref      ops,
+  http_progress_ref progress
+)
+{
+  ops->progress = progress;
+}
+
+//
+// Every request goes through here so that the progress counters see it start;
+// a successful one is noted as finished once its statistics are gathered:
+//
+
+static inline CURLcode
+__http_ops_perform(
+  http_ops_ref  ops,
+  CURL          *curl_request
+)
+{
+  CURLcode      ccode;
+  
+  if ( ops->progress ) http_progress_note_start(ops->progress);
+  ccode = curl_easy_perform(curl_request);
+  if ( (ccode != CURLE_OK) && ops->progress ) http_progress_note_failure(ops->progress);
+  return ccode;
+}
+
+//
+
+static inline bool
+__http_ops_update_stats(
+  http_ops_ref        ops,
+  http_stats_ref      stats,
+  CURL                *curl_request,
+  http_stats_record   *req_stats
+)
+{
+  long                http_status;
+  http_stats_record   timing;
+  
+  if ( ! http_stats_record_from_curl(curl_request, &http_status, &timing) ) {
+    if ( ops->progress ) http_progress_note_failure(ops->progress);
+    return false;
+  }
+  if ( ops->progress ) http_progress_note_finish(ops->progress, http_status, timing[http_stats_field_total], timing[http_stats_field_content_bytes]);
+  http_stats_update_with_record(stats, http_status, &timing);
+  if ( ops->stats_series ) http_stats_series_update_with_record(ops->stats_series, monotonic_seconds(), http_status, &timing);
+  if ( req_stats ) memcpy(req_stats, &timing, sizeof(timing));
+  return true;
+}
+
+//
+
 CURL*
 http_ops_curl_handle_for_request(
   http_ops_ref          ops,
@@ -463,6 +780,24 @@ http_ops_curl_handle_for_request(
 
 //
 
+CURL*
+http_ops_curl_handle_create(
+  http_ops_ref          ops,
+  http_ops_curl_request req_type,
+  char                  *error_buffer
+)
+{
+  CURL        *new_request = NULL;
+  
+  if ( req_type >= http_ops_curl_request_get && req_type < http_ops_curl_request_max ) {
+    new_request = curl_easy_init();
+    __http_ops_configure_curl_request(ops, req_type, new_request, error_buffer ? error_buffer : &ops->curl_error_buffer[0]);
+  }
+  return new_request;
+}
+
+//
+
 bool
 http_ops_add_host_mapping(
   http_ops_ref  ops,
@@ -475,9 +810,8 @@ http_ops_add_host_mapping(
   
   if ( asprintf(&mapping, "%s:%hd:%s", hostname, port, ipaddress) >= 0 ) {
     if ( mapping ) {
-      http_ops_curl_request   i_r;
-      
       ops->resolve_list = curl_slist_append(ops->resolve_list, mapping);
+      ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
       free(mapping);
       return true;
     }
@@ -494,9 +828,8 @@ http_ops_add_host_mapping_string(
 )
 {
   if ( host_map_string ) {
-    http_ops_curl_request   i_r;
-    
     ops->resolve_list = curl_slist_append(ops->resolve_list, host_map_string);
+    ops->needs_configure = HTTP_OPS_NEEDS_CONFIGURE_ALL;
     return true;
   }
   return false;
@@ -520,10 +853,10 @@ http_ops_mkdir(
     CURLcode      ccode;
     
     curl_easy_setopt(curl_request, CURLOPT_URL, url);
-    ccode = curl_easy_perform(curl_request);
+    ccode = __http_ops_perform(ops, curl_request);
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       rc = true;
     }
   }
@@ -541,23 +874,66 @@ http_ops_upload(
   http_stats_record   *req_stats, 
   long                *http_status
 )
+{
+  return http_ops_upload_with_length(ops, path, -1, url, stats, req_stats, http_status);
+}
+
+//
+
+bool
+http_ops_upload_with_length(
+  http_ops_ref        ops,
+  const char          *path,
+  long long           content_length,
+  const char          *url,
+  http_stats_ref      stats,
+  http_stats_record   *req_stats, 
+  long                *http_status
+)
 {
   CURL            *curl_request = __http_ops_get_curl_request(ops, http_ops_curl_request_put);
   bool            rc = false;
   
   if ( curl_request ) {
-    CURLcode      ccode;
-    FILE          *in_file = fopen(path, "r");
+    CURLcode                ccode;
+    http_ops_upload_source  body = { .fd = open(path, O_RDONLY), .map = NULL, .payload = NULL, .length = content_length, .offset = 0 };
     
-    if ( in_file ) {
+    if ( body.fd >= 0 ) {
+      struct stat           finfo;
+      
+      if ( fstat(body.fd, &finfo) != 0 ) {
+        close(body.fd);
+        return false;
+      }
+      if ( body.length < 0 ) body.length = finfo.st_size;
+      
+      //
+      // Only map the file if it's (still) at least as long as the body; touching
+      // a mapping beyond EOF would fault, whereas a short pread() just aborts
+      // the transfer:
+      //
+      if ( (body.length > 0) && (finfo.st_size >= body.length) ) {
+        void                *map = mmap(NULL, body.length, PROT_READ, MAP_PRIVATE, body.fd, 0);
+        
+        if ( map != MAP_FAILED ) {
+#ifdef MADV_SEQUENTIAL
+          madvise(map, body.length, MADV_SEQUENTIAL);
+#endif
+          body.map = (const char*)map;
+        }
+      }
       curl_easy_setopt(curl_request, CURLOPT_URL, url);
-      curl_easy_setopt(curl_request, CURLOPT_READFUNCTION, NULL);
-      curl_easy_setopt(curl_request, CURLOPT_READDATA, in_file);
-      ccode = curl_easy_perform(curl_request);
-      fclose(in_file);
+      curl_easy_setopt(curl_request, CURLOPT_INFILESIZE_LARGE, body.length);
+      curl_easy_setopt(curl_request, CURLOPT_READDATA, &body);
+      curl_easy_setopt(curl_request, CURLOPT_SEEKDATA, &body);
+      ccode = __http_ops_perform(ops, curl_request);
+      curl_easy_setopt(curl_request, CURLOPT_READDATA, NULL);
+      curl_easy_setopt(curl_request, CURLOPT_SEEKDATA, NULL);
+      if ( body.map ) munmap((void*)body.map, body.length);
+      close(body.fd);
       if ( ccode == CURLE_OK ) {
         curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-        http_stats_update_and_copy(stats, curl_request, req_stats);
+        __http_ops_update_stats(ops, stats, curl_request, req_stats);
         rc = true;
       }
     }
@@ -567,6 +943,47 @@ http_ops_upload(
 
 //
 
+bool
+http_ops_upload_payload(
+  http_ops_ref          ops,
+  payload_generator_ref payload,
+  long long             content_length,
+  const char            *url,
+  http_stats_ref        stats,
+  http_stats_record     *req_stats, 
+  long                  *http_status
+)
+{
+  CURL            *curl_request = __http_ops_get_curl_request(ops, http_ops_curl_request_put);
+  bool            rc = false;
+  
+  if ( curl_request ) {
+    CURLcode                ccode;
+    http_ops_upload_source  body = { .fd = -1, .map = NULL, .payload = payload, .length = content_length, .offset = 0 };
+    
+    //
+    // The body is keyed by the URL, so a later download of the same URL can be
+    // checked against the same generator:
+    //
+    body.payload_offset = payload_generator_offset_for_key(payload, url);
+    curl_easy_setopt(curl_request, CURLOPT_URL, url);
+    curl_easy_setopt(curl_request, CURLOPT_INFILESIZE_LARGE, body.length);
+    curl_easy_setopt(curl_request, CURLOPT_READDATA, &body);
+    curl_easy_setopt(curl_request, CURLOPT_SEEKDATA, &body);
+    ccode = __http_ops_perform(ops, curl_request);
+    curl_easy_setopt(curl_request, CURLOPT_READDATA, NULL);
+    curl_easy_setopt(curl_request, CURLOPT_SEEKDATA, NULL);
+    if ( ccode == CURLE_OK ) {
+      curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
+      rc = true;
+    }
+  }
+  return rc;
+}
+
+//
+
 bool
 http_ops_download(
   http_ops_ref        ops,
@@ -583,6 +1000,7 @@ http_ops_download(
   if ( curl_request ) {
     CURLcode      ccode = -1;
     
+    __http_ops_set_range_header(ops, curl_request, -1, -1);
     if ( path && *path ) {
       FILE          *out_file = fopen(path, "w");
       
@@ -590,18 +1008,18 @@ http_ops_download(
         curl_easy_setopt(curl_request, CURLOPT_URL, url);
         curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, NULL);
         curl_easy_setopt(curl_request, CURLOPT_WRITEDATA, out_file);
-        ccode = curl_easy_perform(curl_request);
+        ccode = __http_ops_perform(ops, curl_request);
         fclose(out_file);
       }
     } else {
       curl_easy_setopt(curl_request, CURLOPT_URL, url);
-      curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+      curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
       curl_easy_setopt(curl_request, CURLOPT_WRITEDATA, NULL);
-      ccode = curl_easy_perform(curl_request);
+      ccode = __http_ops_perform(ops, curl_request);
     }
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       rc = true;
     }
   }
@@ -631,7 +1049,6 @@ http_ops_download_range(
       FILE        *out_file = fopen(path, "a+");
       
       if ( out_file ) {
-        char                  header[24 + 32 + 32];
         http_ops_data_range   write_data;
         
         write_data.fptr = out_file;
@@ -640,35 +1057,27 @@ http_ops_download_range(
         if ( fseek(out_file, write_data.s, SEEK_SET) == 0 ) {
           write_data.e = random_long_int_in_range(write_data.s, expected_length);
           
-          snprintf(header, sizeof(header), "Range: bytes=%ld-%ld", write_data.s, write_data.e);
-          __http_ops_add_header(ops, http_ops_curl_request_get, header);
-          curl_easy_setopt(curl_request, CURLOPT_HTTPHEADER, ops->request_headers[http_ops_curl_request_get]);
-        
-          
+          __http_ops_set_range_header(ops, curl_request, write_data.s, write_data.e);
           curl_easy_setopt(curl_request, CURLOPT_URL, url);
           curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, __http_ops_range_write);
           curl_easy_setopt(curl_request, CURLOPT_WRITEDATA, &write_data);
-          ccode = curl_easy_perform(curl_request);
+          ccode = __http_ops_perform(ops, curl_request);
           fclose(out_file);
         }
       }
     } else {
-      char        header[24 + 32 + 32];
       long int    s = random_long_int_in_range(0, expected_length);
       long int    e = random_long_int_in_range(s, expected_length);
       
-      snprintf(header, sizeof(header), "Range: bytes=%ld-%ld", s, e);
-      __http_ops_add_header(ops, http_ops_curl_request_get, header);
-      curl_easy_setopt(curl_request, CURLOPT_HTTPHEADER, ops->request_headers[http_ops_curl_request_get]);
-      
+      __http_ops_set_range_header(ops, curl_request, s, e);
       curl_easy_setopt(curl_request, CURLOPT_URL, url);
-      curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, __http_ops_null_write);
+      curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, http_ops_null_write);
       curl_easy_setopt(curl_request, CURLOPT_WRITEDATA, NULL);
-      ccode = curl_easy_perform(curl_request);
+      ccode = __http_ops_perform(ops, curl_request);
     }
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       rc = true;
     }
   }
@@ -693,10 +1102,10 @@ http_ops_delete(
     CURLcode      ccode;
     
     curl_easy_setopt(curl_request, CURLOPT_URL, url);
-    ccode = curl_easy_perform(curl_request);
+    ccode = __http_ops_perform(ops, curl_request);
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       rc = true;
     }
   }
@@ -720,12 +1129,12 @@ http_ops_getinfo(
   if ( curl_request ) {
     CURLcode      ccode;
     
-    __http_ops_propfind_read_data_reset();
+    ops->propfind_read_offset = 0;
     curl_easy_setopt(curl_request, CURLOPT_URL, url);
-    ccode = curl_easy_perform(curl_request);
+    ccode = __http_ops_perform(ops, curl_request);
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       rc = true;
     }
   }
@@ -766,7 +1175,7 @@ __http_ops_options_header_callback(
   size_t  header_len = size * nitems;
   long    *method_mask = (long*)userdata;
   
-  if ( header_len > 6 ) {
+  if ( method_mask && (header_len > 6) ) {
     if ( strncasecmp(buffer, "Allow:", 6) == 0 ) {
       char    *methods = buffer + 6;
       size_t  methods_len = header_len - 6;
@@ -807,13 +1216,12 @@ http_ops_options(
     CURLcode      ccode;
     long          method_mask = 0L;
     
-    curl_easy_setopt(curl_request, CURLOPT_HEADERFUNCTION, __http_ops_options_header_callback);
     curl_easy_setopt(curl_request, CURLOPT_HEADERDATA, &method_mask);
     curl_easy_setopt(curl_request, CURLOPT_URL, url);
-    ccode = curl_easy_perform(curl_request);
+    ccode = __http_ops_perform(ops, curl_request);
     if ( ccode == CURLE_OK ) {
       curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
-      http_stats_update_and_copy(stats, curl_request, req_stats);
+      __http_ops_update_stats(ops, stats, curl_request, req_stats);
       
       *has_propfind = ((method_mask & http_ops_options_has_propfind) == http_ops_options_has_propfind) ? true : false;
       *has_delete = ((method_mask & http_ops_options_has_delete) == http_ops_options_has_delete) ? true : false;
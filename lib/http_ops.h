@@ -6,6 +6,8 @@
 #define __HTTP_OPS_H__
 
 #include "http_stats.h"
+#include "http_progress.h"
+#include "payload.h"
 
 #include <curl/curl.h>
 
@@ -25,6 +27,7 @@ const char* http_ops_method_get_string(http_ops_method the_method);
 typedef struct _http_ops * http_ops_ref;
 
 http_ops_ref http_ops_create(void);
+http_ops_ref http_ops_create_copy(http_ops_ref ops);
 void http_ops_destroy(http_ops_ref ops);
 
 const char* http_ops_get_error_buffer(http_ops_ref ops);
@@ -38,12 +41,42 @@ void http_ops_set_should_follow_redirects(http_ops_ref ops, bool should_follow_r
 bool http_ops_get_ssl_verify_peer(http_ops_ref ops);
 void http_ops_set_ssl_verify_peer(http_ops_ref ops, bool should_verify_peer);
 
+//
+// Size of cURL's upload buffer (CURLOPT_UPLOAD_BUFFERSIZE, libcurl 7.62 or
+// newer); zero leaves cURL's default in place:
+//
+long http_ops_get_upload_buffer_size(http_ops_ref ops);
+void http_ops_set_upload_buffer_size(http_ops_ref ops, long upload_buffer_size);
+
 const char* http_ops_get_username(http_ops_ref ops);
 bool http_ops_set_username(http_ops_ref ops, const char *username);
 
 const char* http_ops_get_password(http_ops_ref ops);
 bool http_ops_set_password(http_ops_ref ops, const char *password);
 
+//
+// Connect to this Unix domain socket rather than the host and port in each
+// URL (CURLOPT_UNIX_SOCKET_PATH, libcurl 7.40 or newer); NULL goes back to TCP:
+//
+const char* http_ops_get_unix_socket_path(http_ops_ref ops);
+bool http_ops_set_unix_socket_path(http_ops_ref ops, const char *unix_socket_path);
+
+//
+// Every request's timings are also added to this time series (not owned by
+// the ops, and not carried over by http_ops_create_copy() since a series is
+// not thread-safe); NULL turns it off:
+//
+http_stats_series_ref http_ops_get_stats_series(http_ops_ref ops);
+void http_ops_set_stats_series(http_ops_ref ops, http_stats_series_ref stats_series);
+
+//
+// Live progress counters every request is reported to (not owned by the ops);
+// unlike the time series they are shared with copies made by
+// http_ops_create_copy() and by http_multi objects using the ops:
+//
+http_progress_ref http_ops_get_progress(http_ops_ref ops);
+void http_ops_set_progress(http_ops_ref ops, http_progress_ref progress);
+
 bool http_ops_add_host_mapping(http_ops_ref ops, const char *hostname, short port, const char *ipaddress);
 bool http_ops_add_host_mapping_string(http_ops_ref ops, const char *host_map_string);
 
@@ -59,9 +92,21 @@ typedef enum {
 } http_ops_curl_request;
 
 CURL* http_ops_curl_handle_for_request(http_ops_ref ops, http_ops_curl_request req_type);
+//
+// Handles created here use the ops' shared connection/DNS/TLS caches, so they
+// must be cleaned-up before the ops is destroyed:
+//
+CURL* http_ops_curl_handle_create(http_ops_ref ops, http_ops_curl_request req_type, char *error_buffer);
+
+//
+// A CURLOPT_WRITEFUNCTION that discards the response body:
+//
+size_t http_ops_null_write(char *ptr, size_t size, size_t nmemb, void *userdata);
 
 bool http_ops_mkdir(http_ops_ref ops, const char *url, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
 bool http_ops_upload(http_ops_ref ops, const char *path, const char *url, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
+bool http_ops_upload_with_length(http_ops_ref ops, const char *path, long long content_length, const char *url, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
+bool http_ops_upload_payload(http_ops_ref ops, payload_generator_ref payload, long long content_length, const char *url, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
 bool http_ops_download(http_ops_ref ops, const char *url, const char *path, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
 bool http_ops_download_range(http_ops_ref ops, const char *url, const char *path, http_stats_ref stats, http_stats_record *req_stats, long *http_status, long expected_length);
 bool http_ops_delete(http_ops_ref ops, const char *url, http_stats_ref stats, http_stats_record *req_stats, long *http_status);
@@ -0,0 +1,284 @@
+//
+// http_progress.c
+//
+
+#include "http_progress.h"
+#include "util_fns.h"
+
+#include <pthread.h>
+#include <time.h>
+
+//
+// Total request times are bucketed in microseconds, eight buckets per power
+// of two (so a bucket is never wider than 1/8th of its lower bound); that's
+// plenty for a progress line and keeps the histogram small enough to copy
+// every interval:
+//
+#define HTTP_PROGRESS_SUB_BUCKETS   8
+#define HTTP_PROGRESS_BUCKETS       (HTTP_PROGRESS_SUB_BUCKETS + 38 * HTTP_PROGRESS_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t          started, finished, failed, errors, bytes;
+  uint32_t          histogram[HTTP_PROGRESS_BUCKETS];
+} http_progress_counters;
+
+typedef struct _http_progress {
+  http_progress_counters  counters;
+  //
+  // Reporter thread:
+  //
+  double                  interval;
+  FILE                    *fptr;
+  bool                    is_reporting, should_stop;
+  pthread_t               reporter;
+  pthread_mutex_t         lock;
+  pthread_cond_t          wakeup;
+} http_progress;
+
+//
+
+static inline unsigned int
+__http_progress_bucket(
+  double            total_ms
+)
+{
+  uint64_t          usec = (total_ms > 0.0) ? (uint64_t)(1000.0 * total_ms + 0.5) : 0;
+  unsigned int      msb, i_b;
+
+  if ( usec < HTTP_PROGRESS_SUB_BUCKETS ) return (unsigned int)usec;
+  msb = 63 - __builtin_clzll(usec);
+  i_b = HTTP_PROGRESS_SUB_BUCKETS + (msb - 3) * HTTP_PROGRESS_SUB_BUCKETS + ((usec >> (msb - 3)) & (HTTP_PROGRESS_SUB_BUCKETS - 1));
+  return (i_b < HTTP_PROGRESS_BUCKETS) ? i_b : HTTP_PROGRESS_BUCKETS - 1;
+}
+
+static inline double
+__http_progress_bucket_ms(
+  unsigned int      i_b
+)
+{
+  unsigned int      shift;
+
+  if ( i_b < HTTP_PROGRESS_SUB_BUCKETS ) return 0.001 * i_b;
+
+  // Midpoint of the bucket:
+  shift = (i_b - HTTP_PROGRESS_SUB_BUCKETS) / HTTP_PROGRESS_SUB_BUCKETS;
+  return 0.001 * ldexp((double)(HTTP_PROGRESS_SUB_BUCKETS + (i_b % HTTP_PROGRESS_SUB_BUCKETS)) + 0.5, shift);
+}
+
+//
+
+http_progress_ref
+http_progress_create(void)
+{
+  http_progress     *new_progress = malloc(sizeof(http_progress));
+
+  if ( new_progress ) {
+    memset(new_progress, 0, sizeof(http_progress));
+    pthread_mutex_init(&new_progress->lock, NULL);
+  }
+  return new_progress;
+}
+
+//
+
+void
+http_progress_destroy(
+  http_progress_ref the_progress
+)
+{
+  http_progress_reporter_stop(the_progress);
+  pthread_mutex_destroy(&the_progress->lock);
+  free((void*)the_progress);
+}
+
+//
+
+void
+http_progress_note_start(
+  http_progress_ref the_progress
+)
+{
+  __atomic_add_fetch(&the_progress->counters.started, 1, __ATOMIC_RELAXED);
+}
+
+//
+
+void
+http_progress_note_finish(
+  http_progress_ref the_progress,
+  long              http_status,
+  double            total_ms,
+  double            content_bytes
+)
+{
+  __atomic_add_fetch(&the_progress->counters.histogram[__http_progress_bucket(total_ms)], 1, __ATOMIC_RELAXED);
+  if ( content_bytes > 0.0 ) __atomic_add_fetch(&the_progress->counters.bytes, (uint64_t)content_bytes, __ATOMIC_RELAXED);
+  if ( (http_status < 100) || (http_status >= 400) ) __atomic_add_fetch(&the_progress->counters.errors, 1, __ATOMIC_RELAXED);
+
+  // Last, so a request is never seen as done before its timing is:
+  __atomic_add_fetch(&the_progress->counters.finished, 1, __ATOMIC_RELEASE);
+}
+
+//
+
+void
+http_progress_note_failure(
+  http_progress_ref the_progress
+)
+{
+  __atomic_add_fetch(&the_progress->counters.errors, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&the_progress->counters.failed, 1, __ATOMIC_RELEASE);
+}
+
+//
+
+static void
+__http_progress_snapshot(
+  http_progress           *the_progress,
+  http_progress_counters  *snapshot
+)
+{
+  unsigned int            i_b;
+
+  //
+  // Completions are read before starts so that a request can never look like
+  // it finished without having started:
+  //
+  snapshot->finished = __atomic_load_n(&the_progress->counters.finished, __ATOMIC_ACQUIRE);
+  snapshot->failed = __atomic_load_n(&the_progress->counters.failed, __ATOMIC_ACQUIRE);
+  snapshot->started = __atomic_load_n(&the_progress->counters.started, __ATOMIC_RELAXED);
+  snapshot->errors = __atomic_load_n(&the_progress->counters.errors, __ATOMIC_RELAXED);
+  snapshot->bytes = __atomic_load_n(&the_progress->counters.bytes, __ATOMIC_RELAXED);
+  for ( i_b = 0; i_b < HTTP_PROGRESS_BUCKETS; i_b++ ) snapshot->histogram[i_b] = __atomic_load_n(&the_progress->counters.histogram[i_b], __ATOMIC_RELAXED);
+}
+
+//
+
+static double
+__http_progress_percentile(
+  const http_progress_counters  *now,
+  const http_progress_counters  *before,
+  uint64_t                      n,
+  double                        p
+)
+{
+  uint64_t                      target = (uint64_t)ceil(p * n), seen = 0;
+  unsigned int                  i_b;
+
+  if ( target == 0 ) target = 1;
+  for ( i_b = 0; i_b < HTTP_PROGRESS_BUCKETS; i_b++ ) {
+    seen += now->histogram[i_b] - before->histogram[i_b];
+    if ( seen >= target ) return __http_progress_bucket_ms(i_b);
+  }
+  return __http_progress_bucket_ms(HTTP_PROGRESS_BUCKETS - 1);
+}
+
+//
+
+static void*
+__http_progress_reporter(
+  void                    *context
+)
+{
+  http_progress           *the_progress = (http_progress*)context;
+  http_progress_counters  *before = malloc(2 * sizeof(http_progress_counters));
+  http_progress_counters  *now = before + 1;
+  double                  t0 = monotonic_seconds(), t_before = t0;
+  unsigned long           tick = 0;
+
+  if ( ! before ) return NULL;
+  __http_progress_snapshot(the_progress, before);
+
+  pthread_mutex_lock(&the_progress->lock);
+  while ( ! the_progress->should_stop ) {
+    double                deadline = t0 + ++tick * the_progress->interval;
+    struct timespec       until = { .tv_sec = (time_t)deadline, .tv_nsec = (long)(1e9 * (deadline - floor(deadline))) };
+
+    //
+    // The condition variable runs on the monotonic clock, so the schedule
+    // doesn't drift with each line printed:
+    //
+    while ( ! the_progress->should_stop && (monotonic_seconds() < deadline) ) {
+      pthread_cond_timedwait(&the_progress->wakeup, &the_progress->lock, &until);
+    }
+    if ( ! the_progress->should_stop ) {
+      double              t_now = monotonic_seconds(), dt = t_now - t_before;
+      uint64_t            n_done, n_in_flight, n_errors;
+      http_progress_counters  *swap;
+
+      __http_progress_snapshot(the_progress, now);
+      n_done = (now->finished - before->finished) + (now->failed - before->failed);
+      n_in_flight = now->started - (now->finished + now->failed);
+      n_errors = now->errors - before->errors;
+
+      fprintf(the_progress->fptr, "[%10.3lf s] %10.1lf req/s %12.4lg bytes/s %8llu in flight %8llu errors (%llu total)",
+          t_now - t0, n_done / dt, (now->bytes - before->bytes) / dt,
+          (unsigned long long)n_in_flight, (unsigned long long)n_errors, (unsigned long long)now->errors
+        );
+      if ( now->finished > before->finished ) {
+        uint64_t          n_finished = now->finished - before->finished;
+
+        fprintf(the_progress->fptr, "   p50 %8.3lg ms   p99 %8.3lg ms\n",
+            __http_progress_percentile(now, before, n_finished, 0.50),
+            __http_progress_percentile(now, before, n_finished, 0.99)
+          );
+      } else {
+        fprintf(the_progress->fptr, "   p50 %8s ms   p99 %8s ms\n", "-", "-");
+      }
+      fflush(the_progress->fptr);
+
+      swap = before, before = now, now = swap;
+      t_before = t_now;
+    }
+  }
+  pthread_mutex_unlock(&the_progress->lock);
+  free((void*)((before < now) ? before : now));
+  return NULL;
+}
+
+//
+
+bool
+http_progress_reporter_start(
+  http_progress_ref the_progress,
+  double            interval,
+  FILE              *fptr
+)
+{
+  pthread_condattr_t  attrs;
+
+  if ( the_progress->is_reporting || (interval <= 0.0) ) return false;
+
+  pthread_condattr_init(&attrs);
+  pthread_condattr_setclock(&attrs, CLOCK_MONOTONIC);
+  pthread_cond_init(&the_progress->wakeup, &attrs);
+  pthread_condattr_destroy(&attrs);
+
+  the_progress->interval = interval;
+  the_progress->fptr = fptr ? fptr : stderr;
+  the_progress->should_stop = false;
+  if ( pthread_create(&the_progress->reporter, NULL, __http_progress_reporter, the_progress) != 0 ) {
+    pthread_cond_destroy(&the_progress->wakeup);
+    return false;
+  }
+  the_progress->is_reporting = true;
+  return true;
+}
+
+//
+
+void
+http_progress_reporter_stop(
+  http_progress_ref the_progress
+)
+{
+  if ( the_progress->is_reporting ) {
+    pthread_mutex_lock(&the_progress->lock);
+    the_progress->should_stop = true;
+    pthread_cond_signal(&the_progress->wakeup);
+    pthread_mutex_unlock(&the_progress->lock);
+    pthread_join(the_progress->reporter, NULL);
+    pthread_cond_destroy(&the_progress->wakeup);
+    the_progress->is_reporting = false;
+  }
+}
@@ -0,0 +1,37 @@
+//
+// http_progress.h
+//
+
+#ifndef __HTTP_PROGRESS_H__
+#define __HTTP_PROGRESS_H__
+
+#include "config.h"
+
+//
+// Live progress of a run:  a handful of counters and a coarse histogram of
+// total request time that any number of threads update without locking, plus
+// an optional reporter thread that periodically prints what happened over the
+// last interval.  One object is meant to be shared by every worker.
+//
+typedef struct _http_progress * http_progress_ref;
+
+http_progress_ref http_progress_create(void);
+void http_progress_destroy(http_progress_ref the_progress);
+
+//
+// The request path:  every attempt is started once and then either finishes
+// (a response of any status was received; 4XX/5XX count as errors) or fails
+// (cURL gave up, also an error).  total_ms is the request's total time:
+//
+void http_progress_note_start(http_progress_ref the_progress);
+void http_progress_note_finish(http_progress_ref the_progress, long http_status, double total_ms, double content_bytes);
+void http_progress_note_failure(http_progress_ref the_progress);
+
+//
+// Print a line to fptr every interval seconds until stopped:  throughput,
+// requests in flight, errors and the p50/p99 total time over the interval:
+//
+bool http_progress_reporter_start(http_progress_ref the_progress, double interval, FILE *fptr);
+void http_progress_reporter_stop(http_progress_ref the_progress);
+
+#endif /* __HTTP_PROGRESS_H__ */
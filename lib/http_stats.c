@@ -3,6 +3,9 @@
 //
 
 #include "http_stats.h"
+#include "util_fns.h"
+
+#include <sys/time.h>
 
 //
 
@@ -16,15 +19,168 @@ http_stats_bystatus_from_http_status(
 }
 
 //
+// Log-bucketed histograms:  values are recorded as integers (microseconds
+// for the timing fields, bytes for the content field, a plain count for the
+// connections field).  Values below 32 get a bucket apiece; above that each
+// power of two is split into 16 linear sub-buckets, so a bucket is never
+// wider than 1/16th of its lower bound.  Anything at or beyond 2^48 lands in
+// the last bucket.
+//
+#define HTTP_STATS_HISTOGRAM_LINEAR     32
+#define HTTP_STATS_HISTOGRAM_SUB_BITS   4
+#define HTTP_STATS_HISTOGRAM_MAX_SHIFT  43
+#define HTTP_STATS_HISTOGRAM_BUCKETS    (HTTP_STATS_HISTOGRAM_LINEAR + HTTP_STATS_HISTOGRAM_MAX_SHIFT * (1 << HTTP_STATS_HISTOGRAM_SUB_BITS))
+
+typedef uint32_t http_stats_histogram[HTTP_STATS_HISTOGRAM_BUCKETS];
+
+static inline unsigned int
+__http_stats_histogram_index(
+  uint64_t    value
+)
+{
+  int         shift;
+  
+  if ( value < HTTP_STATS_HISTOGRAM_LINEAR ) return (unsigned int)value;
+  shift = (63 - __builtin_clzll(value)) - HTTP_STATS_HISTOGRAM_SUB_BITS;
+  if ( shift > HTTP_STATS_HISTOGRAM_MAX_SHIFT ) return HTTP_STATS_HISTOGRAM_BUCKETS - 1;
+  return HTTP_STATS_HISTOGRAM_LINEAR + (shift - 1) * (1 << HTTP_STATS_HISTOGRAM_SUB_BITS) + (unsigned int)((value >> shift) - (1 << HTTP_STATS_HISTOGRAM_SUB_BITS));
+}
+
+static inline double
+__http_stats_histogram_value(
+  unsigned int  index
+)
+{
+  unsigned int  shift, sub;
+  
+  if ( index < HTTP_STATS_HISTOGRAM_LINEAR ) return (double)index;
+  index -= HTTP_STATS_HISTOGRAM_LINEAR;
+  shift = 1 + index / (1 << HTTP_STATS_HISTOGRAM_SUB_BITS);
+  sub = (1 << HTTP_STATS_HISTOGRAM_SUB_BITS) + index % (1 << HTTP_STATS_HISTOGRAM_SUB_BITS);
+  // Midpoint of the bucket:
+  return ldexp((double)sub + 0.5, shift);
+}
+
+static inline uint64_t
+__http_stats_histogram_scale(
+  http_stats_field  field,
+  double            value
+)
+{
+  // Timing fields are in milliseconds, bucket them in microseconds:
+  if ( field <= http_stats_field_total ) value *= 1000.0;
+  return (value > 0.0) ? (uint64_t)(value + 0.5) : 0;
+}
+
+static inline double
+__http_stats_histogram_unscale(
+  http_stats_field  field,
+  double            value
+)
+{
+  if ( field <= http_stats_field_total ) value /= 1000.0;
+  return value;
+}
+
+//
+
+typedef struct {
+  unsigned int          count;
+  http_stats_record     min, max;
+  http_stats_record     m_i, s_i;
+} http_stats_class;
+
+static const http_stats_class __http_stats_empty_class = { .count = 0 };
 
+//
+// Most objects (e.g. per-entity statistics in urltest_webdav) only ever see
+// one class of response, in which case the "all" class and that one class are
+// identical.  So statistics start out compact, with a single set of
+// accumulators shared by both; only when a second class shows up are they
+// promoted to a full array of classes:
+//
+//   compact_status == http_stats_bystatus_all    nothing recorded yet
+//   compact_status == 2XX..5XX                   compact holds "all" and that class
+//   classes != NULL                              promoted, compact is unused
+//
 typedef struct _http_stats {
-  unsigned int        count[http_stats_bystatus_max];
-  http_stats_record   min[http_stats_bystatus_max];
-  http_stats_record   max[http_stats_bystatus_max];
-  http_stats_record   m_i[http_stats_bystatus_max];
-  http_stats_record   s_i[http_stats_bystatus_max];
+  http_stats_bystatus       compact_status;
+  http_stats_class          *classes;
+  http_stats_histogram      (*histograms)[http_stats_field_max];
+  struct _http_stats_pool   *pool;
+  struct _http_stats        *next_free;
+  http_stats_class          compact;
 } http_stats;
 
+//
+// Objects allocated from a pool are carved out of large slabs rather than
+// malloc'd one by one; the pool releases everything when it is destroyed.
+//
+
+typedef struct _http_stats_slab {
+  struct _http_stats_slab   *next;
+  unsigned int              capacity, used;
+  http_stats                items[];
+} http_stats_slab;
+
+typedef struct _http_stats_pool {
+  unsigned int              slab_capacity;
+  http_stats_slab           *slabs;
+  http_stats                *free_list;
+} http_stats_pool;
+
+#define HTTP_STATS_POOL_DEFAULT_SLAB_CAPACITY   1024
+
+//
+
+static inline void
+__http_stats_class_reset(
+  http_stats_class  *the_class
+)
+{
+  http_stats_field  i_f;
+  
+  memset(the_class, 0, sizeof(http_stats_class));
+  
+  // Set all min's to an absurdly large value:
+  for ( i_f = 0; i_f < http_stats_field_max; i_f++ ) the_class->min[i_f] = DBL_MAX;
+}
+
+//
+
+static inline const http_stats_class*
+__http_stats_class(
+  http_stats          *the_stats,
+  http_stats_bystatus bystatus
+)
+{
+  if ( the_stats->classes ) return &the_stats->classes[bystatus];
+  if ( (bystatus == http_stats_bystatus_all) || (bystatus == the_stats->compact_status) ) return &the_stats->compact;
+  return &__http_stats_empty_class;
+}
+
+//
+
+static bool
+__http_stats_promote(
+  http_stats          *the_stats
+)
+{
+  if ( ! the_stats->classes ) {
+    http_stats_bystatus i_s;
+    
+    if ( ! (the_stats->classes = malloc(http_stats_bystatus_max * sizeof(http_stats_class))) ) return false;
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+      if ( (i_s == http_stats_bystatus_all) || (i_s == the_stats->compact_status) ) {
+        memcpy(&the_stats->classes[i_s], &the_stats->compact, sizeof(http_stats_class));
+      } else {
+        __http_stats_class_reset(&the_stats->classes[i_s]);
+      }
+    }
+  }
+  return true;
+}
+
 //
 
 http_stats_ref
@@ -32,7 +188,13 @@ http_stats_create()
 {
   http_stats  *new_stats = malloc(sizeof(http_stats));
   
-  if ( new_stats ) http_stats_reset(new_stats);
+  if ( new_stats ) {
+    new_stats->classes = NULL;
+    new_stats->histograms = NULL;
+    new_stats->pool = NULL;
+    new_stats->next_free = NULL;
+    http_stats_reset(new_stats);
+  }
   return new_stats;
 }
 
@@ -43,7 +205,182 @@ http_stats_destroy(
   http_stats_ref  the_stats
 )
 {
-  free((void*)the_stats);
+  if ( the_stats->classes ) free((void*)the_stats->classes);
+  if ( the_stats->histograms ) free((void*)the_stats->histograms);
+  if ( the_stats->pool ) {
+    // Pooled objects go back on the pool's free list:
+    the_stats->classes = NULL;
+    the_stats->histograms = NULL;
+    the_stats->next_free = the_stats->pool->free_list;
+    the_stats->pool->free_list = the_stats;
+  } else {
+    free((void*)the_stats);
+  }
+}
+
+//
+
+http_stats_pool_ref
+http_stats_pool_create(
+  unsigned int    slab_capacity
+)
+{
+  http_stats_pool *new_pool = malloc(sizeof(http_stats_pool));
+  
+  if ( new_pool ) {
+    new_pool->slab_capacity = slab_capacity ? slab_capacity : HTTP_STATS_POOL_DEFAULT_SLAB_CAPACITY;
+    new_pool->slabs = NULL;
+    new_pool->free_list = NULL;
+  }
+  return new_pool;
+}
+
+//
+
+void
+http_stats_pool_destroy(
+  http_stats_pool_ref the_pool
+)
+{
+  http_stats_slab     *slab = the_pool->slabs;
+  
+  while ( slab ) {
+    http_stats_slab   *next = slab->next;
+    unsigned int      i;
+    
+    for ( i = 0; i < slab->used; i++ ) {
+      if ( slab->items[i].classes ) free((void*)slab->items[i].classes);
+      if ( slab->items[i].histograms ) free((void*)slab->items[i].histograms);
+    }
+    free((void*)slab);
+    slab = next;
+  }
+  free((void*)the_pool);
+}
+
+//
+
+http_stats_ref
+http_stats_pool_alloc(
+  http_stats_pool_ref the_pool
+)
+{
+  http_stats          *new_stats = the_pool->free_list;
+  
+  if ( new_stats ) {
+    the_pool->free_list = new_stats->next_free;
+  } else {
+    http_stats_slab   *slab = the_pool->slabs;
+    
+    if ( ! slab || (slab->used == slab->capacity) ) {
+      if ( ! (slab = malloc(sizeof(http_stats_slab) + the_pool->slab_capacity * sizeof(http_stats))) ) return NULL;
+      slab->capacity = the_pool->slab_capacity;
+      slab->used = 0;
+      slab->next = the_pool->slabs;
+      the_pool->slabs = slab;
+    }
+    new_stats = &slab->items[slab->used++];
+  }
+  new_stats->classes = NULL;
+  new_stats->histograms = NULL;
+  new_stats->pool = the_pool;
+  new_stats->next_free = NULL;
+  http_stats_reset(new_stats);
+  return new_stats;
+}
+
+//
+
+bool
+http_stats_get_has_histograms(
+  http_stats_ref  the_stats
+)
+{
+  return the_stats->histograms ? true : false;
+}
+
+//
+
+bool
+http_stats_enable_histograms(
+  http_stats_ref  the_stats
+)
+{
+  if ( ! the_stats->histograms ) {
+    if ( ! (the_stats->histograms = calloc(http_stats_bystatus_max, sizeof(*the_stats->histograms))) ) return false;
+  }
+  return true;
+}
+
+//
+// Every record adds one sample to each field's histogram, so any one field's
+// buckets add up to the number of records the histograms have seen.  That
+// falls short of the class's count when statistics with and without
+// histograms were merged, and then the buckets can't be ranked against it:
+//
+
+static bool
+__http_stats_histograms_cover_class(
+  http_stats              *the_stats,
+  http_stats_bystatus     bystatus
+)
+{
+  const http_stats_class  *the_class = __http_stats_class(the_stats, bystatus);
+  uint64_t                n_samples = 0;
+  unsigned int            i_b;
+  
+  if ( ! the_stats->histograms || (the_class->count == 0) ) return false;
+  for ( i_b = 0; i_b < HTTP_STATS_HISTOGRAM_BUCKETS; i_b++ ) n_samples += the_stats->histograms[bystatus][http_stats_field_total][i_b];
+  return (n_samples == the_class->count) ? true : false;
+}
+
+//
+
+bool
+http_stats_get_has_percentiles(
+  http_stats_ref      the_stats,
+  http_stats_bystatus bystatus
+)
+{
+  if ( bystatus < http_stats_bystatus_all || bystatus >= http_stats_bystatus_max ) return false;
+  return __http_stats_histograms_cover_class(the_stats, bystatus);
+}
+
+//
+
+double
+http_stats_get_percentile(
+  http_stats_ref      the_stats,
+  http_stats_bystatus bystatus,
+  http_stats_field    field,
+  double              percentile
+)
+{
+  double              value = 0.0;
+  const http_stats_class  *the_class;
+  
+  if ( bystatus < http_stats_bystatus_all || bystatus >= http_stats_bystatus_max ) return value;
+  if ( field < http_stats_field_dns || field >= http_stats_field_max ) return value;
+  
+  the_class = __http_stats_class(the_stats, bystatus);
+  if ( __http_stats_histograms_cover_class(the_stats, bystatus) ) {
+    uint32_t          *buckets = the_stats->histograms[bystatus][field];
+    uint64_t          rank = (uint64_t)ceil(percentile / 100.0 * the_class->count);
+    uint64_t          seen = 0;
+    unsigned int      i;
+    
+    if ( rank < 1 ) rank = 1;
+    for ( i = 0; i < HTTP_STATS_HISTOGRAM_BUCKETS; i++ ) {
+      seen += buckets[i];
+      if ( seen >= rank ) break;
+    }
+    value = __http_stats_histogram_unscale(field, __http_stats_histogram_value(i));
+    
+    // The true value can't lie outside the observed range:
+    if ( value < the_class->min[field] ) value = the_class->min[field];
+    if ( value > the_class->max[field] ) value = the_class->max[field];
+  }
+  return value;
 }
 
 //
@@ -56,17 +393,25 @@ http_stats_get(
   http_stats_data     *out_data
 )
 {
+  const http_stats_class  *the_class;
+  
   // Validate indices:
   if ( bystatus < http_stats_bystatus_all || bystatus >= http_stats_bystatus_max ) return false;
   if ( field < http_stats_field_dns || field >= http_stats_field_max ) return false;
   
-  if ( the_stats->count[bystatus] > 0 ) {
-    out_data->count = the_stats->count[bystatus];
-    out_data->min = the_stats->min[bystatus][field];
-    out_data->max = the_stats->max[bystatus][field];
-    out_data->average = the_stats->m_i[bystatus][field];
-    out_data->variance = the_stats->s_i[bystatus][field] / (out_data->count - 1);
+  the_class = __http_stats_class(the_stats, bystatus);
+  if ( the_class->count > 0 ) {
+    out_data->count = the_class->count;
+    out_data->min = the_class->min[field];
+    out_data->max = the_class->max[field];
+    out_data->average = the_class->m_i[field];
+    out_data->variance = the_class->s_i[field] / (out_data->count - 1);
     out_data->stddev = sqrt(out_data->variance);
+    out_data->percentile[http_stats_percentile_50] = http_stats_get_percentile(the_stats, bystatus, field, 50.0);
+    out_data->percentile[http_stats_percentile_90] = http_stats_get_percentile(the_stats, bystatus, field, 90.0);
+    out_data->percentile[http_stats_percentile_99] = http_stats_get_percentile(the_stats, bystatus, field, 99.0);
+    out_data->percentile[http_stats_percentile_99_9] = http_stats_get_percentile(the_stats, bystatus, field, 99.9);
+    out_data->percentile[http_stats_percentile_99_99] = http_stats_get_percentile(the_stats, bystatus, field, 99.99);
   } else {
     // No stats, all zero:
     memset(out_data, 0, sizeof(http_stats_data));
@@ -82,14 +427,13 @@ http_stats_reset(
 )
 {
   http_stats_bystatus   i_s;
-  http_stats_field      i_f;
-  
-  memset(the_stats, 0, sizeof(http_stats));
   
-  // Set all min's to an absurdly large value:
-  for ( i_s = 0; i_s < http_stats_bystatus_max; i_s++ )
-    for ( i_f = 0; i_f < http_stats_field_max; i_f++ )
-      the_stats->min[i_s][i_f] = DBL_MAX;
+  the_stats->compact_status = http_stats_bystatus_all;
+  __http_stats_class_reset(&the_stats->compact);
+  if ( the_stats->classes ) {
+    for ( i_s = 0; i_s < http_stats_bystatus_max; i_s++ ) __http_stats_class_reset(&the_stats->classes[i_s]);
+  }
+  if ( the_stats->histograms ) memset(the_stats->histograms, 0, http_stats_bystatus_max * sizeof(*the_stats->histograms));
 }
 
 //
@@ -106,80 +450,208 @@ http_stats_update(
 //
 
 bool
-http_stats_update_and_copy(
-  http_stats_ref    the_stats,
+http_stats_record_from_curl(
   CURL              *curl_request,
-  http_stats_record *copy
+  long              *http_status,
+  http_stats_record *record
 )
 {
-  long                  http_status = -1;
-  http_stats_bystatus   i_s;
   http_stats_field      i_f;
-  http_stats_record     timing;
+  long                  num_connects = 0;
   
   // HTTP response code?
-  curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, &http_status);
-  i_s = http_stats_bystatus_from_http_status(http_status);
-  if ( i_s == http_stats_bystatus_max ) return false;
+  *http_status = -1;
+  curl_easy_getinfo(curl_request, CURLINFO_RESPONSE_CODE, http_status);
   
   // Retrieve timing values:
-  curl_easy_getinfo(curl_request, CURLINFO_NAMELOOKUP_TIME, &timing[http_stats_field_dns]);
-  curl_easy_getinfo(curl_request, CURLINFO_CONNECT_TIME, &timing[http_stats_field_connect]);
-  curl_easy_getinfo(curl_request, CURLINFO_APPCONNECT_TIME, &timing[http_stats_field_sslconnect]);
-  curl_easy_getinfo(curl_request, CURLINFO_PRETRANSFER_TIME, &timing[http_stats_field_pretransfer]);
-  curl_easy_getinfo(curl_request, CURLINFO_STARTTRANSFER_TIME, &timing[http_stats_field_response]);
-  curl_easy_getinfo(curl_request, CURLINFO_TOTAL_TIME, &timing[http_stats_field_total]);
-  curl_easy_getinfo(curl_request, CURLINFO_SIZE_DOWNLOAD, &timing[http_stats_field_content_bytes]);
+  curl_easy_getinfo(curl_request, CURLINFO_NAMELOOKUP_TIME, &(*record)[http_stats_field_dns]);
+  curl_easy_getinfo(curl_request, CURLINFO_CONNECT_TIME, &(*record)[http_stats_field_connect]);
+  curl_easy_getinfo(curl_request, CURLINFO_APPCONNECT_TIME, &(*record)[http_stats_field_sslconnect]);
+  curl_easy_getinfo(curl_request, CURLINFO_PRETRANSFER_TIME, &(*record)[http_stats_field_pretransfer]);
+  curl_easy_getinfo(curl_request, CURLINFO_STARTTRANSFER_TIME, &(*record)[http_stats_field_response]);
+  curl_easy_getinfo(curl_request, CURLINFO_TOTAL_TIME, &(*record)[http_stats_field_total]);
+  curl_easy_getinfo(curl_request, CURLINFO_SIZE_DOWNLOAD, &(*record)[http_stats_field_content_bytes]);
   
-  //
-  // Update the counts:
-  //
-	the_stats->count[http_stats_bystatus_all]++;
-	the_stats->count[i_s]++;
+  // How many new connections had to be opened (0 if one was reused):
+  curl_easy_getinfo(curl_request, CURLINFO_NUM_CONNECTS, &num_connects);
+  (*record)[http_stats_field_num_connects] = num_connects;
+  
+  // Convert all times from seconds to milliseconds:
+  for ( i_f = http_stats_field_dns; i_f <= http_stats_field_total; i_f++ ) (*record)[i_f] *= 1000;
+  
+  return (http_stats_bystatus_from_http_status(*http_status) == http_stats_bystatus_max) ? false : true;
+}
+
+//
+
+bool
+http_stats_update_and_copy(
+  http_stats_ref    the_stats,
+  CURL              *curl_request,
+  http_stats_record *copy
+)
+{
+  long                  http_status;
+  http_stats_record     timing;
+  
+  if ( ! http_stats_record_from_curl(curl_request, &http_status, &timing) ) return false;
+  http_stats_update_with_record(the_stats, http_status, &timing);
+  if ( copy ) memcpy(copy, &timing, sizeof(timing));
+  return true;
+}
+
+//
+
+static inline void
+__http_stats_class_update(
+  http_stats_class  *the_class,
+  const double      *timing
+)
+{
+  http_stats_field  i_f;
+  
+  the_class->count++;
   
   //
   // Update the min/max/avg fields:
   //
   for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
-    // Convert all times from microseconds to milliseconds:
-    if ( i_f <= http_stats_field_total ) timing[i_f] *= 1000;
-    
-    // All responses:
-    if ( timing[i_f] < the_stats->min[http_stats_bystatus_all][i_f] ) the_stats->min[http_stats_bystatus_all][i_f] = timing[i_f];
-    if ( timing[i_f] > the_stats->max[http_stats_bystatus_all][i_f] ) the_stats->max[http_stats_bystatus_all][i_f] = timing[i_f];
+    if ( timing[i_f] < the_class->min[i_f] ) the_class->min[i_f] = timing[i_f];
+    if ( timing[i_f] > the_class->max[i_f] ) the_class->max[i_f] = timing[i_f];
     //
     // Update the running variance accumulators:
     //   ( http://www.johndcook.com/blog/standard_deviation/ )
     //
-    if ( the_stats->count[http_stats_bystatus_all] == 1 ) {
-      the_stats->m_i[http_stats_bystatus_all][i_f] = timing[i_f];
+    if ( the_class->count == 1 ) {
+      the_class->m_i[i_f] = timing[i_f];
     } else {
-      double    m_prev = the_stats->m_i[http_stats_bystatus_all][i_f];
+      double    m_prev = the_class->m_i[i_f];
     
-      the_stats->m_i[http_stats_bystatus_all][i_f] += (timing[i_f] - m_prev) / (double)the_stats->count[http_stats_bystatus_all];
-      the_stats->s_i[http_stats_bystatus_all][i_f] += (timing[i_f] - m_prev) * (timing[i_f] - the_stats->m_i[http_stats_bystatus_all][i_f] );
+      the_class->m_i[i_f] += (timing[i_f] - m_prev) / (double)the_class->count;
+      the_class->s_i[i_f] += (timing[i_f] - m_prev) * (timing[i_f] - the_class->m_i[i_f] );
     }
-    
-    // Specific http status:
-    if ( timing[i_f] < the_stats->min[i_s][i_f] ) the_stats->min[i_s][i_f] = timing[i_f];
-    if ( timing[i_f] > the_stats->max[i_s][i_f] ) the_stats->max[i_s][i_f] = timing[i_f];
+  }
+}
+
+//
+
+bool
+http_stats_update_with_record(
+  http_stats_ref    the_stats,
+  long              http_status,
+  http_stats_record *record
+)
+{
+  http_stats_bystatus   i_s = http_stats_bystatus_from_http_status(http_status);
+  http_stats_field      i_f;
+  double                *timing = &(*record)[0];
+  
+  if ( i_s == http_stats_bystatus_max ) return false;
+  
+  //
+  // A compact object takes on the class of its first response; a response of
+  // any other class promotes it:
+  //
+  if ( ! the_stats->classes ) {
+    if ( the_stats->compact_status == http_stats_bystatus_all ) {
+      the_stats->compact_status = i_s;
+    } else if ( the_stats->compact_status != i_s ) {
+      if ( ! __http_stats_promote(the_stats) ) return false;
+    }
+  }
+  if ( the_stats->classes ) {
+    __http_stats_class_update(&the_stats->classes[http_stats_bystatus_all], timing);
+    __http_stats_class_update(&the_stats->classes[i_s], timing);
+  } else {
+    __http_stats_class_update(&the_stats->compact, timing);
+  }
+  
+  //
+  // Histograms:
+  //
+  if ( the_stats->histograms ) {
+    for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+      unsigned int  i_b = __http_stats_histogram_index(__http_stats_histogram_scale(i_f, timing[i_f]));
+      
+      the_stats->histograms[http_stats_bystatus_all][i_f][i_b]++;
+      the_stats->histograms[i_s][i_f][i_b]++;
+    }
+  }
+  return true;
+}
+
+//
+
+static inline void
+__http_stats_class_merge(
+  http_stats_class        *dst,
+  const http_stats_class  *src
+)
+{
+  double                  n_a = dst->count, n_b = src->count;
+  double                  n = n_a + n_b;
+  http_stats_field        i_f;
+  
+  if ( src->count == 0 ) return;
+  if ( dst->count == 0 ) {
+    memcpy(dst, src, sizeof(http_stats_class));
+    return;
+  }
+  for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
     //
-    // Update the running variance accumulators:
-    //   ( http://www.johndcook.com/blog/standard_deviation/ )
+    // Combine the running variance accumulators of two disjoint sets:
+    //   ( Chan, Golub & LeVeque, "Updating Formulae and a Pairwise Algorithm
+    //     for Computing Sample Variances", 1979 )
     //
-    if ( the_stats->count[i_s] == 1 ) {
-      the_stats->m_i[i_s][i_f] = timing[i_f];
-    } else {
-      double    m_prev = the_stats->m_i[i_s][i_f];
+    double    delta = src->m_i[i_f] - dst->m_i[i_f];
     
-      the_stats->m_i[i_s][i_f] += (timing[i_f] - m_prev) / (double)the_stats->count[i_s];
-      the_stats->s_i[i_s][i_f] += (timing[i_f] - m_prev) * (timing[i_f] - the_stats->m_i[i_s][i_f] );
-    }
+    dst->m_i[i_f] += delta * n_b / n;
+    dst->s_i[i_f] += src->s_i[i_f] + delta * delta * n_a * n_b / n;
+    
+    if ( src->min[i_f] < dst->min[i_f] ) dst->min[i_f] = src->min[i_f];
+    if ( src->max[i_f] > dst->max[i_f] ) dst->max[i_f] = src->max[i_f];
   }
+  dst->count += src->count;
+}
+
+//
+
+void
+http_stats_merge(
+  http_stats_ref    dst,
+  http_stats_ref    src
+)
+{
+  http_stats_bystatus   i_s;
+  http_stats_field      i_f;
   
-  if ( copy ) memcpy(copy, &timing, sizeof(timing));
+  //
+  // The destination stays compact only if both sides saw just the one class:
+  //
+  if ( ! dst->classes ) {
+    if ( src->classes || ((dst->compact_status != http_stats_bystatus_all) && (src->compact_status != http_stats_bystatus_all) && (dst->compact_status != src->compact_status)) ) {
+      if ( ! __http_stats_promote(dst) ) return;
+    }
+  }
+  if ( dst->classes ) {
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) __http_stats_class_merge(&dst->classes[i_s], __http_stats_class(src, i_s));
+  } else if ( src->compact_status != http_stats_bystatus_all ) {
+    dst->compact_status = src->compact_status;
+    __http_stats_class_merge(&dst->compact, &src->compact);
+  }
   
-  return true;
+  //
+  // Histogram buckets just add:
+  //
+  if ( src->histograms && http_stats_enable_histograms(dst) ) {
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+      for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+        unsigned int      i_b;
+        
+        for ( i_b = 0; i_b < HTTP_STATS_HISTOGRAM_BUCKETS; i_b++ ) dst->histograms[i_s][i_f][i_b] += src->histograms[i_s][i_f][i_b];
+      }
+    }
+  }
 }
 
 //
@@ -194,11 +666,234 @@ http_stats_is_empty(
 
 	// Check to be sure we have anything to show:
 	for ( i_s = http_stats_bystatus_2XX; i_s < http_stats_bystatus_max; i_s++ ) {
-		if ( the_stats->count[i_s] > 0 ) how_many++;
+		if ( __http_stats_class(the_stats, i_s)->count > 0 ) how_many++;
 	}
   return (how_many > 0) ? false : true;
 }
 
+//
+// Snapshots:  a fixed header, then every class's count and per-field
+// min/max/mean/sum of squared deviations, then (if present) the non-empty
+// histogram buckets of each class and field as index/count pairs.  Every
+// value is little-endian whatever the host, so snapshots written on any node
+// can be merged on any other:
+//
+//   magic[8] version flags length n_classes n_fields n_buckets    (uint32_t each)
+//   n_classes x { count (uint64_t), n_fields x { min max mean s (double) } }
+//   n_classes x n_fields x { n_used (uint32_t), n_used x { index count (uint32_t) } }
+//
+#define HTTP_STATS_SNAPSHOT_MAGIC             "URLSTATS"
+#define HTTP_STATS_SNAPSHOT_VERSION           1
+#define HTTP_STATS_SNAPSHOT_HEADER_LENGTH     (8 + 6 * sizeof(uint32_t))
+#define HTTP_STATS_SNAPSHOT_CLASS_LENGTH      (sizeof(uint64_t) + http_stats_field_max * 4 * sizeof(double))
+
+enum {
+  http_stats_snapshot_flags_histograms = 1 << 0
+};
+
+//
+
+void*
+http_stats_snapshot(
+  http_stats_ref        the_stats,
+  size_t                *length
+)
+{
+  size_t                n_bytes = HTTP_STATS_SNAPSHOT_HEADER_LENGTH + http_stats_bystatus_max * HTTP_STATS_SNAPSHOT_CLASS_LENGTH;
+  http_stats_bystatus   i_s;
+  http_stats_field      i_f;
+  unsigned int          i_b;
+  uint8_t               *snapshot, *p;
+  
+  if ( the_stats->histograms ) {
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+      for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+        n_bytes += sizeof(uint32_t);
+        for ( i_b = 0; i_b < HTTP_STATS_HISTOGRAM_BUCKETS; i_b++ ) if ( the_stats->histograms[i_s][i_f][i_b] ) n_bytes += 2 * sizeof(uint32_t);
+      }
+    }
+  }
+  if ( ! (snapshot = malloc(n_bytes)) ) return NULL;
+  
+  memcpy(snapshot, HTTP_STATS_SNAPSHOT_MAGIC, 8);
+  p = le_put_u32(snapshot + 8, HTTP_STATS_SNAPSHOT_VERSION);
+  p = le_put_u32(p, the_stats->histograms ? http_stats_snapshot_flags_histograms : 0);
+  p = le_put_u32(p, (uint32_t)n_bytes);
+  p = le_put_u32(p, http_stats_bystatus_max);
+  p = le_put_u32(p, http_stats_field_max);
+  p = le_put_u32(p, HTTP_STATS_HISTOGRAM_BUCKETS);
+  for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+    const http_stats_class  *the_class = __http_stats_class(the_stats, i_s);
+    
+    p = le_put_u64(p, the_class->count);
+    for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+      p = le_put_double(p, the_class->min[i_f]);
+      p = le_put_double(p, the_class->max[i_f]);
+      p = le_put_double(p, the_class->m_i[i_f]);
+      p = le_put_double(p, the_class->s_i[i_f]);
+    }
+  }
+  if ( the_stats->histograms ) {
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+      for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+        uint32_t        *buckets = the_stats->histograms[i_s][i_f];
+        uint8_t         *n_used_at = p;
+        uint32_t        n_used = 0;
+        
+        p += sizeof(uint32_t);
+        for ( i_b = 0; i_b < HTTP_STATS_HISTOGRAM_BUCKETS; i_b++ ) {
+          if ( buckets[i_b] ) {
+            p = le_put_u32(le_put_u32(p, i_b), buckets[i_b]);
+            n_used++;
+          }
+        }
+        le_put_u32(n_used_at, n_used);
+      }
+    }
+  }
+  *length = n_bytes;
+  return snapshot;
+}
+
+//
+
+size_t
+http_stats_merge_snapshot(
+  http_stats_ref        the_stats,
+  const void            *snapshot,
+  size_t                length
+)
+{
+  const uint8_t         *p = (const uint8_t*)snapshot, *end;
+  uint32_t              version, flags, n_bytes;
+  http_stats_class      classes[http_stats_bystatus_max];
+  http_stats_bystatus   i_s, only_class = http_stats_bystatus_all;
+  http_stats_field      i_f;
+  http_stats            *loaded;
+  unsigned int          n_classes_used = 0;
+  
+  if ( (length < HTTP_STATS_SNAPSHOT_HEADER_LENGTH) || memcmp(p, HTTP_STATS_SNAPSHOT_MAGIC, 8) ) return 0;
+  p += 8;
+  version = le_get_u32(&p);
+  flags = le_get_u32(&p);
+  n_bytes = le_get_u32(&p);
+  if ( (version != HTTP_STATS_SNAPSHOT_VERSION) || (n_bytes > length) ) return 0;
+  
+  //
+  // Merging is only exact if both sides bucket the same way:
+  //
+  if ( (le_get_u32(&p) != http_stats_bystatus_max) || (le_get_u32(&p) != http_stats_field_max) || (le_get_u32(&p) != HTTP_STATS_HISTOGRAM_BUCKETS) ) return 0;
+  if ( n_bytes < HTTP_STATS_SNAPSHOT_HEADER_LENGTH + http_stats_bystatus_max * HTTP_STATS_SNAPSHOT_CLASS_LENGTH ) return 0;
+  end = (const uint8_t*)snapshot + n_bytes;
+  
+  for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+    uint64_t            count = le_get_u64(&p);
+    
+    if ( count > UINT_MAX ) return 0;
+    classes[i_s].count = (unsigned int)count;
+    for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+      classes[i_s].min[i_f] = le_get_double(&p);
+      classes[i_s].max[i_f] = le_get_double(&p);
+      classes[i_s].m_i[i_f] = le_get_double(&p);
+      classes[i_s].s_i[i_f] = le_get_double(&p);
+    }
+    if ( (i_s != http_stats_bystatus_all) && classes[i_s].count ) {
+      only_class = i_s;
+      n_classes_used++;
+    }
+  }
+  
+  //
+  // Rebuild the object as it was, compact if only one class was seen, and
+  // merge it in the usual way:
+  //
+  if ( ! (loaded = http_stats_create()) ) return 0;
+  if ( n_classes_used <= 1 ) {
+    loaded->compact_status = only_class;
+    memcpy(&loaded->compact, &classes[http_stats_bystatus_all], sizeof(http_stats_class));
+  } else if ( (loaded->classes = malloc(sizeof(classes))) ) {
+    memcpy(loaded->classes, classes, sizeof(classes));
+  } else {
+    http_stats_destroy(loaded);
+    return 0;
+  }
+  if ( flags & http_stats_snapshot_flags_histograms ) {
+    if ( ! http_stats_enable_histograms(loaded) ) {
+      http_stats_destroy(loaded);
+      return 0;
+    }
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
+      for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
+        uint32_t        n_used;
+        
+        if ( (size_t)(end - p) < sizeof(uint32_t) ) goto malformed;
+        n_used = le_get_u32(&p);
+        if ( (uint64_t)(end - p) < 2ULL * sizeof(uint32_t) * n_used ) goto malformed;
+        while ( n_used-- ) {
+          uint32_t      i_b = le_get_u32(&p);
+          
+          if ( i_b >= HTTP_STATS_HISTOGRAM_BUCKETS ) goto malformed;
+          loaded->histograms[i_s][i_f][i_b] = le_get_u32(&p);
+        }
+      }
+    }
+  }
+  http_stats_merge(the_stats, loaded);
+  http_stats_destroy(loaded);
+  return n_bytes;
+
+malformed:
+  http_stats_destroy(loaded);
+  return 0;
+}
+
+//
+
+bool
+http_stats_fwrite_snapshot(
+  FILE            *fptr,
+  http_stats_ref  the_stats
+)
+{
+  size_t          length;
+  void            *snapshot = http_stats_snapshot(the_stats, &length);
+  bool            ok = false;
+  
+  if ( snapshot ) {
+    ok = (fwrite(snapshot, 1, length, fptr) == length);
+    free(snapshot);
+  }
+  return ok;
+}
+
+//
+
+int
+http_stats_fread_snapshot(
+  FILE            *fptr,
+  http_stats_ref  the_stats
+)
+{
+  uint8_t         header[HTTP_STATS_SNAPSHOT_HEADER_LENGTH], *snapshot;
+  const uint8_t   *p = header + 16;
+  size_t          n_read = fread(header, 1, sizeof(header), fptr);
+  uint32_t        length;
+  int             rc = -1;
+  
+  if ( n_read == 0 && feof(fptr) ) return 0;
+  if ( (n_read != sizeof(header)) || memcmp(header, HTTP_STATS_SNAPSHOT_MAGIC, 8) ) return -1;
+  
+  // The length covers the whole snapshot, header included:
+  length = le_get_u32(&p);
+  if ( length < sizeof(header) ) return -1;
+  if ( (snapshot = malloc(length)) ) {
+    memcpy(snapshot, header, sizeof(header));
+    if ( (fread(snapshot + sizeof(header), 1, length - sizeof(header), fptr) == length - sizeof(header)) && http_stats_merge_snapshot(the_stats, snapshot, length) ) rc = 1;
+    free((void*)snapshot);
+  }
+  return rc;
+}
+
 //
 
 void
@@ -213,10 +908,27 @@ http_stats_print(
 
 //
 
-const char      *http_stats_field_labels[] = { "dns lookup/ms", "tcp connect/ms", "ssl handshake/ms", "request sent/ms", "response start/ms", "total time/ms", "content/bytes" };
+const char      *http_stats_field_labels[] = { "dns lookup/ms", "tcp connect/ms", "ssl handshake/ms", "request sent/ms", "response start/ms", "total time/ms", "content/bytes", "new connections" };
 
 const char      *http_stats_bystatus_labels[] = { "All requests", "2XX", "3XX", "4XX", "5XX" };
 
+const char      *http_stats_percentile_labels[] = { "p50", "p90", "p99", "p99.9", "p99.99" };
+
+const double    http_stats_percentile_values[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+
+//
+
+const char*
+http_stats_field_get_label(
+  http_stats_field  field
+)
+{
+  if ( field >= http_stats_field_dns && field < http_stats_field_max ) return http_stats_field_labels[field];
+  return NULL;
+}
+
+//
+
 void
 http_stats_fprint(
   FILE            				*fptr,
@@ -227,6 +939,8 @@ http_stats_fprint(
 {
   http_stats_bystatus   i_s;
   http_stats_field      i_f;
+  http_stats_percentile i_p;
+  bool                  show_percentiles = ((flags & http_stats_print_flags_percentiles) == http_stats_print_flags_percentiles) ? true : false;
   
   if ( (flags & http_stats_print_flags_header_only) == http_stats_print_flags_header_only  ) {
   	flags &= ~http_stats_print_flags_no_header;
@@ -240,48 +954,65 @@ http_stats_fprint(
 			if ( (flags & http_stats_print_flags_show_all) != http_stats_print_flags_show_all ) {
 				// Check to be sure we have anything to show:
 				for ( i_s = http_stats_bystatus_2XX; i_s < http_stats_bystatus_max; i_s++ ) {
-					if ( the_stats->count[i_s] > 0 ) how_many++;
+					if ( __http_stats_class(the_stats, i_s)->count > 0 ) how_many++;
 				}
 			} else {
 				how_many = http_stats_bystatus_max;
 			}
 			if ( ((flags & http_stats_print_flags_header_only) == http_stats_print_flags_header_only) || (how_many > 0) ) {
 				if ( (flags & http_stats_print_flags_no_header) != http_stats_print_flags_no_header ) {
-					fprintf(fptr,
-							"~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~\n"
-							"%-24s %8s %8s %8s %10s %10s\n"
-							"~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~\n",
-							"data point", "#req", "min", "max", "avg", "std dev"
-						);
+					fprintf(fptr, "~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~");
+					if ( show_percentiles ) for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) fprintf(fptr, " ~~~~~~~~");
+					fprintf(fptr, "\n%-24s %8s %8s %8s %10s %10s", "data point", "#req", "min", "max", "avg", "std dev");
+					if ( show_percentiles ) for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) fprintf(fptr, " %8s", http_stats_percentile_labels[i_p]);
+					fprintf(fptr, "\n~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~");
+					if ( show_percentiles ) for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) fprintf(fptr, " ~~~~~~~~");
+					fputc('\n', fptr);
 					if ( (flags & http_stats_print_flags_header_only) == http_stats_print_flags_header_only ) return;
 				}
 				for ( i_s = (how_many == 1) ? http_stats_bystatus_2XX : http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) {
-					if ( the_stats->count[i_s] > 0 ) {
-						fprintf(fptr, "%-24s %8s %8s %8s %10s %10s\n", http_stats_bystatus_labels[i_s], "", "min", "max", "avg", "std dev");
+					const http_stats_class	*the_class = __http_stats_class(the_stats, i_s);
+					
+					if ( the_class->count > 0 ) {
+						fprintf(fptr, "%-24s %8s %8s %8s %10s %10s", http_stats_bystatus_labels[i_s], "", "min", "max", "avg", "std dev");
+						if ( show_percentiles ) for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) fprintf(fptr, " %8s", http_stats_percentile_labels[i_p]);
+						fputc('\n', fptr);
 						for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
-							if ( the_stats->count[i_s] > 1 ) {
+							if ( the_class->count > 1 ) {
 								fprintf(fptr,
-										"+ %-22s %8u %8.3lg %8.3lg %10.3lg %10.3lg\n",
+										"+ %-22s %8u %8.3lg %8.3lg %10.3lg %10.3lg",
 										http_stats_field_labels[i_f],
-										the_stats->count[i_s],
-										the_stats->min[i_s][i_f],
-										the_stats->max[i_s][i_f],
-										the_stats->m_i[i_s][i_f],
-										sqrt(the_stats->s_i[i_s][i_f] / (the_stats->count[i_s] - 1))
+										the_class->count,
+										the_class->min[i_f],
+										the_class->max[i_f],
+										the_class->m_i[i_f],
+										sqrt(the_class->s_i[i_f] / (the_class->count - 1))
 									);
 							} else {
 								fprintf(fptr,
-										"+ %-22s %8u %8.3lg %8.3lg %10.3lg %10s\n",
+										"+ %-22s %8u %8.3lg %8.3lg %10.3lg %10s",
 										http_stats_field_labels[i_f],
-										the_stats->count[i_s],
-										the_stats->min[i_s][i_f],
-										the_stats->max[i_s][i_f],
-										the_stats->m_i[i_s][i_f],
+										the_class->count,
+										the_class->min[i_f],
+										the_class->max[i_f],
+										the_class->m_i[i_f],
 										"n/a"
 									);
 							}
+							if ( show_percentiles ) {
+								for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) {
+									if ( __http_stats_histograms_cover_class(the_stats, i_s) ) {
+										fprintf(fptr, " %8.3lg", http_stats_get_percentile(the_stats, i_s, i_f, http_stats_percentile_values[i_p]));
+									} else {
+										fprintf(fptr, " %8s", "n/a");
+									}
+								}
+							}
+							fputc('\n', fptr);
 						}
-						fprintf(fptr, "~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~\n");
+						fprintf(fptr, "~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~");
+						if ( show_percentiles ) for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) fprintf(fptr, " ~~~~~~~~");
+						fputc('\n', fptr);
 					}
 				}
 			}
@@ -308,6 +1039,14 @@ http_stats_fprint(
 								"%3$c\"min, %1$s %2$s\"%3$c\"max, %1$s %2$s\"%3$c\"avg, %1$s %2$s\"%3$c\"stddev, %1$s %2$s\"",
 								http_stats_bystatus_labels[i_s], http_stats_field_labels[i_f], delim
 							);
+						if ( show_percentiles ) {
+							for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) {
+								fprintf(fptr,
+										"%4$c\"%3$s, %1$s %2$s\"",
+										http_stats_bystatus_labels[i_s], http_stats_field_labels[i_f], http_stats_percentile_labels[i_p], delim
+									);
+							}
+						}
 					}
 				}
 				fputc('\n', fptr);
@@ -315,34 +1054,45 @@ http_stats_fprint(
 			}
 			
 			for ( i_s = http_stats_bystatus_2XX; i_s < http_stats_bystatus_max; i_s++ ) {
-				if ( the_stats->count[i_s] > 0 ) {
-					fprintf(fptr, (i_s == http_stats_bystatus_2XX) ? "%1$u" : "%2$c%1$u", the_stats->count[i_s], delim);
+				const http_stats_class	*the_class = __http_stats_class(the_stats, i_s);
+				
+				if ( the_class->count > 0 ) {
+					fprintf(fptr, (i_s == http_stats_bystatus_2XX) ? "%1$u" : "%2$c%1$u", the_class->count, delim);
 				} else if ( i_s > http_stats_bystatus_2XX ) {
 					fprintf(fptr, "%c", delim);
 				}
 				for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) {
-					if ( the_stats->count[i_s] == 0 ) {
+					if ( the_class->count == 0 ) {
 						fprintf(fptr,
 								"%c%c%c%c",
 								delim, delim, delim, delim
 							);
-					} else if ( the_stats->count[i_s] > 1 ) {
+					} else if ( the_class->count > 1 ) {
 						fprintf(fptr,
 								"%c%g%c%g%c%g%c%g",
-								delim, the_stats->min[i_s][i_f],
-								delim, the_stats->max[i_s][i_f],
-								delim, the_stats->m_i[i_s][i_f],
-								delim, sqrt(the_stats->s_i[i_s][i_f] / (the_stats->count[i_s] - 1))
+								delim, the_class->min[i_f],
+								delim, the_class->max[i_f],
+								delim, the_class->m_i[i_f],
+								delim, sqrt(the_class->s_i[i_f] / (the_class->count - 1))
 							);
 					} else {
 						fprintf(fptr,
 								"%c%g%c%g%c%g%c",
-								delim, the_stats->min[i_s][i_f],
-								delim, the_stats->max[i_s][i_f],
-								delim, the_stats->m_i[i_s][i_f],
+								delim, the_class->min[i_f],
+								delim, the_class->max[i_f],
+								delim, the_class->m_i[i_f],
 								delim
 							);
 					}
+					if ( show_percentiles ) {
+						for ( i_p = 0; i_p < http_stats_percentile_max; i_p++ ) {
+							if ( ! __http_stats_histograms_cover_class(the_stats, i_s) ) {
+								fputc(delim, fptr);
+							} else {
+								fprintf(fptr, "%c%g", delim, http_stats_get_percentile(the_stats, i_s, i_f, http_stats_percentile_values[i_p]));
+							}
+						}
+					}
 				}
 			}
 			fputc('\n', fptr);
@@ -355,3 +1105,328 @@ http_stats_fprint(
 	}
 	
 }
+
+//
+// Time series:  window w covers [origin + w * interval, origin + (w + 1) * interval)
+// and lives in slot w % capacity.  Each slot remembers which window it holds;
+// the kept windows are always newest - capacity + 1 through newest, and the
+// stats for a window are only allocated once something lands in it.
+//
+
+typedef struct _http_stats_series {
+  double                origin, origin_wallclock, interval;
+  unsigned int          capacity;
+  long long             newest;
+  long long             *window_ids;
+  http_stats_ref        *windows;
+  http_stats_pool_ref   pool;
+  unsigned long long    dropped;
+} http_stats_series;
+
+#define HTTP_STATS_SERIES_DEFAULT_CAPACITY    3600
+
+//
+
+http_stats_series_ref
+http_stats_series_create(
+  double          origin,
+  double          interval,
+  unsigned int    capacity
+)
+{
+  http_stats_series *new_series;
+  
+  if ( interval <= 0.0 ) return NULL;
+  if ( capacity == 0 ) capacity = HTTP_STATS_SERIES_DEFAULT_CAPACITY;
+  
+  if ( (new_series = malloc(sizeof(http_stats_series))) ) {
+    struct timeval  now;
+    
+    //
+    // Window start times are reported by the wall clock so they can be lined
+    // up with server-side logs:
+    //
+    gettimeofday(&now, NULL);
+    new_series->origin = origin;
+    new_series->origin_wallclock = (now.tv_sec + 1e-6 * now.tv_usec) - (monotonic_seconds() - origin);
+    new_series->interval = interval;
+    new_series->capacity = capacity;
+    new_series->newest = -1;
+    new_series->dropped = 0;
+    new_series->window_ids = malloc(capacity * sizeof(long long));
+    new_series->windows = calloc(capacity, sizeof(http_stats_ref));
+    new_series->pool = http_stats_pool_create(0);
+    if ( ! new_series->window_ids || ! new_series->windows || ! new_series->pool ) {
+      http_stats_series_destroy(new_series);
+      return NULL;
+    }
+    memset(new_series->window_ids, 0xFF, capacity * sizeof(long long));
+  }
+  return new_series;
+}
+
+//
+
+http_stats_series_ref
+http_stats_series_create_like(
+  http_stats_series_ref the_series
+)
+{
+  http_stats_series     *new_series = http_stats_series_create(the_series->origin, the_series->interval, the_series->capacity);
+  
+  // Same windows, down to the wall-clock time reported for each:
+  if ( new_series ) new_series->origin_wallclock = the_series->origin_wallclock;
+  return new_series;
+}
+
+//
+
+void
+http_stats_series_destroy(
+  http_stats_series_ref the_series
+)
+{
+  // The windows themselves belong to the pool:
+  if ( the_series->pool ) http_stats_pool_destroy(the_series->pool);
+  if ( the_series->windows ) free((void*)the_series->windows);
+  if ( the_series->window_ids ) free((void*)the_series->window_ids);
+  free((void*)the_series);
+}
+
+//
+
+double
+http_stats_series_get_interval(
+  http_stats_series_ref the_series
+)
+{
+  return the_series->interval;
+}
+
+//
+
+unsigned long long
+http_stats_series_get_dropped(
+  http_stats_series_ref the_series
+)
+{
+  return the_series->dropped;
+}
+
+//
+
+static http_stats_ref
+__http_stats_series_window(
+  http_stats_series     *the_series,
+  long long             window
+)
+{
+  unsigned int          slot = window % the_series->capacity;
+  
+  // Already rotated out of the ring:
+  if ( window <= the_series->newest - the_series->capacity ) return NULL;
+  
+  //
+  // Moving the ring forward evicts the windows it laps; whatever they held
+  // counts as dropped:
+  //
+  if ( window > the_series->newest ) {
+    long long           k = the_series->newest + 1;
+    
+    if ( k < window - the_series->capacity + 1 ) k = window - the_series->capacity + 1;
+    while ( k <= window ) {
+      unsigned int      k_slot = k % the_series->capacity;
+      
+      if ( the_series->windows[k_slot] && (the_series->window_ids[k_slot] != k) ) {
+        the_series->dropped += __http_stats_class(the_series->windows[k_slot], http_stats_bystatus_all)->count;
+        http_stats_reset(the_series->windows[k_slot]);
+      }
+      the_series->window_ids[k_slot] = k;
+      k++;
+    }
+    the_series->newest = window;
+  }
+  if ( ! the_series->windows[slot] && ! (the_series->windows[slot] = http_stats_pool_alloc(the_series->pool)) ) return NULL;
+  return the_series->windows[slot];
+}
+
+//
+
+bool
+http_stats_series_update_with_record(
+  http_stats_series_ref the_series,
+  double                timestamp,
+  long                  http_status,
+  http_stats_record     *record
+)
+{
+  long long             window = (timestamp > the_series->origin) ? (long long)floor((timestamp - the_series->origin) / the_series->interval) : 0;
+  http_stats_ref        the_window = __http_stats_series_window(the_series, window);
+  
+  if ( ! the_window ) {
+    the_series->dropped++;
+    return false;
+  }
+  return http_stats_update_with_record(the_window, http_status, record);
+}
+
+//
+
+bool
+http_stats_series_merge(
+  http_stats_series_ref dst,
+  http_stats_series_ref src
+)
+{
+  unsigned int          slot;
+  
+  if ( (dst->origin != src->origin) || (dst->interval != src->interval) || (dst->capacity != src->capacity) ) return false;
+  
+  for ( slot = 0; slot < src->capacity; slot++ ) {
+    if ( src->windows[slot] && (src->window_ids[slot] > src->newest - src->capacity) ) {
+      http_stats_ref    the_window = __http_stats_series_window(dst, src->window_ids[slot]);
+      
+      if ( the_window ) {
+        http_stats_merge(the_window, src->windows[slot]);
+      } else {
+        dst->dropped += __http_stats_class(src->windows[slot], http_stats_bystatus_all)->count;
+      }
+    }
+  }
+  dst->dropped += src->dropped;
+  return true;
+}
+
+//
+
+void
+http_stats_series_print(
+  http_stats_format       format,
+  http_stats_print_flags  flags,
+  http_stats_series_ref   the_series
+)
+{
+  http_stats_series_fprint(stdout, format, flags, the_series);
+}
+
+//
+
+void
+http_stats_series_fprint(
+  FILE                    *fptr,
+  http_stats_format       format,
+  http_stats_print_flags  flags,
+  http_stats_series_ref   the_series
+)
+{
+  long long               oldest = the_series->newest, window;
+  unsigned int            slot;
+  char                    delim = (format == http_stats_format_tsv) ? '\t' : ',';
+  
+  //
+  // Start at the oldest window still in the ring:
+  //
+  for ( slot = 0; slot < the_series->capacity; slot++ ) {
+    long long             id = the_series->window_ids[slot];
+    
+    if ( the_series->windows[slot] && (id > the_series->newest - the_series->capacity) && (id < oldest) ) oldest = id;
+  }
+  
+  if ( (flags & http_stats_print_flags_no_header) != http_stats_print_flags_no_header ) {
+    switch ( format ) {
+      case http_stats_format_table:
+        fprintf(fptr, "~~~~~~~~~~~~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~\n");
+        fprintf(fptr, "%-19s %10s %8s %8s %8s %8s %8s %10s %10s %8s %8s %8s %8s\n",
+            "time", "elapsed/s", "#req", "2XX", "3XX", "4XX", "5XX", "req/s", "bytes/s", "min/ms", "max/ms", "avg/ms", "std dev"
+          );
+        fprintf(fptr, "~~~~~~~~~~~~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~ ~~~~~~~~\n");
+        break;
+        
+      case http_stats_format_csv:
+      case http_stats_format_tsv:
+        fprintf(fptr,
+            "\"time\"%1$c\"elapsed/s\"%1$c\"count, All requests\"%1$c\"count, 2XX\"%1$c\"count, 3XX\"%1$c\"count, 4XX\"%1$c\"count, 5XX\"%1$c"
+            "\"requests/s\"%1$c\"content bytes/s\"%1$c\"new connections\"%1$c"
+            "\"min, %2$s\"%1$c\"max, %2$s\"%1$c\"avg, %2$s\"%1$c\"stddev, %2$s\"%1$c\"avg, %3$s\"\n",
+            delim, http_stats_field_labels[http_stats_field_total], http_stats_field_labels[http_stats_field_response]
+          );
+        break;
+        
+      case http_stats_format_max:
+        break;
+    }
+    if ( (flags & http_stats_print_flags_header_only) == http_stats_print_flags_header_only ) return;
+  }
+  if ( the_series->newest < 0 ) return;
+  
+  for ( window = oldest; window <= the_series->newest; window++ ) {
+    http_stats_ref          the_window = the_series->windows[window % the_series->capacity];
+    bool                    is_present = the_window && (the_series->window_ids[window % the_series->capacity] == window);
+    const http_stats_class  *all = is_present ? __http_stats_class(the_window, http_stats_bystatus_all) : &__http_stats_empty_class;
+    double                  start = the_series->origin_wallclock + window * the_series->interval;
+    double                  elapsed = window * the_series->interval;
+    unsigned int            counts[http_stats_bystatus_max];
+    http_stats_bystatus     i_s;
+    double                  bytes = all->count ? all->m_i[http_stats_field_content_bytes] * all->count : 0.0;
+    double                  connects = all->count ? all->m_i[http_stats_field_num_connects] * all->count : 0.0;
+    
+    for ( i_s = http_stats_bystatus_all; i_s < http_stats_bystatus_max; i_s++ ) counts[i_s] = is_present ? __http_stats_class(the_window, i_s)->count : 0;
+    
+    switch ( format ) {
+      case http_stats_format_table: {
+        time_t              start_sec = (time_t)start;
+        struct tm           start_tm;
+        char                start_str[32];
+        
+        localtime_r(&start_sec, &start_tm);
+        strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", &start_tm);
+        fprintf(fptr, "%-19s %10.3lf %8u %8u %8u %8u %8u %10.3lg %10.3lg",
+            start_str, elapsed,
+            counts[http_stats_bystatus_all], counts[http_stats_bystatus_2XX], counts[http_stats_bystatus_3XX], counts[http_stats_bystatus_4XX], counts[http_stats_bystatus_5XX],
+            counts[http_stats_bystatus_all] / the_series->interval, bytes / the_series->interval
+          );
+        if ( all->count > 1 ) {
+          fprintf(fptr, " %8.3lg %8.3lg %8.3lg %8.3lg\n",
+              all->min[http_stats_field_total], all->max[http_stats_field_total], all->m_i[http_stats_field_total],
+              sqrt(all->s_i[http_stats_field_total] / (all->count - 1))
+            );
+        } else if ( all->count == 1 ) {
+          fprintf(fptr, " %8.3lg %8.3lg %8.3lg %8s\n",
+              all->min[http_stats_field_total], all->max[http_stats_field_total], all->m_i[http_stats_field_total], "n/a"
+            );
+        } else {
+          fprintf(fptr, " %8s %8s %8s %8s\n", "-", "-", "-", "-");
+        }
+        break;
+      }
+      
+      case http_stats_format_csv:
+      case http_stats_format_tsv: {
+        fprintf(fptr, "%.3lf%c%g%c%u%c%u%c%u%c%u%c%u%c%g%c%g%c%.0lf",
+            start, delim, elapsed,
+            delim, counts[http_stats_bystatus_all], delim, counts[http_stats_bystatus_2XX], delim, counts[http_stats_bystatus_3XX],
+            delim, counts[http_stats_bystatus_4XX], delim, counts[http_stats_bystatus_5XX],
+            delim, counts[http_stats_bystatus_all] / the_series->interval, delim, bytes / the_series->interval, delim, connects
+          );
+        if ( all->count > 1 ) {
+          fprintf(fptr, "%c%g%c%g%c%g%c%g%c%g\n",
+              delim, all->min[http_stats_field_total], delim, all->max[http_stats_field_total], delim, all->m_i[http_stats_field_total],
+              delim, sqrt(all->s_i[http_stats_field_total] / (all->count - 1)), delim, all->m_i[http_stats_field_response]
+            );
+        } else if ( all->count == 1 ) {
+          fprintf(fptr, "%c%g%c%g%c%g%c%c%g\n",
+              delim, all->min[http_stats_field_total], delim, all->max[http_stats_field_total], delim, all->m_i[http_stats_field_total],
+              delim, delim, all->m_i[http_stats_field_response]
+            );
+        } else {
+          fprintf(fptr, "%c%c%c%c%c\n", delim, delim, delim, delim, delim);
+        }
+        break;
+      }
+      
+      case http_stats_format_max:
+        break;
+    }
+  }
+}
+
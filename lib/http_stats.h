@@ -17,12 +17,15 @@ typedef enum {
   http_stats_field_response,
   http_stats_field_total,
   http_stats_field_content_bytes,
+  http_stats_field_num_connects,
   //
   http_stats_field_max
 } http_stats_field;
 
 typedef double http_stats_record[http_stats_field_max];
 
+const char* http_stats_field_get_label(http_stats_field field);
+
 typedef enum {
   http_stats_bystatus_all = 0,
   http_stats_bystatus_2XX,
@@ -33,12 +36,23 @@ typedef enum {
   http_stats_bystatus_max
 } http_stats_bystatus;
 
+typedef enum {
+  http_stats_percentile_50 = 0,
+  http_stats_percentile_90,
+  http_stats_percentile_99,
+  http_stats_percentile_99_9,
+  http_stats_percentile_99_99,
+  //
+  http_stats_percentile_max
+} http_stats_percentile;
+
 typedef struct {
   unsigned int    count;
   double          min, max;
   double          average;
   double          variance;
   double          stddev;
+  double          percentile[http_stats_percentile_max];
 } http_stats_data;
 
 typedef struct _http_stats * http_stats_ref;
@@ -46,21 +60,67 @@ typedef struct _http_stats * http_stats_ref;
 http_stats_ref http_stats_create(void);
 void http_stats_destroy(http_stats_ref the_stats);
 
+//
+// A pool hands out stats objects from large slabs, for callers that need many
+// of them (e.g. one per file system entity).  Destroying a pooled object
+// returns it to the pool; destroying the pool releases all of its objects.
+// A slab_capacity of 0 selects a default.
+//
+typedef struct _http_stats_pool * http_stats_pool_ref;
+
+http_stats_pool_ref http_stats_pool_create(unsigned int slab_capacity);
+void http_stats_pool_destroy(http_stats_pool_ref the_pool);
+http_stats_ref http_stats_pool_alloc(http_stats_pool_ref the_pool);
+
 bool http_stats_get(http_stats_ref the_stats, http_stats_bystatus bystatus, http_stats_field field, http_stats_data *out_data);
 
 void http_stats_reset(http_stats_ref the_stats);
 
+bool http_stats_get_has_histograms(http_stats_ref the_stats);
+bool http_stats_enable_histograms(http_stats_ref the_stats);
+
+//
+// Percentiles are only available for a class whose every sample went into
+// the histograms; merging statistics kept without histograms into ones with
+// them (or vice versa) leaves the percentiles of the affected classes
+// unavailable, and http_stats_get_percentile() then returns 0:
+//
+bool http_stats_get_has_percentiles(http_stats_ref the_stats, http_stats_bystatus bystatus);
+double http_stats_get_percentile(http_stats_ref the_stats, http_stats_bystatus bystatus, http_stats_field field, double percentile);
+
 bool http_stats_update(http_stats_ref the_stats, CURL *curl_request);
 bool http_stats_update_and_copy(http_stats_ref the_stats, CURL *curl_request, http_stats_record *copy);
+bool http_stats_update_with_record(http_stats_ref the_stats, long http_status, http_stats_record *record);
+
+bool http_stats_record_from_curl(CURL *curl_request, long *http_status, http_stats_record *record);
+
+void http_stats_merge(http_stats_ref dst, http_stats_ref src);
 
 bool http_stats_is_empty(http_stats_ref the_stats);
 
+//
+// A snapshot is a versioned, self-contained binary copy of a stats object
+// (counts, running moments, min/max and any histograms, in little-endian byte
+// order) so statistics gathered on separate hosts can be combined exactly:
+//
+//   http_stats_snapshot()         returns a malloc'd snapshot and its length
+//   http_stats_merge_snapshot()   merges a snapshot into the_stats; returns the
+//                                 number of bytes it occupied, 0 if malformed
+//   http_stats_fread_snapshot()   merges the next snapshot in a file; returns 1,
+//                                 0 at end of file or -1 on error
+//
+void* http_stats_snapshot(http_stats_ref the_stats, size_t *length);
+size_t http_stats_merge_snapshot(http_stats_ref the_stats, const void *snapshot, size_t length);
+bool http_stats_fwrite_snapshot(FILE *fptr, http_stats_ref the_stats);
+int http_stats_fread_snapshot(FILE *fptr, http_stats_ref the_stats);
+
 typedef enum {
 	http_stats_print_flags_none = 0,
 	http_stats_print_flags_show_all = 1 << 0,
 	http_stats_print_flags_no_newline = 1 << 1,
 	http_stats_print_flags_no_header = 1 << 2,
-	http_stats_print_flags_header_only = 1 << 3
+	http_stats_print_flags_header_only = 1 << 3,
+	http_stats_print_flags_percentiles = 1 << 4
 } http_stats_print_flags;
 
 typedef enum {
@@ -74,4 +134,32 @@ typedef enum {
 void http_stats_print(http_stats_format format, http_stats_print_flags flags, http_stats_ref the_stats);
 void http_stats_fprint(FILE *fptr, http_stats_format format, http_stats_print_flags flags, http_stats_ref the_stats);
 
+//
+// A time series of statistics:  a ring of capacity windows (0 selects a
+// default of 3600), each covering interval seconds of the monotonic clock
+// counted from origin (see monotonic_seconds()).  Only the most recent
+// capacity windows are kept; records older than that are dropped (and
+// counted).  Series with the same origin, interval and capacity can be
+// merged, e.g. one per worker thread.
+//
+typedef struct _http_stats_series * http_stats_series_ref;
+
+http_stats_series_ref http_stats_series_create(double origin, double interval, unsigned int capacity);
+http_stats_series_ref http_stats_series_create_like(http_stats_series_ref the_series);
+void http_stats_series_destroy(http_stats_series_ref the_series);
+
+double http_stats_series_get_interval(http_stats_series_ref the_series);
+unsigned long long http_stats_series_get_dropped(http_stats_series_ref the_series);
+
+bool http_stats_series_update_with_record(http_stats_series_ref the_series, double timestamp, long http_status, http_stats_record *record);
+bool http_stats_series_merge(http_stats_series_ref dst, http_stats_series_ref src);
+
+//
+// One row per window from the oldest kept to the newest, including windows
+// in which nothing completed:  wall-clock start time, request counts by class,
+// request and byte rates, and the total time distribution:
+//
+void http_stats_series_print(http_stats_format format, http_stats_print_flags flags, http_stats_series_ref the_series);
+void http_stats_series_fprint(FILE *fptr, http_stats_format format, http_stats_print_flags flags, http_stats_series_ref the_series);
+
 #endif /* __HTTP_STATS_H__ */
@@ -0,0 +1,336 @@
+//
+// http_trace.c
+//
+
+#include "http_trace.h"
+#include "util_fns.h"
+
+#include <pthread.h>
+#include <sys/time.h>
+
+//
+// The ring is a bounded multi-producer queue (after Dmitry Vyukov's):  each
+// cell carries a sequence number that says whose turn it is.  A producer
+// claims position p by advancing enqueue_pos, fills the cell and publishes it
+// by setting its sequence to p + 1; the writer consumes it and hands the cell
+// to the producer one lap later by setting its sequence to p + capacity.
+//
+
+typedef struct {
+  uint64_t            sequence;
+  http_trace_record   record;
+} http_trace_cell;
+
+#define HTTP_TRACE_DEFAULT_CAPACITY   65536
+#define HTTP_TRACE_WRITE_BATCH        1024
+#define HTTP_TRACE_IDLE_USEC          1000
+
+typedef struct _http_trace {
+  FILE                *fptr;
+  double              origin;
+  uint64_t            mask;
+  http_trace_cell     *cells;
+  uint64_t            enqueue_pos;
+  uint64_t            dequeue_pos;
+  uint64_t            dropped;
+  bool                should_stop;
+  bool                has_write_error;
+  pthread_t           writer;
+} http_trace;
+
+//
+
+static unsigned int
+__http_trace_drain(
+  http_trace          *the_trace,
+  http_trace_record   *batch
+)
+{
+  unsigned int        n = 0;
+
+  while ( n < HTTP_TRACE_WRITE_BATCH ) {
+    http_trace_cell   *cell = &the_trace->cells[the_trace->dequeue_pos & the_trace->mask];
+
+    if ( __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != the_trace->dequeue_pos + 1 ) break;
+    batch[n++] = cell->record;
+    __atomic_store_n(&cell->sequence, the_trace->dequeue_pos + the_trace->mask + 1, __ATOMIC_RELEASE);
+    the_trace->dequeue_pos++;
+  }
+  return n;
+}
+
+//
+
+static uint8_t*
+__http_trace_encode_record(
+  uint8_t                 *p,
+  const http_trace_record *record
+)
+{
+  unsigned int            i_t;
+
+  p = le_put_double(p, record->timestamp);
+  p = le_put_u32(p, record->url_index);
+  p = le_put_u32(p, (uint32_t)(uint16_t)record->http_status | ((uint32_t)record->method << 16));
+  for ( i_t = 0; i_t < HTTP_TRACE_N_TIMINGS; i_t++ ) p = le_put_float(p, record->timings[i_t]);
+  p = le_put_u64(p, record->content_bytes);
+  p = le_put_u32(p, record->num_connects);
+  return le_put_u32(p, 0);
+}
+
+//
+
+static void*
+__http_trace_writer(
+  void                *context
+)
+{
+  http_trace          *the_trace = (http_trace*)context;
+  http_trace_record   *batch = malloc(HTTP_TRACE_WRITE_BATCH * sizeof(http_trace_record));
+  uint8_t             *bytes = malloc(HTTP_TRACE_WRITE_BATCH * HTTP_TRACE_RECORD_LENGTH);
+
+  if ( ! batch || ! bytes ) {
+    if ( batch ) free((void*)batch);
+    if ( bytes ) free((void*)bytes);
+    the_trace->has_write_error = true;
+    return NULL;
+  }
+  while ( true ) {
+    bool              should_stop = __atomic_load_n(&the_trace->should_stop, __ATOMIC_ACQUIRE);
+    unsigned int      n = __http_trace_drain(the_trace, batch);
+
+    if ( n ) {
+      //
+      // Records are only put into their file format here, off the request path:
+      //
+      uint8_t         *p = bytes;
+      unsigned int    i;
+
+      for ( i = 0; i < n; i++ ) p = __http_trace_encode_record(p, &batch[i]);
+      if ( fwrite(bytes, HTTP_TRACE_RECORD_LENGTH, n, the_trace->fptr) != n ) the_trace->has_write_error = true;
+    } else if ( should_stop ) {
+      //
+      // The stop flag was read before the ring came up empty, so nothing
+      // added before the stop can have been missed:
+      //
+      break;
+    } else {
+      usleep(HTTP_TRACE_IDLE_USEC);
+    }
+  }
+  free((void*)batch);
+  free((void*)bytes);
+  return NULL;
+}
+
+//
+
+http_trace_ref
+http_trace_create(
+  const char          *path,
+  unsigned int        capacity
+)
+{
+  http_trace          *new_trace;
+  uint64_t            n_cells = 1;
+
+  if ( capacity == 0 ) capacity = HTTP_TRACE_DEFAULT_CAPACITY;
+  while ( n_cells < capacity ) n_cells <<= 1;
+
+  if ( (new_trace = malloc(sizeof(http_trace))) ) {
+    uint8_t           header[HTTP_TRACE_HEADER_LENGTH], *p;
+    struct timeval    now;
+    uint64_t          i;
+
+    memset(new_trace, 0, sizeof(http_trace));
+    new_trace->mask = n_cells - 1;
+    if ( ! (new_trace->cells = malloc(n_cells * sizeof(http_trace_cell))) ) {
+      free((void*)new_trace);
+      return NULL;
+    }
+    for ( i = 0; i < n_cells; i++ ) new_trace->cells[i].sequence = i;
+
+    if ( ! (new_trace->fptr = fopen(path, "wb")) ) {
+      free((void*)new_trace->cells);
+      free((void*)new_trace);
+      return NULL;
+    }
+
+    // Timestamps are monotonic; the header says where they sit on the wall clock:
+    gettimeofday(&now, NULL);
+    new_trace->origin = monotonic_seconds();
+    memcpy(header, HTTP_TRACE_MAGIC, 8);
+    p = le_put_u32(header + 8, HTTP_TRACE_VERSION);
+    p = le_put_u32(p, HTTP_TRACE_RECORD_LENGTH);
+    le_put_double(p, now.tv_sec + 1e-6 * now.tv_usec);
+    if ( (fwrite(header, sizeof(header), 1, new_trace->fptr) != 1) || (pthread_create(&new_trace->writer, NULL, __http_trace_writer, new_trace) != 0) ) {
+      fclose(new_trace->fptr);
+      free((void*)new_trace->cells);
+      free((void*)new_trace);
+      return NULL;
+    }
+  }
+  return new_trace;
+}
+
+//
+
+bool
+http_trace_add(
+  http_trace_ref      the_trace,
+  unsigned int        url_index,
+  http_ops_method     method,
+  long                http_status,
+  http_stats_record   *record
+)
+{
+  uint64_t            pos = __atomic_load_n(&the_trace->enqueue_pos, __ATOMIC_RELAXED);
+  http_trace_cell     *cell;
+  unsigned int        i_t;
+
+  while ( true ) {
+    int64_t           lap;
+
+    cell = &the_trace->cells[pos & the_trace->mask];
+    lap = (int64_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+    if ( lap == 0 ) {
+      if ( __atomic_compare_exchange_n(&the_trace->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) break;
+    } else if ( lap < 0 ) {
+      // The writer hasn't emptied this cell yet, the ring is full:
+      __atomic_add_fetch(&the_trace->dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      pos = __atomic_load_n(&the_trace->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  cell->record.timestamp = monotonic_seconds() - the_trace->origin;
+  cell->record.url_index = url_index;
+  cell->record.http_status = (http_status > 0) ? (int16_t)http_status : 0;
+  cell->record.method = (uint8_t)method;
+  for ( i_t = 0; i_t < HTTP_TRACE_N_TIMINGS; i_t++ ) cell->record.timings[i_t] = record ? (float)(*record)[i_t] : 0.0f;
+  cell->record.content_bytes = record ? (uint64_t)(*record)[http_stats_field_content_bytes] : 0;
+  cell->record.num_connects = record ? (uint32_t)(*record)[http_stats_field_num_connects] : 0;
+  __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+//
+
+unsigned long long
+http_trace_get_dropped(
+  http_trace_ref      the_trace
+)
+{
+  return __atomic_load_n(&the_trace->dropped, __ATOMIC_RELAXED);
+}
+
+//
+
+bool
+http_trace_close(
+  http_trace_ref      the_trace,
+  unsigned int        url_count,
+  http_trace_url_fn   url_at,
+  void                *context
+)
+{
+  bool                ok;
+
+  __atomic_store_n(&the_trace->should_stop, true, __ATOMIC_RELEASE);
+  pthread_join(the_trace->writer, NULL);
+  ok = ! the_trace->has_write_error;
+
+  if ( ok ) {
+    uint8_t             trailer[HTTP_TRACE_TRAILER_LENGTH];
+    long                offset = ftell(the_trace->fptr);
+    unsigned int        i;
+
+    if ( offset < 0 ) {
+      ok = false;
+    } else {
+      for ( i = 0; ok && url_at && (i < url_count); i++ ) {
+        size_t          length = 0;
+        const char      *url = url_at(context, i, &length);
+        uint8_t         length32[sizeof(uint32_t)];
+
+        if ( ! url ) length = 0;
+        le_put_u32(length32, (uint32_t)length);
+        if ( fwrite(length32, sizeof(length32), 1, the_trace->fptr) != 1 ) ok = false;
+        else if ( length && (fwrite(url, 1, length, the_trace->fptr) != length) ) ok = false;
+      }
+      memcpy(le_put_u64(le_put_u64(trailer, (uint64_t)offset), the_trace->dropped), HTTP_TRACE_TRAILER_MAGIC, 8);
+      if ( ok && (fwrite(trailer, sizeof(trailer), 1, the_trace->fptr) != 1) ) ok = false;
+    }
+  }
+  if ( fclose(the_trace->fptr) != 0 ) ok = false;
+  free((void*)the_trace->cells);
+  free((void*)the_trace);
+  return ok;
+}
+
+//
+
+void
+http_trace_decode_header(
+  const void          *bytes,
+  http_trace_header   *header
+)
+{
+  const uint8_t       *p = (const uint8_t*)bytes + 8;
+
+  memcpy(header->magic, bytes, 8);
+  header->version = le_get_u32(&p);
+  header->record_length = le_get_u32(&p);
+  header->origin = le_get_double(&p);
+}
+
+//
+
+void
+http_trace_decode_record(
+  const void          *bytes,
+  http_trace_record   *record
+)
+{
+  const uint8_t       *p = (const uint8_t*)bytes;
+  uint32_t            status_method;
+  unsigned int        i_t;
+
+  record->timestamp = le_get_double(&p);
+  record->url_index = le_get_u32(&p);
+  status_method = le_get_u32(&p);
+  record->http_status = (int16_t)(uint16_t)status_method;
+  record->method = (uint8_t)(status_method >> 16);
+  for ( i_t = 0; i_t < HTTP_TRACE_N_TIMINGS; i_t++ ) record->timings[i_t] = le_get_float(&p);
+  record->content_bytes = le_get_u64(&p);
+  record->num_connects = le_get_u32(&p);
+}
+
+//
+
+void
+http_trace_decode_trailer(
+  const void          *bytes,
+  http_trace_trailer  *trailer
+)
+{
+  const uint8_t       *p = (const uint8_t*)bytes;
+
+  trailer->url_table_offset = le_get_u64(&p);
+  trailer->dropped = le_get_u64(&p);
+  memcpy(trailer->magic, p, 8);
+}
+
+//
+
+double
+http_trace_record_get_field(
+  const http_trace_record *record,
+  http_stats_field        field
+)
+{
+  if ( field < HTTP_TRACE_N_TIMINGS ) return record->timings[field];
+  if ( field == http_stats_field_content_bytes ) return (double)record->content_bytes;
+  if ( field == http_stats_field_num_connects ) return record->num_connects;
+  return 0.0;
+}
@@ -0,0 +1,104 @@
+//
+// http_trace.h
+//
+// A per-request trace written in the background:  fixed-size binary records
+// go into a lock-free ring that any number of threads can add to, and a writer
+// thread drains the ring to a file.  Nothing on the request path formats text
+// or touches stdio; urltest_trace turns a trace file into CSV/TSV.
+//
+
+#ifndef __HTTP_TRACE_H__
+#define __HTTP_TRACE_H__
+
+#include "config.h"
+#include "http_ops.h"
+#include "http_stats.h"
+
+//
+// The file starts with a header, followed by one record per request in the
+// order they were added.  When the trace is closed normally a table of the
+// URLs the records' url_index refer to follows the records, located by a
+// trailer at the very end of the file; a trace cut short has no trailer, and
+// its records simply run to the end of the file.  Like the http_stats
+// snapshots, every value is little-endian whatever the host:
+//
+//   header     magic[8] version record_length (uint32_t) origin (double)
+//   record     timestamp (double) url_index (uint32_t) http_status (int16_t)
+//              method reserved (uint8_t) timings[6] (float) content_bytes
+//              (uint64_t) num_connects reserved (uint32_t)
+//   url table  n x { length (uint32_t), the URL (no nul) }
+//   trailer    url_table_offset dropped (uint64_t) magic[8]
+//
+#define HTTP_TRACE_MAGIC            "URLTRACE"
+#define HTTP_TRACE_TRAILER_MAGIC    "URLTRURL"
+#define HTTP_TRACE_VERSION          2
+
+// The timing fields, dns through total:
+#define HTTP_TRACE_N_TIMINGS        (http_stats_field_total + 1)
+
+#define HTTP_TRACE_HEADER_LENGTH    (8 + 2 * sizeof(uint32_t) + sizeof(double))
+#define HTTP_TRACE_RECORD_LENGTH    (sizeof(double) + 2 * sizeof(uint32_t) + HTTP_TRACE_N_TIMINGS * sizeof(float) + sizeof(uint64_t) + 2 * sizeof(uint32_t))
+#define HTTP_TRACE_TRAILER_LENGTH   (2 * sizeof(uint64_t) + 8)
+
+typedef struct {
+  char          magic[8];
+  uint32_t      version;
+  uint32_t      record_length;
+  double        origin;             // wall-clock time (seconds since the epoch) of timestamp zero
+} http_trace_header;
+
+typedef struct {
+  double        timestamp;          // seconds since the trace was created, when the request completed
+  uint32_t      url_index;
+  int16_t       http_status;        // 0 if the request failed outright
+  uint8_t       method;             // an http_ops_method
+  float         timings[HTTP_TRACE_N_TIMINGS];  // milliseconds
+  uint64_t      content_bytes;
+  uint32_t      num_connects;
+} http_trace_record;
+
+typedef struct {
+  uint64_t      url_table_offset;
+  uint64_t      dropped;
+  char          magic[8];
+} http_trace_trailer;
+
+//
+// Decode the header, a record or the trailer from the HTTP_TRACE_*_LENGTH
+// bytes read from a trace file; the magic and version are left to the caller
+// to check:
+//
+void http_trace_decode_header(const void *bytes, http_trace_header *header);
+void http_trace_decode_record(const void *bytes, http_trace_record *record);
+void http_trace_decode_trailer(const void *bytes, http_trace_trailer *trailer);
+
+//
+// A record's value for one of the http_stats fields:
+//
+double http_trace_record_get_field(const http_trace_record *record, http_stats_field field);
+
+typedef struct _http_trace * http_trace_ref;
+
+//
+// Creates the file at path and starts the writer thread; the ring holds
+// capacity records (rounded up to a power of two, 0 selects 65536).  If the
+// writer falls that far behind, further records are dropped and counted
+// rather than making the request path wait:
+//
+http_trace_ref http_trace_create(const char *path, unsigned int capacity);
+
+bool http_trace_add(http_trace_ref the_trace, unsigned int url_index, http_ops_method method, long http_status, http_stats_record *record);
+
+unsigned long long http_trace_get_dropped(http_trace_ref the_trace);
+
+//
+// Stops the writer once the ring is empty, appends the URL table (url_at is
+// called for each index below url_count; NULL leaves the table empty) and the
+// trailer, and closes the file; false is returned if anything could not be
+// written.  Every http_trace_add() must have returned before this is called:
+//
+typedef const char* (*http_trace_url_fn)(void *context, unsigned int index, size_t *length);
+
+bool http_trace_close(http_trace_ref the_trace, unsigned int url_count, http_trace_url_fn url_at, void *context);
+
+#endif /* __HTTP_TRACE_H__ */
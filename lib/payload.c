@@ -0,0 +1,193 @@
+//
+// payload.c
+//
+
+#include "payload.h"
+#include "util_fns.h"
+
+//
+
+#define PAYLOAD_DEFAULT_BUFFER_SIZE   (8 * 1024 * 1024)
+#define PAYLOAD_LINE_SIZE             64
+
+//
+
+typedef struct _payload_generator {
+  uint64_t        seed;
+  double          compressibility;
+  size_t          buffer_size;
+  uint8_t         *buffer;
+} payload_generator;
+
+//
+
+payload_generator_ref
+payload_generator_create(
+  uint64_t    seed,
+  size_t      buffer_size,
+  double      compressibility
+)
+{
+  payload_generator *new_generator;
+
+  if ( buffer_size == 0 ) buffer_size = PAYLOAD_DEFAULT_BUFFER_SIZE;
+
+  // Whole lines only:
+  buffer_size = (buffer_size + PAYLOAD_LINE_SIZE - 1) & ~((size_t)PAYLOAD_LINE_SIZE - 1);
+
+  if ( compressibility < 0.0 ) compressibility = 0.0;
+  else if ( compressibility > 1.0 ) compressibility = 1.0;
+
+  //
+  // The buffer is allocated at twice its nominal size and the second half is a
+  // copy of the first, so any run of up to buffer_size bytes starting within the
+  // first half is contiguous:
+  //
+  new_generator = malloc(sizeof(payload_generator) + 2 * buffer_size);
+  if ( new_generator ) {
+    prng_state      prng;
+    size_t          random_per_line = PAYLOAD_LINE_SIZE - (size_t)floor(compressibility * PAYLOAD_LINE_SIZE + 0.5);
+    size_t          i;
+
+    new_generator->seed = seed;
+    new_generator->compressibility = compressibility;
+    new_generator->buffer_size = buffer_size;
+    new_generator->buffer = ((uint8_t*)new_generator) + sizeof(payload_generator);
+
+    //
+    // Each line gets random_per_line random bytes; the rest of the line is
+    // zeroes that any compressor will squeeze out:
+    //
+    prng_seed(&prng, seed, 0);
+    for ( i = 0; i < buffer_size; i += PAYLOAD_LINE_SIZE ) {
+      size_t        j = 0;
+
+      while ( j < random_per_line ) {
+        uint64_t    r = prng_next(&prng);
+        size_t      n = random_per_line - j;
+
+        if ( n > sizeof(r) ) n = sizeof(r);
+        memcpy(new_generator->buffer + i + j, &r, n);
+        j += n;
+      }
+      if ( j < PAYLOAD_LINE_SIZE ) memset(new_generator->buffer + i + j, 0, PAYLOAD_LINE_SIZE - j);
+    }
+    memcpy(new_generator->buffer + buffer_size, new_generator->buffer, buffer_size);
+  }
+  return new_generator;
+}
+
+//
+
+void
+payload_generator_destroy(
+  payload_generator_ref generator
+)
+{
+  free((void*)generator);
+}
+
+//
+
+uint64_t
+payload_generator_get_seed(
+  payload_generator_ref generator
+)
+{
+  return generator->seed;
+}
+
+//
+
+double
+payload_generator_get_compressibility(
+  payload_generator_ref generator
+)
+{
+  return generator->compressibility;
+}
+
+//
+
+uint64_t
+payload_generator_offset_for_key(
+  payload_generator_ref generator,
+  const char            *key
+)
+{
+  uint64_t              h = 0xCBF29CE484222325ULL;
+  prng_state            prng;
+
+  // FNV-1a, then mixed with the seed:
+  while ( *key ) {
+    h ^= (uint8_t)*key++;
+    h *= 0x100000001B3ULL;
+  }
+  prng_seed(&prng, generator->seed, h);
+  return prng_next(&prng) % generator->buffer_size;
+}
+
+//
+
+const void*
+payload_generator_bytes(
+  payload_generator_ref generator,
+  uint64_t              key_offset,
+  uint64_t              position,
+  size_t                *length
+)
+{
+  size_t                start = (key_offset + position) % generator->buffer_size;
+
+  if ( *length > generator->buffer_size ) *length = generator->buffer_size;
+  return generator->buffer + start;
+}
+
+//
+
+void
+payload_generator_fill(
+  payload_generator_ref generator,
+  uint64_t              key_offset,
+  uint64_t              position,
+  void                  *dst,
+  size_t                length
+)
+{
+  uint8_t               *cursor = (uint8_t*)dst;
+  
+  while ( length ) {
+    size_t              n = length;
+    const void          *src = payload_generator_bytes(generator, key_offset, position, &n);
+
+    memcpy(cursor, src, n);
+    cursor += n;
+    position += n;
+    length -= n;
+  }
+}
+
+//
+
+bool
+payload_generator_verify(
+  payload_generator_ref generator,
+  uint64_t              key_offset,
+  uint64_t              position,
+  const void            *src,
+  size_t                length
+)
+{
+  const uint8_t         *cursor = (const uint8_t*)src;
+  
+  while ( length ) {
+    size_t              n = length;
+    const void          *expected = payload_generator_bytes(generator, key_offset, position, &n);
+
+    if ( memcmp(cursor, expected, n) != 0 ) return false;
+    cursor += n;
+    position += n;
+    length -= n;
+  }
+  return true;
+}
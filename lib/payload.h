@@ -0,0 +1,41 @@
+//
+// payload.h
+//
+// Deterministic synthetic request bodies.  A single buffer of pseudo-random
+// bytes is computed once and shared; the body for a given key (e.g. a URL)
+// is that buffer read circularly starting at an offset derived from the key,
+// so any byte of any body can be produced (or checked) without generating
+// the bytes before it.
+//
+
+#ifndef __PAYLOAD_H__
+#define __PAYLOAD_H__
+
+#include "config.h"
+
+typedef struct _payload_generator * payload_generator_ref;
+
+//
+// The body repeats every buffer_size bytes (0 selects the default, 8 MiB).  A
+// compressibility of 0.0 yields incompressible data; larger values (up to 1.0)
+// replace that fraction of the bytes with runs of zeroes.
+//
+payload_generator_ref payload_generator_create(uint64_t seed, size_t buffer_size, double compressibility);
+void payload_generator_destroy(payload_generator_ref generator);
+
+uint64_t payload_generator_get_seed(payload_generator_ref generator);
+double payload_generator_get_compressibility(payload_generator_ref generator);
+
+uint64_t payload_generator_offset_for_key(payload_generator_ref generator, const char *key);
+
+//
+// Returns a pointer to (at most *length) contiguous bytes of the body that
+// begins at key_offset, starting at position; *length is reduced if fewer
+// contiguous bytes are available.  No copy is made.
+//
+const void* payload_generator_bytes(payload_generator_ref generator, uint64_t key_offset, uint64_t position, size_t *length);
+
+void payload_generator_fill(payload_generator_ref generator, uint64_t key_offset, uint64_t position, void *dst, size_t length);
+bool payload_generator_verify(payload_generator_ref generator, uint64_t key_offset, uint64_t position, const void *src, size_t length);
+
+#endif /* __PAYLOAD_H__ */
@@ -0,0 +1,326 @@
+//
+// url_list.c
+//
+
+#include "url_list.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+
+typedef struct {
+  size_t        offset;
+  size_t        length;
+} url_list_slice;
+
+//
+
+typedef struct _url_list {
+  const char      *text;
+  size_t          text_len;
+  bool            is_mapped;
+  unsigned int    count, capacity;
+  url_list_slice  *slices;
+} url_list;
+
+//
+
+#define URL_LIST_INITIAL_CAPACITY   1024
+
+//
+
+bool
+__url_list_index(
+  url_list    *the_list
+)
+{
+  const char  *p = the_list->text;
+  const char  *e = p + the_list->text_len;
+
+  while ( p < e ) {
+    const char  *eol = memchr(p, '\n', e - p);
+    size_t      line_len;
+
+    if ( ! eol ) eol = e;
+    line_len = eol - p;
+
+    //
+    // Drop any trailing whitespace; lines that are left empty are not
+    // included in the index:
+    //
+    while ( line_len && isspace(p[line_len - 1]) ) line_len--;
+    if ( line_len ) {
+      if ( the_list->count == the_list->capacity ) {
+        unsigned int    new_capacity = the_list->capacity ? 2 * the_list->capacity : URL_LIST_INITIAL_CAPACITY;
+        url_list_slice  *new_slices = realloc(the_list->slices, new_capacity * sizeof(url_list_slice));
+
+        if ( ! new_slices ) return false;
+        the_list->slices = new_slices;
+        the_list->capacity = new_capacity;
+      }
+      the_list->slices[the_list->count].offset = p - the_list->text;
+      the_list->slices[the_list->count].length = line_len;
+      the_list->count++;
+    }
+    p = eol + 1;
+  }
+  return true;
+}
+
+//
+
+url_list_ref
+url_list_create_with_stream(
+  FILE      *stream
+)
+{
+  url_list  *new_list = malloc(sizeof(url_list));
+
+  if ( new_list ) {
+    char    *text = NULL;
+    size_t  text_len = 0, text_capacity = 0, n_read;
+
+    memset(new_list, 0, sizeof(url_list));
+
+    //
+    // Streams can't be mapped, so slurp the whole thing into memory:
+    //
+    do {
+      if ( text_len == text_capacity ) {
+        size_t    new_capacity = text_capacity ? 2 * text_capacity : 65536;
+        char      *new_text = realloc(text, new_capacity);
+
+        if ( ! new_text ) {
+          if ( text ) free((void*)text);
+          free((void*)new_list);
+          return NULL;
+        }
+        text = new_text;
+        text_capacity = new_capacity;
+      }
+      n_read = fread(text + text_len, 1, text_capacity - text_len, stream);
+      text_len += n_read;
+    } while ( n_read > 0 );
+
+    if ( ferror(stream) ) {
+      free((void*)text);
+      free((void*)new_list);
+      return NULL;
+    }
+    new_list->text = text;
+    new_list->text_len = text_len;
+    if ( ! __url_list_index(new_list) ) {
+      url_list_destroy(new_list);
+      return NULL;
+    }
+  }
+  return new_list;
+}
+
+//
+
+url_list_ref
+url_list_create_with_text(
+  const char  *text,
+  size_t      length
+)
+{
+  url_list    *new_list = malloc(sizeof(url_list));
+
+  if ( new_list ) {
+    char      *copy = malloc(length ? length : 1);
+
+    memset(new_list, 0, sizeof(url_list));
+    if ( ! copy ) {
+      free((void*)new_list);
+      return NULL;
+    }
+    memcpy(copy, text, length);
+    new_list->text = copy;
+    new_list->text_len = length;
+    if ( ! __url_list_index(new_list) ) {
+      url_list_destroy(new_list);
+      return NULL;
+    }
+  }
+  return new_list;
+}
+
+//
+
+url_list_ref
+url_list_create_with_path(
+  const char  *path
+)
+{
+  url_list      *new_list = NULL;
+  int           fd;
+  struct stat   finfo;
+
+  if ( ! path || ((*path == '-') && (*(path + 1) == '\0')) ) return url_list_create_with_stream(stdin);
+
+  if ( (fd = open(path, O_RDONLY)) < 0 ) return NULL;
+  if ( fstat(fd, &finfo) != 0 ) {
+    close(fd);
+    return NULL;
+  }
+
+  //
+  // Pipes, devices, and empty files can't be mapped, read them instead:
+  //
+  if ( ! S_ISREG(finfo.st_mode) || (finfo.st_size == 0) ) {
+    FILE        *stream = fdopen(fd, "r");
+
+    if ( ! stream ) {
+      close(fd);
+      return NULL;
+    }
+    new_list = url_list_create_with_stream(stream);
+    fclose(stream);
+    return new_list;
+  }
+
+  if ( (new_list = malloc(sizeof(url_list))) ) {
+    void        *text;
+
+    memset(new_list, 0, sizeof(url_list));
+    text = mmap(NULL, finfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( text == MAP_FAILED ) {
+      free((void*)new_list);
+      new_list = NULL;
+    } else {
+#ifdef MADV_SEQUENTIAL
+      madvise(text, finfo.st_size, MADV_SEQUENTIAL);
+#endif
+      new_list->text = (const char*)text;
+      new_list->text_len = finfo.st_size;
+      new_list->is_mapped = true;
+      if ( ! __url_list_index(new_list) ) {
+        url_list_destroy(new_list);
+        new_list = NULL;
+      }
+    }
+  }
+  close(fd);
+  return new_list;
+}
+
+//
+
+void
+url_list_destroy(
+  url_list_ref  the_list
+)
+{
+  if ( the_list->text ) {
+    if ( the_list->is_mapped ) {
+      munmap((void*)the_list->text, the_list->text_len);
+    } else {
+      free((void*)the_list->text);
+    }
+  }
+  if ( the_list->slices ) free((void*)the_list->slices);
+  free((void*)the_list);
+}
+
+//
+
+unsigned int
+url_list_get_count(
+  url_list_ref  the_list
+)
+{
+  return the_list->count;
+}
+
+//
+
+void
+url_list_shuffle(
+  url_list_ref  the_list,
+  prng_state    *prng
+)
+{
+  unsigned int  i = the_list->count;
+  
+  while ( i > 1 ) {
+    unsigned int    j = prng_next_below(prng, i--);
+    url_list_slice  tmp = the_list->slices[i];
+    
+    the_list->slices[i] = the_list->slices[j];
+    the_list->slices[j] = tmp;
+  }
+}
+
+//
+
+const char*
+url_list_get_url(
+  url_list_ref  the_list,
+  unsigned int  index,
+  size_t        *length
+)
+{
+  if ( index >= the_list->count ) return NULL;
+  if ( length ) *length = the_list->slices[index].length;
+  return the_list->text + the_list->slices[index].offset;
+}
+
+//
+
+bool
+url_list_copy_url(
+  url_list_ref  the_list,
+  unsigned int  index,
+  const char    *base_url,
+  size_t        base_url_len,
+  char*         *buffer,
+  size_t        *capacity
+)
+{
+  size_t        url_len;
+  const char    *url = url_list_get_url(the_list, index, &url_len);
+  size_t        need_slash = 0, target_url_len;
+  char          *target_url_ptr;
+
+  if ( ! url ) return false;
+
+  //
+  // If there's a base url provided, url gets appended to that:
+  //
+  if ( base_url ) {
+    if ( base_url_len && (base_url[base_url_len - 1] == '/') ) {
+      //
+      // Remove leading slashes from url:
+      //
+      while ( url_len && (*url == '/') ) url++, url_len--;
+    } else {
+      //
+      // Do we need to prepend a slash?
+      //
+      if ( url_len && (*url != '/') ) need_slash = 1;
+    }
+  } else {
+    base_url_len = 0;
+  }
+
+  target_url_len = base_url_len + need_slash + url_len + 1;
+  if ( target_url_len > *capacity ) {
+    char        *new_buffer = realloc(*buffer, target_url_len);
+
+    if ( ! new_buffer ) return false;
+    *buffer = new_buffer;
+    *capacity = target_url_len;
+  }
+  target_url_ptr = *buffer;
+  if ( base_url_len ) {
+    memcpy(target_url_ptr, base_url, base_url_len);
+    target_url_ptr += base_url_len;
+  }
+  if ( need_slash ) *target_url_ptr++ = '/';
+  memcpy(target_url_ptr, url, url_len);
+  target_url_ptr[url_len] = '\0';
+  return true;
+}
@@ -0,0 +1,44 @@
+//
+// url_list.h
+//
+// A list of URLs (one per line) loaded and indexed once.  Regular files
+// are memory-mapped and each URL is a slice of the mapped text, so no
+// per-line copies are ever made.
+//
+
+#ifndef __URL_LIST_H__
+#define __URL_LIST_H__
+
+#include "config.h"
+#include "util_fns.h"
+
+typedef struct _url_list * url_list_ref;
+
+url_list_ref url_list_create_with_path(const char *path);
+url_list_ref url_list_create_with_stream(FILE *stream);
+url_list_ref url_list_create_with_text(const char *text, size_t length);
+void url_list_destroy(url_list_ref the_list);
+
+unsigned int url_list_get_count(url_list_ref the_list);
+
+//
+// Reorder the list in-place with a Fisher-Yates shuffle driven by prng; the
+// same PRNG state always produces the same order:
+//
+void url_list_shuffle(url_list_ref the_list, prng_state *prng);
+
+//
+// Returns a pointer to the start of the URL at index; it is NOT nul-terminated,
+// its length (trailing whitespace excluded) is returned in *length:
+//
+const char* url_list_get_url(url_list_ref the_list, unsigned int index, size_t *length);
+
+//
+// Copy the URL at index into *buffer as a nul-terminated string, joined to
+// base_url if one is provided.  The buffer is grown as necessary (and *capacity
+// updated) so a caller that reuses the same buffer stops allocating once it's
+// big enough for the longest URL.
+//
+bool url_list_copy_url(url_list_ref the_list, unsigned int index, const char *base_url, size_t base_url_len, char* *buffer, size_t *capacity);
+
+#endif /* __URL_LIST_H__ */
@@ -3,6 +3,7 @@
 //
 
 #include <stdarg.h>
+#include <time.h>
 
 #include "util_fns.h"
 
@@ -197,6 +198,129 @@ random_long_int_in_range(
 }
 
 //
+
+double
+monotonic_seconds(void)
+{
+  struct timespec   now;
+  
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+}
+
+//
+static inline uint64_t
+__prng_splitmix64(
+  uint64_t    *x
+)
+{
+  uint64_t    z = (*x += 0x9E3779B97F4A7C15ULL);
+  
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+//
+
+static inline uint64_t
+__prng_rotl(
+  uint64_t    x,
+  int         k
+)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+//
+
+void
+prng_seed(
+  prng_state  *state,
+  uint64_t    seed,
+  uint64_t    stream
+)
+{
+  uint64_t    x = stream;
+  int         i;
+  
+  //
+  // Hash the stream number first so that nearby (seed, stream) pairs don't
+  // yield overlapping splitmix sequences:
+  //
+  x = seed ^ __prng_splitmix64(&x);
+  for ( i = 0; i < 4; i++ ) state->s[i] = __prng_splitmix64(&x);
+}
+
+//
+
+uint64_t
+prng_next(
+  prng_state  *state
+)
+{
+  uint64_t    *s = state->s;
+  uint64_t    result = __prng_rotl(s[1] * 5, 7) * 9;
+  uint64_t    t = s[1] << 17;
+  
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = __prng_rotl(s[3], 45);
+  return result;
+}
+
+//
+
+uint64_t
+prng_next_below(
+  prng_state  *state,
+  uint64_t    n
+)
+{
+  uint64_t    threshold, r;
+  
+  if ( n <= 1 ) return 0;
+  
+  //
+  // Reject the low values that would bias the modulus:
+  //
+  threshold = (0 - n) % n;
+  do {
+    r = prng_next(state);
+  } while ( r < threshold );
+  return r % n;
+}
+
+//
+
+char*
+split_host_port(
+  const char    *address,
+  const char*   *port
+)
+{
+  const char    *colon = strrchr(address, ':');
+  char          *host = NULL;
+
+  *port = address;
+  if ( colon ) {
+    host = strndup(address, colon - address);
+    *port = colon + 1;
+
+    // IPv6 literals are bracketed:
+    if ( host && (*host == '[') && (host[strlen(host) - 1] == ']') ) {
+      memmove(host, host + 1, strlen(host));
+      host[strlen(host) - 1] = '\0';
+    }
+  }
+  return host;
+}
+
+//
+
 #ifdef UTIL_FNS_TEST
 
 #include <stdio.h>
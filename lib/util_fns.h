@@ -18,4 +18,118 @@ void init_random_long();
 long int random_long_int();
 long int random_long_int_in_range(long int low, long int high);
 
+//
+// A small, fast, reproducible PRNG (xoshiro256**) for when the same seed must
+// always produce the same sequence; each (seed, stream) pair yields an
+// independent sequence.
+//
+typedef struct {
+  uint64_t    s[4];
+} prng_state;
+
+void prng_seed(prng_state *state, uint64_t seed, uint64_t stream);
+uint64_t prng_next(prng_state *state);
+uint64_t prng_next_below(prng_state *state, uint64_t n);
+
+double monotonic_seconds(void);
+
+//
+// Split a <host>:<port> address (an IPv6 host in brackets, which are
+// removed); *port is pointed into address and the host, NULL if there is no
+// colon at all, is returned in a buffer the caller must free():
+//
+char* split_host_port(const char *address, const char* *port);
+
+//
+// Little-endian encoding for binary formats that move between hosts; each
+// put returns the position just past what it wrote, each get advances *p:
+//
+static inline uint8_t*
+le_put_u32(
+  uint8_t     *p,
+  uint32_t    value
+)
+{
+  p[0] = value, p[1] = value >> 8, p[2] = value >> 16, p[3] = value >> 24;
+  return p + 4;
+}
+
+static inline uint8_t*
+le_put_u64(
+  uint8_t     *p,
+  uint64_t    value
+)
+{
+  return le_put_u32(le_put_u32(p, (uint32_t)value), (uint32_t)(value >> 32));
+}
+
+static inline uint8_t*
+le_put_double(
+  uint8_t     *p,
+  double      value
+)
+{
+  uint64_t    bits;
+  
+  memcpy(&bits, &value, sizeof(bits));
+  return le_put_u64(p, bits);
+}
+
+static inline uint8_t*
+le_put_float(
+  uint8_t     *p,
+  float       value
+)
+{
+  uint32_t    bits;
+  
+  memcpy(&bits, &value, sizeof(bits));
+  return le_put_u32(p, bits);
+}
+
+static inline uint32_t
+le_get_u32(
+  const uint8_t **p
+)
+{
+  const uint8_t *q = *p;
+  
+  *p += 4;
+  return (uint32_t)q[0] | ((uint32_t)q[1] << 8) | ((uint32_t)q[2] << 16) | ((uint32_t)q[3] << 24);
+}
+
+static inline uint64_t
+le_get_u64(
+  const uint8_t **p
+)
+{
+  uint64_t      lo = le_get_u32(p);
+  
+  return lo | ((uint64_t)le_get_u32(p) << 32);
+}
+
+static inline double
+le_get_double(
+  const uint8_t **p
+)
+{
+  uint64_t      bits = le_get_u64(p);
+  double        value;
+  
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static inline float
+le_get_float(
+  const uint8_t **p
+)
+{
+  uint32_t      bits = le_get_u32(p);
+  float         value;
+  
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
 #endif /* __UTIL_FNS_H__ */
@@ -0,0 +1,820 @@
+//
+//  urltest_bench.c
+//
+//  Microbenchmarks for the library routines on the clients' request path,
+//  so a client-side slowdown shows up here rather than as a skewed load
+//  test.
+//
+//
+
+#include "config.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "util_fns.h"
+#include "fs_entity.h"
+#include "http_stats.h"
+
+//
+
+static const struct option urltest_bench_options[] = {
+    { "help",             no_argument,          NULL,       'h' },
+    //
+    { "format",           required_argument,    NULL,       'f' },
+    { "nodes",            required_argument,    NULL,       'n' },
+    { "fanout",           required_argument,    NULL,       'F' },
+    { "min-time",         required_argument,    NULL,       't' },
+    { "filter",           required_argument,    NULL,       'b' },
+    { "seed",             required_argument,    NULL,       'S' },
+    { NULL,               0,                    NULL,        0  }
+  };
+
+static const char *urltest_bench_optstring = "h" "f:n:F:t:b:S:";
+
+//
+
+void
+usage(
+  char      *exe
+)
+{
+  printf(
+      "version %s\n"
+      "built " __DATE__ " " __TIME__ "\n"
+      "usage:\n\n"
+      "  %s {options}\n\n"
+      " options:\n\n"
+      "  --help/-h                    show this information\n"
+      "\n"
+      "  --format/-f <format>         how to display the results (default: csv)\n"
+      "\n"
+      "                                 <format> = table | csv | tsv\n"
+      "\n"
+      "  --nodes/-n <#>{,<#>..}       sizes of the synthetic trees used by the fs_entity\n"
+      "                               benchmarks (default: 1000,10000,100000,1000000)\n"
+      "  --fanout/-F <#>              children per directory in the synthetic trees\n"
+      "                               (default: 16)\n"
+      "  --min-time/-t <seconds>      run each benchmark for at least this long\n"
+      "                               (default: 0.5)\n"
+      "  --filter/-b <string>         run only the benchmarks whose names contain <string>\n"
+      "  --seed/-S <#>                seed for the random walk (default: 1)\n"
+      "\n"
+      " Each benchmark reports the number of operations it timed, nanoseconds per\n"
+      " operation and heap allocations per operation (n/a if allocations cannot\n"
+      " be counted on this platform).  Before a tree walk is timed, one generation of\n"
+      " it is checked to select every node once per request state; the program\n"
+      " stops with an error if it does not.\n"
+      "\n"
+      ,
+      urltest_version_string,
+      exe
+    );
+}
+
+//
+// Allocations are counted by standing in for the C library's allocator (not
+// possible under AddressSanitizer, which has its own):
+//
+
+static unsigned long long bench_alloc_count = 0;
+
+#if defined(HAVE___LIBC_MALLOC) && ! defined(__SANITIZE_ADDRESS__)
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+
+void*
+malloc(
+  size_t    size
+)
+{
+  __atomic_add_fetch(&bench_alloc_count, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void*
+calloc(
+  size_t    nmemb,
+  size_t    size
+)
+{
+  __atomic_add_fetch(&bench_alloc_count, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(nmemb, size);
+}
+
+void*
+realloc(
+  void      *ptr,
+  size_t    size
+)
+{
+  __atomic_add_fetch(&bench_alloc_count, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(ptr, size);
+}
+
+#define BENCH_CAN_COUNT_ALLOCS  true
+
+#else
+
+#define BENCH_CAN_COUNT_ALLOCS  false
+
+#endif /* HAVE___LIBC_MALLOC && ! __SANITIZE_ADDRESS__ */
+
+//
+// The timer can be paused around per-batch setup (e.g. rebuilding a tree) so
+// only the operations themselves are measured:
+//
+
+typedef struct {
+  double                started_at, elapsed;
+  unsigned long long    allocs_at, allocs;
+  bool                  is_running;
+} bench_timer;
+
+static bench_timer bench_the_timer;
+
+void
+bench_timer_start(void)
+{
+  if ( ! bench_the_timer.is_running ) {
+    bench_the_timer.is_running = true;
+    bench_the_timer.allocs_at = __atomic_load_n(&bench_alloc_count, __ATOMIC_RELAXED);
+    bench_the_timer.started_at = monotonic_seconds();
+  }
+}
+
+void
+bench_timer_stop(void)
+{
+  if ( bench_the_timer.is_running ) {
+    bench_the_timer.elapsed += monotonic_seconds() - bench_the_timer.started_at;
+    bench_the_timer.allocs += __atomic_load_n(&bench_alloc_count, __ATOMIC_RELAXED) - bench_the_timer.allocs_at;
+    bench_the_timer.is_running = false;
+  }
+}
+
+//
+// A benchmark function performs (about) n_ops operations and returns how many
+// it actually did:
+//
+
+typedef unsigned long long (*bench_fn)(void *context, unsigned long long n_ops);
+
+typedef enum {
+  bench_format_csv = 0,
+  bench_format_tsv,
+  bench_format_table
+} bench_format;
+
+typedef struct {
+  bench_format          format;
+  double                min_time;
+  const char            *filter;
+  bool                  has_printed_header;
+} bench_config;
+
+//
+
+void
+bench_print_result(
+  bench_config          *config,
+  const char            *name,
+  unsigned int          nodes,
+  unsigned long long    ops,
+  double                seconds,
+  unsigned long long    allocs
+)
+{
+  double                ns_per_op = ops ? (1e9 * seconds / ops) : 0.0;
+  double                allocs_per_op = ops ? ((double)allocs / ops) : 0.0;
+
+  switch ( config->format ) {
+
+    case bench_format_csv:
+    case bench_format_tsv: {
+      const char        *sep = (config->format == bench_format_csv) ? "," : "\t";
+
+      if ( ! config->has_printed_header ) printf("benchmark%snodes%sops%sns_per_op%sallocs_per_op\n", sep, sep, sep, sep);
+      printf("%s%s%u%s%llu%s%.2f%s", name, sep, nodes, sep, ops, sep, ns_per_op, sep);
+      if ( BENCH_CAN_COUNT_ALLOCS ) printf("%.3f\n", allocs_per_op); else printf("n/a\n");
+      break;
+    }
+
+    case bench_format_table: {
+      if ( ! config->has_printed_header ) {
+        printf("%-40s %8s %12s %12s %12s\n", "benchmark", "nodes", "ops", "ns/op", "allocs/op");
+        printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ~~~~~~~~ ~~~~~~~~~~~~ ~~~~~~~~~~~~ ~~~~~~~~~~~~\n");
+      }
+      printf("%-40s %8u %12llu %12.2f ", name, nodes, ops, ns_per_op);
+      if ( BENCH_CAN_COUNT_ALLOCS ) printf("%12.3f\n", allocs_per_op); else printf("%12s\n", "n/a");
+      break;
+    }
+
+  }
+  config->has_printed_header = true;
+  fflush(stdout);
+}
+
+//
+// Run a benchmark with growing batch sizes until a batch takes at least the
+// minimum time, then report that batch:
+//
+
+void
+bench_run(
+  bench_config          *config,
+  const char            *name,
+  unsigned int          nodes,
+  bench_fn              fn,
+  void                  *context
+)
+{
+  unsigned long long    n_ops = 1, ops;
+
+  if ( config->filter && ! strstr(name, config->filter) ) return;
+
+  while ( true ) {
+    memset(&bench_the_timer, 0, sizeof(bench_the_timer));
+    bench_timer_start();
+    ops = fn(context, n_ops);
+    bench_timer_stop();
+    if ( (bench_the_timer.elapsed >= config->min_time) || (n_ops >= (1ULL << 40)) ) break;
+
+    //
+    // Aim 20% past the minimum, growing by at most 100x per round:
+    //
+    if ( bench_the_timer.elapsed <= 0.0 || ! ops ) {
+      n_ops *= 100;
+    } else {
+      double            target = 1.2 * config->min_time * ops / bench_the_timer.elapsed;
+
+      n_ops = (target > 100.0 * n_ops) ? (100 * n_ops) : (unsigned long long)target + 1;
+    }
+  }
+  bench_print_result(config, name, nodes, ops, bench_the_timer.elapsed, bench_the_timer.allocs);
+}
+
+//
+// http_stats_update_and_copy() reads its figures from a cURL handle, so the
+// handle needs a real exchange behind it; a throwaway listener on the
+// loopback interface answers one request:
+//
+
+typedef struct {
+  int                   listen_fd;
+} bench_responder;
+
+void*
+bench_responder_run(
+  void                  *context
+)
+{
+  bench_responder       *responder = (bench_responder*)context;
+  static const char     *response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: close\r\n\r\nbench";
+  char                  buffer[4096];
+  size_t                have = 0;
+  int                   fd = accept(responder->listen_fd, NULL, NULL);
+
+  if ( fd >= 0 ) {
+    while ( have < sizeof(buffer) - 1 ) {
+      ssize_t           n = read(fd, buffer + have, sizeof(buffer) - 1 - have);
+
+      if ( n <= 0 ) break;
+      have += n;
+      buffer[have] = '\0';
+      if ( strstr(buffer, "\r\n\r\n") ) break;
+    }
+    if ( write(fd, response, strlen(response)) < 0 ) fprintf(stderr, "WARNING:  unable to answer benchmark request\n");
+    close(fd);
+  }
+  return NULL;
+}
+
+//
+
+size_t
+bench_discard_body(
+  char                  *ptr,
+  size_t                size,
+  size_t                nmemb,
+  void                  *userdata
+)
+{
+  (void)ptr, (void)userdata;
+  return size * nmemb;
+}
+
+//
+
+CURL*
+bench_curl_handle_create(void)
+{
+  bench_responder       responder;
+  struct sockaddr_in    addr;
+  socklen_t             addr_len = sizeof(addr);
+  pthread_t             thread;
+  CURL                  *curl_request = NULL;
+  char                  url[64];
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ( (responder.listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ) return NULL;
+  if ( (bind(responder.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(responder.listen_fd, 1) != 0) ||
+       (getsockname(responder.listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) ) {
+    close(responder.listen_fd);
+    return NULL;
+  }
+  if ( pthread_create(&thread, NULL, bench_responder_run, &responder) != 0 ) {
+    close(responder.listen_fd);
+    return NULL;
+  }
+  snprintf(url, sizeof(url), "http://127.0.0.1:%hu/", ntohs(addr.sin_port));
+  if ( (curl_request = curl_easy_init()) ) {
+    curl_easy_setopt(curl_request, CURLOPT_URL, url);
+    curl_easy_setopt(curl_request, CURLOPT_WRITEFUNCTION, bench_discard_body);
+    if ( curl_easy_perform(curl_request) != CURLE_OK ) {
+      curl_easy_cleanup(curl_request);
+      curl_request = NULL;
+    }
+  }
+  if ( ! curl_request ) {
+    // Let the responder go if the request never arrived:
+    shutdown(responder.listen_fd, SHUT_RDWR);
+  }
+  pthread_join(thread, NULL);
+  close(responder.listen_fd);
+  return curl_request;
+}
+
+//
+
+typedef struct {
+  http_stats_ref        stats;
+  CURL                  *curl_request;
+} bench_stats_context;
+
+unsigned long long
+bench_http_stats_update_and_copy(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  bench_stats_context   *ctx = (bench_stats_context*)context;
+  http_stats_record     copy;
+  unsigned long long    i;
+
+  for ( i = 0; i < n_ops; i++ ) http_stats_update_and_copy(ctx->stats, ctx->curl_request, &copy);
+  return n_ops;
+}
+
+//
+
+unsigned long long
+bench_strmcat(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  unsigned long long    i;
+
+  (void)context;
+  for ( i = 0; i < n_ops; i++ ) {
+    char                *s = strmcat("https://webdav.www.server.org/upload_dir", "/", "lmdb/lib/lmlog.c", NULL);
+
+    if ( s ) free((void*)s);
+  }
+  return n_ops;
+}
+
+//
+// The fs_entity benchmarks each work on a synthetic tree:
+//
+
+typedef struct {
+  unsigned int          nodes, fanout;
+  fs_entity_list        *fslist;
+  unsigned int          *sequence;
+  unsigned long long    sequence_len, cursor;
+  volatile size_t       sink;
+} bench_tree_context;
+
+//
+
+fs_entity_list*
+bench_tree_create(
+  bench_tree_context    *ctx
+)
+{
+  fs_entity_list        *fslist = fs_entity_list_create_synthetic(ctx->nodes, ctx->fanout);
+
+  if ( ! fslist ) {
+    fprintf(stderr, "ERROR:  unable to build a synthetic tree of %u nodes\n", ctx->nodes);
+    exit(ENOMEM);
+  }
+  return fslist;
+}
+
+//
+
+unsigned long long
+bench_url_for_entity(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  bench_tree_context    *ctx = (bench_tree_context*)context;
+  fs_entity             *root = ctx->fslist->root_entity;
+  unsigned int          count = ctx->fslist->count, i_e = 0;
+  unsigned long long    i;
+  size_t                sink = 0;
+
+  for ( i = 0; i < n_ops; i++ ) {
+    sink += (size_t)fs_entity_list_url_for_entity(ctx->fslist, &root[i_e]);
+    if ( ++i_e == count ) i_e = 0;
+  }
+  ctx->sink = sink;
+  return n_ops;
+}
+
+//
+// The walks run without a generation limit (the tree starts over each time
+// it's done) and advance every node they select, the way urltest_webdav does,
+// so those figures include fs_entity_list_advance_entity_state():
+//
+
+#define BENCH_NO_GENERATION_LIMIT   ((unsigned int)-2)
+
+unsigned long long
+bench_next_node(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  bench_tree_context    *ctx = (bench_tree_context*)context;
+  unsigned long long    i;
+
+  for ( i = 0; i < n_ops; i++ ) {
+    fs_entity           *e = fs_entity_list_next_node(ctx->fslist, BENCH_NO_GENERATION_LIMIT);
+
+    if ( ! e ) break;
+    fs_entity_list_advance_entity_state(ctx->fslist, e);
+  }
+  return i;
+}
+
+//
+
+unsigned long long
+bench_random_node(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  bench_tree_context    *ctx = (bench_tree_context*)context;
+  unsigned long long    i;
+
+  for ( i = 0; i < n_ops; i++ ) {
+    fs_entity           *e = fs_entity_list_random_node(ctx->fslist, BENCH_NO_GENERATION_LIMIT);
+
+    if ( ! e ) break;
+    fs_entity_list_advance_entity_state(ctx->fslist, e);
+  }
+  return i;
+}
+
+//
+// Before a walk is timed, one generation of it is checked the way
+// urltest_webdav uses it:  with a generation limit of one every node must be
+// selected once per enabled request state (a directory's *_sub states are
+// passed through, never selected) and the whole tree must end up at
+// generation 1:
+//
+
+typedef fs_entity* (*bench_walk_fn)(fs_entity_list *the_list, unsigned int max_generation);
+
+unsigned long long
+bench_selections_per_generation(
+  fs_entity_list        *fslist
+)
+{
+  static const fs_entity_state  states[] = {
+                                    fs_entity_state_upload, fs_entity_state_options, fs_entity_state_getinfo,
+                                    fs_entity_state_download, fs_entity_state_download_range, fs_entity_state_delete
+                                  };
+  unsigned long long    n = 0;
+  unsigned int          i_e, i_s;
+
+  for ( i_e = 0; i_e < fslist->count; i_e++ ) {
+    fs_entity           *e = &fslist->root_entity[i_e];
+
+    for ( i_s = 0; i_s < sizeof(states) / sizeof(states[0]); i_s++ ) {
+      // Only files have a ranged download:
+      if ( (states[i_s] == fs_entity_state_download_range) && (e->kind != fs_entity_kind_file) ) continue;
+      if ( fs_entity_get_state_is_enabled(e, states[i_s]) && ! ((1 << states[i_s]) & fslist->disabled_states) ) n++;
+    }
+  }
+  return n;
+}
+
+//
+
+void
+bench_check_walk(
+  bench_tree_context    *ctx,
+  const char            *name,
+  bench_walk_fn         walk
+)
+{
+  fs_entity_list        *fslist = bench_tree_create(ctx);
+  unsigned long long    expected = bench_selections_per_generation(fslist), n_ops = 0;
+  unsigned int          i_e, n_behind = 0;
+  fs_entity             *e;
+
+  while ( (n_ops <= expected) && (e = walk(fslist, 1)) ) {
+    fs_entity_list_advance_entity_state(fslist, e);
+    n_ops++;
+  }
+  for ( i_e = 0; i_e < fslist->count; i_e++ ) if ( fslist->root_entity[i_e].generation != 1 ) n_behind++;
+  fs_entity_list_destroy(fslist);
+  if ( (n_ops != expected) || n_behind ) {
+    fprintf(stderr, "ERROR:  one generation of %s over %u nodes made %llu selections (expected %llu) and left %u node%s short of it\n",
+        name, ctx->nodes, n_ops, expected, n_behind, (n_behind == 1) ? "" : "s"
+      );
+    exit(EINVAL);
+  }
+}
+
+//
+// To time state advancement on its own, the order a sequential walk selects
+// nodes in is recorded once and then replayed against fresh copies of the
+// tree:
+//
+
+unsigned long long
+bench_advance_entity_state(
+  void                  *context,
+  unsigned long long    n_ops
+)
+{
+  bench_tree_context    *ctx = (bench_tree_context*)context;
+  unsigned long long    i;
+
+  for ( i = 0; i < n_ops; i++ ) {
+    if ( ctx->cursor == ctx->sequence_len ) {
+      bench_timer_stop();
+      fs_entity_list_destroy(ctx->fslist);
+      ctx->fslist = bench_tree_create(ctx);
+      ctx->cursor = 0;
+      bench_timer_start();
+    }
+    fs_entity_list_advance_entity_state(ctx->fslist, &ctx->fslist->root_entity[ctx->sequence[ctx->cursor++]]);
+  }
+  return n_ops;
+}
+
+//
+
+bool
+bench_record_sequence(
+  bench_tree_context    *ctx
+)
+{
+  fs_entity_list        *fslist = bench_tree_create(ctx);
+  unsigned long long    capacity = 8 * (unsigned long long)ctx->nodes;
+  fs_entity             *e;
+
+  //
+  // Entities are recorded by index so the replay can find them in another
+  // copy of the tree:
+  //
+  ctx->sequence_len = 0;
+  if ( ! (ctx->sequence = malloc(capacity * sizeof(unsigned int))) ) {
+    fs_entity_list_destroy(fslist);
+    return false;
+  }
+  while ( (ctx->sequence_len < capacity) && (e = fs_entity_list_next_node(fslist, BENCH_NO_GENERATION_LIMIT)) ) {
+    ctx->sequence[ctx->sequence_len++] = e - fslist->root_entity;
+    fs_entity_list_advance_entity_state(fslist, e);
+  }
+  fs_entity_list_destroy(fslist);
+  return (ctx->sequence_len > 0);
+}
+
+//
+
+void
+bench_tree_suite(
+  bench_config          *config,
+  unsigned int          nodes,
+  unsigned int          fanout,
+  unsigned long long    seed
+)
+{
+  bench_tree_context    ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.nodes = nodes;
+  ctx.fanout = fanout;
+
+  if ( ! config->filter || strstr("fs_entity_list_url_for_entity", config->filter) ) {
+    ctx.fslist = bench_tree_create(&ctx);
+    if ( ! fs_entity_list_set_base_url(ctx.fslist, "https://webdav.www.server.org/upload_dir") ) {
+      fprintf(stderr, "ERROR:  unable to build URLs for %u nodes\n", nodes);
+      exit(ENOMEM);
+    }
+    bench_run(config, "fs_entity_list_url_for_entity", nodes, bench_url_for_entity, &ctx);
+    fs_entity_list_destroy(ctx.fslist);
+  }
+
+  if ( ! config->filter || strstr("fs_entity_list_next_node", config->filter) ) {
+    bench_check_walk(&ctx, "fs_entity_list_next_node", fs_entity_list_next_node);
+    ctx.fslist = bench_tree_create(&ctx);
+    bench_run(config, "fs_entity_list_next_node", nodes, bench_next_node, &ctx);
+    fs_entity_list_destroy(ctx.fslist);
+  }
+
+  if ( ! config->filter || strstr("fs_entity_list_random_node", config->filter) ) {
+    srandom(seed);
+    bench_check_walk(&ctx, "fs_entity_list_random_node", fs_entity_list_random_node);
+    ctx.fslist = bench_tree_create(&ctx);
+    srandom(seed);
+    bench_run(config, "fs_entity_list_random_node", nodes, bench_random_node, &ctx);
+    fs_entity_list_destroy(ctx.fslist);
+  }
+
+  if ( ! config->filter || strstr("fs_entity_list_advance_entity_state", config->filter) ) {
+    if ( ! bench_record_sequence(&ctx) ) {
+      fprintf(stderr, "ERROR:  unable to record a walk of %u nodes\n", nodes);
+      exit(ENOMEM);
+    }
+    ctx.fslist = bench_tree_create(&ctx);
+    bench_run(config, "fs_entity_list_advance_entity_state", nodes, bench_advance_entity_state, &ctx);
+    fs_entity_list_destroy(ctx.fslist);
+    free((void*)ctx.sequence);
+  }
+}
+
+//
+
+int
+main(
+  int                   argc,
+  char* const           *argv
+)
+{
+  int                   opt;
+  bench_config          config;
+  const char            *nodes_list = "1000,10000,100000,1000000";
+  unsigned int          fanout = 16;
+  unsigned long long    seed = 1;
+
+  memset(&config, 0, sizeof(config));
+  config.format = bench_format_csv;
+  config.min_time = 0.5;
+
+  optind = 0;
+  while ( (opt = getopt_long(argc, argv, urltest_bench_optstring, urltest_bench_options, NULL)) != -1 ) {
+    switch ( opt ) {
+
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+
+      case 'f':
+        if ( optarg && *optarg ) {
+          if ( strcasecmp(optarg, "csv") == 0 ) {
+            config.format = bench_format_csv;
+          } else if ( strcasecmp(optarg, "tsv") == 0 ) {
+            config.format = bench_format_tsv;
+          } else if ( strcasecmp(optarg, "table") == 0 ) {
+            config.format = bench_format_table;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --format/-f:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --format/-f option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'n':
+        if ( optarg && *optarg ) {
+          nodes_list = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --nodes/-n option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'F': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+
+          if ( (value >= 2) && (endp > optarg) && (*endp == '\0') ) {
+            fanout = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --fanout/-F:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --fanout/-F option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+      case 't': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          double        value = strtod(optarg, &endp);
+
+          if ( (value > 0.0) && (endp > optarg) && (*endp == '\0') ) {
+            config.min_time = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --min-time/-t:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --min-time/-t option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+      case 'b':
+        if ( optarg && *optarg ) {
+          config.filter = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --filter/-b option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'S': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+
+          seed = strtoull(optarg, &endp, 0);
+          if ( (endp == optarg) || (*endp != '\0') ) {
+            fprintf(stderr, "ERROR:  invalid argument to --seed/-S:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --seed/-S option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+    }
+  }
+
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  //
+  // Routines that don't depend on a tree:
+  //
+  if ( ! config.filter || strstr("http_stats_update_and_copy/histograms", config.filter) ) {
+    bench_stats_context ctx;
+
+    if ( ! (ctx.curl_request = bench_curl_handle_create()) ) {
+      fprintf(stderr, "ERROR:  unable to complete a request on the loopback interface\n");
+      exit(ECONNREFUSED);
+    }
+    ctx.stats = http_stats_create();
+    bench_run(&config, "http_stats_update_and_copy", 0, bench_http_stats_update_and_copy, &ctx);
+    http_stats_destroy(ctx.stats);
+
+    ctx.stats = http_stats_create();
+    http_stats_enable_histograms(ctx.stats);
+    bench_run(&config, "http_stats_update_and_copy/histograms", 0, bench_http_stats_update_and_copy, &ctx);
+    http_stats_destroy(ctx.stats);
+    curl_easy_cleanup(ctx.curl_request);
+  }
+  bench_run(&config, "strmcat", 0, bench_strmcat, NULL);
+
+  //
+  // Then the fs_entity routines for each tree size:
+  //
+  while ( *nodes_list ) {
+    char                *endp;
+    long                nodes = strtol(nodes_list, &endp, 10);
+
+    if ( (nodes <= 0) || (endp == nodes_list) || ((*endp != ',') && (*endp != '\0')) ) {
+      fprintf(stderr, "ERROR:  invalid argument to --nodes/-n:  %s\n", nodes_list);
+      exit(EINVAL);
+    }
+    bench_tree_suite(&config, nodes, fanout, seed);
+    nodes_list = (*endp == ',') ? (endp + 1) : endp;
+  }
+
+  curl_global_cleanup();
+  return 0;
+}
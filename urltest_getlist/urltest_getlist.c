@@ -9,12 +9,20 @@
 #include "config.h"
 
 #include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
 #include <curl/curl.h>
 
 #include "util_fns.h"
 #include "http_ops.h"
+#include "http_multi.h"
 #include "http_stats.h"
+#include "http_trace.h"
+#include "coordinator.h"
+#include "url_list.h"
 
 //
 
@@ -25,6 +33,10 @@ static const struct option urltest_getlist_options[] = {
     { "verbose-curl",     no_argument,          NULL,       'V' },
     { "dry-run",          no_argument,          NULL,       'd' },
     { "show-timings",     optional_argument,    NULL,       't' },
+    { "time-series",      required_argument,    NULL,       'i' },
+    { "progress",         required_argument,    NULL,       'e' },
+    { "trace",            required_argument,    NULL,       'o' },
+    { "snapshot",         required_argument,    NULL,       'j' },
     //
     { "base-url",         required_argument,    NULL,       'U' },
     { "url-list",         required_argument,    NULL,       'l' },
@@ -33,11 +45,21 @@ static const struct option urltest_getlist_options[] = {
     { "password",         required_argument,    NULL,       'p' },
     { "retries",          required_argument,    NULL,       'r' },
     { "no-cert-verify",   no_argument,          NULL,       'k' },
+    { "unix-socket",      required_argument,    NULL,       'X' },
     { "follow-3xx",       no_argument,          NULL,       'f' },
+    { "concurrency",      required_argument,    NULL,       'c' },
+    { "workers",          required_argument,    NULL,       'w' },
+    { "rate",             required_argument,    NULL,       'R' },
+    { "seed",             required_argument,    NULL,       'S' },
+    { "worker-id",        required_argument,    NULL,       'W' },
+    //
+    { "coordinator",      required_argument,    NULL,       'C' },
+    { "agents",           required_argument,    NULL,       'A' },
+    { "agent",            required_argument,    NULL,       'G' },
     { NULL,               0,                    NULL,        0  }
   };
 
-static const char *urltest_getlist_optstring = "h" "vVdt" "U:l:m:u:p:r:kf";
+static const char *urltest_getlist_optstring = "h" "vVdti:e:o:j:" "U:l:m:u:p:r:kX:fc:w:R:S:W:" "C:A:G:";
 
 //
 
@@ -66,6 +88,22 @@ usage(
       "                                 <out> = <format>{:<path>}\n"
       "                                 <format> = table | csv | tsv\n"
       "\n"
+      "  --time-series/-i <series>    also keep timing statistics per interval of the run and\n"
+      "                               show them as a time series at the end of the run (the\n"
+      "                               most recent 3600 intervals are kept)\n"
+      "\n"
+      "                                 <series> = <seconds>{:<format>{:<path>}}\n"
+      "                                 <format> = table | csv | tsv (default: csv)\n"
+      "\n"
+      "  --progress/-e <seconds>      every <seconds> print the request rate, requests in\n"
+      "                               flight, errors and p50/p99 total time over the last\n"
+      "                               interval to stderr\n"
+      "  --trace/-o <path>            record every request (time, status, timings) to a\n"
+      "                               binary trace file at <path>, written in the background;\n"
+      "                               see urltest_trace to convert it to CSV/TSV\n"
+      "  --snapshot/-j <path>         write the run's timing statistics to <path> as a binary\n"
+      "                               snapshot; see urltest_merge to combine the snapshots of\n"
+      "                               several runs exactly\n"
       "  --base-url/-U <remote URL>   prepend the given <remote URL> to each URL read from the\n"
       "                               url list; implies that URLs on the url list will be path\n"
       "                               components that should be appended to a base URL\n"
@@ -84,8 +122,42 @@ usage(
       "                               hard failing the URL in question (default: 1)\n"
       "  --no-cert-verify/-k          do not require SSL certificate verfication for connections\n"
       "                               to succeed\n"
+      "  --unix-socket/-X <path>      connect to the server on this Unix domain socket rather\n"
+      "                               than the host and port in each URL\n"
       "  --follow-3xx/-f              attempt to follow all HTTP 3XX responses to the eventual\n"
       "                               non-3XX target\n"
+      "  --concurrency/-c <#>         keep up to this many requests in flight at once using\n"
+      "                               a single thread (default: 0, one request at a time\n"
+      "                               without the cURL multi interface)\n"
+      "  --workers/-w <#>             start this many worker threads, each with its own cURL\n"
+      "                               handles and timing statistics, pulling URLs from the\n"
+      "                               shared url list (default: 1); combined with\n"
+      "                               --concurrency/-c each worker keeps that many requests\n"
+      "                               in flight\n"
+      "  --rate/-R <#>                issue requests open-loop at this many per second (across\n"
+      "                               all workers) on a fixed schedule, regardless of how fast\n"
+      "                               the server responds; implies --concurrency/-c 64 unless\n"
+      "                               a concurrency is given.  Timing statistics are reported\n"
+      "                               both as measured and corrected to the intended start\n"
+      "                               time of each request\n"
+      "  --seed/-S <#>                shuffle the url list before fetching it; the same seed\n"
+      "                               and worker id always produce the same order\n"
+      "  --worker-id/-W <#>           when several copies of this program share one url list,\n"
+      "                               give each a distinct id so that each fetches the list\n"
+      "                               in its own order (implies shuffling; default seed: 0)\n"
+      "\n"
+      "  --coordinator/-C <address>   fetch nothing, but wait for --agents/-A copies of this\n"
+      "                               program to connect on <address> ({<host>:}<port>), hand\n"
+      "                               each a share of the url list, the seed and a common\n"
+      "                               start time, and combine their timing statistics\n"
+      "                               periodically (every --progress/-e seconds, default 5)\n"
+      "                               and at the end of the run\n"
+      "  --agents/-A <#>              number of agents the coordinator waits for (default: 1)\n"
+      "  --agent/-G <address>         take the url list, seed and start time from the\n"
+      "                               coordinator at <address> (<host>:<port>) and report\n"
+      "                               timing statistics back to it; all other options (e.g.\n"
+      "                               --base-url/-U, --concurrency/-c, --rate/-R) apply to\n"
+      "                               this agent alone\n"
       "\n"
       " environment:\n"
       "\n"
@@ -170,6 +242,754 @@ http_error_exit(
 
 //
 
+typedef struct {
+  bool              is_verbose;
+  bool              is_dry_run;
+  unsigned int      retries;
+  unsigned int      concurrency;
+  unsigned int      n_workers;
+  double            rate;
+  double            t0;
+  const char        *base_url;
+  size_t            base_url_len;
+  url_list_ref      urls;
+  unsigned int      next_url_index;
+  http_trace_ref    trace;
+  //
+  // Agent mode:  workers publish their statistics every report_interval
+  // seconds and the main thread waits on changed for them to finish:
+  //
+  double            report_interval;
+  unsigned int      n_running;
+  pthread_mutex_t   lock;
+  pthread_cond_t    changed;
+} getlist_config;
+
+typedef struct {
+  unsigned int      worker_id;
+  getlist_config    *config;
+  http_ops_ref      http_ops;
+  http_stats_ref    stats;
+  http_stats_ref    corrected_stats;
+  http_stats_series_ref series;
+  unsigned long     n_issued, n_late;
+  unsigned int      url_index;
+  double            max_lag, last_lag_warning;
+  char              *url_buffer;
+  size_t            url_buffer_capacity;
+  double            next_report;
+  void              *report;
+  size_t            report_len;
+  pthread_mutex_t   report_lock;
+  pthread_t         thread;
+} getlist_worker;
+
+//
+// How far behind its schedule a request can start before it's counted
+// as late:
+//
+#define GETLIST_LAG_THRESHOLD     0.010
+#define GETLIST_LAG_WARN_INTERVAL 5.0
+
+//
+
+bool
+next_target_url(
+  getlist_worker  *worker
+)
+{
+  getlist_config  *config = worker->config;
+  unsigned int    index;
+  
+  //
+  // The url list is shared by all workers; each just claims the next
+  // unused index:
+  //
+  index = __sync_fetch_and_add(&config->next_url_index, 1);
+  if ( index >= url_list_get_count(config->urls) ) return false;
+  worker->url_index = index;
+  
+  //
+  // Compile the base_url and url into the worker's buffer, which is
+  // reused from one request to the next:
+  //
+  if ( ! url_list_copy_url(config->urls, index, config->base_url, config->base_url_len, &worker->url_buffer, &worker->url_buffer_capacity) ) {
+    fprintf(stderr, "ERROR:  unable to allocate URL buffer\n");
+    exit(ENOMEM);
+  }
+  return true;
+}
+
+//
+
+void
+report_success(
+  const char          *target_url,
+  long                http_status,
+  http_stats_record   *req_stats,
+  CURL                *curl_handle
+)
+{
+  http_stats_field    i_f;
+  bool                line_done = false;
+  
+  flockfile(stdout);
+  printf("T,%ld,\"%s\"", http_status, target_url);
+  for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) printf(",%lg", (*req_stats)[i_f]);
+  
+  if ( curl_handle ) {
+    char    *url = NULL;
+    
+    if ( (http_status / 100) == 3 ) {
+      curl_easy_getinfo(curl_handle, CURLINFO_REDIRECT_URL, &url);
+    }
+    else if ( http_status == 200 ) {
+      curl_easy_getinfo(curl_handle, CURLINFO_CONTENT_TYPE, &url);
+    }
+    if ( url ) {
+      printf(",\"%s\"\n", url);
+      line_done = true;
+    }
+  }
+  if ( ! line_done ) printf(",\n");
+  funlockfile(stdout);
+}
+
+//
+
+void
+report_failure(
+  const char          *target_url,
+  const char          *error_buffer
+)
+{
+  http_stats_field    i_f;
+  
+  flockfile(stdout);
+  printf("F,%ld,\"%s\"", 0L, target_url);
+  for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) printf(",0");
+  printf(",\"%s\"\n", error_buffer);
+  funlockfile(stdout);
+}
+
+//
+
+bool
+multi_completion(
+  http_multi_result   *result,
+  void                *callback_context
+)
+{
+  getlist_worker      *worker = (getlist_worker*)callback_context;
+  
+  if ( result->ccode == CURLE_OK ) {
+    http_stats_record   *req_stats = &result->req_stats;
+    long                http_status = result->http_status;
+    
+    if ( result->has_stats ) {
+      http_stats_update_with_record(worker->stats, http_status, req_stats);
+      if ( worker->corrected_stats ) {
+        //
+        // Coordinated omission:  the request was really meant to start at its
+        // scheduled time, so any delay in issuing it counts against every
+        // timing point:
+        //
+        http_stats_record   corrected;
+        http_stats_field    i_f;
+        double              delay = 1000.0 * (result->start_time - result->scheduled_time);
+        
+        memcpy(&corrected, req_stats, sizeof(corrected));
+        if ( delay > 0.0 ) for ( i_f = http_stats_field_dns; i_f <= http_stats_field_total; i_f++ ) corrected[i_f] += delay;
+        http_stats_update_with_record(worker->corrected_stats, http_status, &corrected);
+      }
+      if ( worker->series ) http_stats_series_update_with_record(worker->series, monotonic_seconds(), http_status, req_stats);
+      if ( worker->config->trace ) http_trace_add(worker->config->trace, (unsigned int)(uintptr_t)result->context, http_ops_method_get, http_status, req_stats);
+    }
+    if ( worker->config->is_verbose ) report_success(result->url, http_status, req_stats, result->curl_request);
+    return false;
+  }
+  if ( worker->config->trace ) http_trace_add(worker->config->trace, (unsigned int)(uintptr_t)result->context, http_ops_method_get, 0, NULL);
+  if ( result->attempt < worker->config->retries ) return true;
+  report_failure(result->url, result->error_buffer);
+  return false;
+}
+
+//
+
+void
+getlist_worker_note_lag(
+  getlist_worker    *worker,
+  double            now,
+  double            lag
+)
+{
+  worker->n_issued++;
+  if ( lag > worker->max_lag ) worker->max_lag = lag;
+  if ( lag > GETLIST_LAG_THRESHOLD ) {
+    worker->n_late++;
+    if ( now - worker->last_lag_warning >= GETLIST_LAG_WARN_INTERVAL ) {
+      fprintf(stderr, "WARNING:  worker %u is %.3lf ms behind its request schedule\n", worker->worker_id, 1000.0 * lag);
+      worker->last_lag_warning = now;
+    }
+  }
+}
+
+//
+// In agent mode each worker periodically publishes a snapshot of its own
+// statistics for the main thread to combine and pass on to the coordinator;
+// only the worker itself ever touches its stats, so it has to make the copy:
+//
+
+void
+getlist_worker_publish(
+  getlist_worker    *worker
+)
+{
+  double            now;
+  void              *report, *old_report;
+  size_t            report_len;
+  
+  if ( worker->config->report_interval <= 0.0 ) return;
+  if ( (now = monotonic_seconds()) < worker->next_report ) return;
+  worker->next_report = now + worker->config->report_interval;
+  if ( ! (report = http_stats_snapshot(worker->stats, &report_len)) ) return;
+  
+  pthread_mutex_lock(&worker->report_lock);
+  old_report = worker->report;
+  worker->report = report;
+  worker->report_len = report_len;
+  pthread_mutex_unlock(&worker->report_lock);
+  if ( old_report ) free(old_report);
+}
+
+//
+
+void*
+getlist_worker_run(
+  void      *context
+)
+{
+  getlist_worker      *worker = (getlist_worker*)context;
+  getlist_config      *config = worker->config;
+  
+  if ( (config->concurrency > 0) && ! config->is_dry_run ) {
+    http_multi_ref    multi = http_multi_create(worker->http_ops, config->concurrency);
+    bool              at_eof = false;
+    bool              is_open_loop = (config->rate > 0.0) ? true : false;
+    unsigned long     k = 0;
+    double            next_due = 0.0;
+    
+    if ( ! multi ) {
+      fprintf(stderr, "ERROR:  unable to allocate %u concurrent requests\n", config->concurrency);
+      exit(ENOMEM);
+    }
+    
+    //
+    // In open-loop mode the workers' schedules are interleaved:  request k of
+    // worker w is due at t0 + (k * n_workers + w) / rate.
+    //
+    if ( is_open_loop ) next_due = config->t0 + (double)worker->worker_id / config->rate;
+    
+    while ( ! at_eof || http_multi_get_in_flight(multi) ) {
+      double          now = is_open_loop ? monotonic_seconds() : 0.0;
+      int             timeout_ms = 1000;
+      
+      //
+      // Top-up the in-flight requests:
+      //
+      while ( ! at_eof && http_multi_has_free_slot(multi) && (next_due <= now) ) {
+        if ( ! next_target_url(worker) ) {
+          at_eof = true;
+        } else {
+          const char  *target_url = worker->url_buffer;
+          bool        ok;
+          
+          if ( is_open_loop ) {
+            getlist_worker_note_lag(worker, now, now - next_due);
+            ok = http_multi_download_scheduled(multi, target_url, next_due, (void*)(uintptr_t)worker->url_index);
+            k++;
+            next_due = config->t0 + ((double)k * config->n_workers + worker->worker_id) / config->rate;
+          } else {
+            ok = http_multi_download(multi, target_url, (void*)(uintptr_t)worker->url_index);
+          }
+          if ( ! ok ) report_failure(target_url, "unable to start request");
+        }
+      }
+      
+      //
+      // Don't wait past the next request's due time if there's room to
+      // issue it:
+      //
+      if ( is_open_loop && ! at_eof && http_multi_has_free_slot(multi) ) {
+        double        delta = next_due - monotonic_seconds();
+        
+        timeout_ms = (delta <= 0.0) ? 0 : ((delta >= 1.0) ? 1000 : (int)ceil(1000.0 * delta));
+      }
+      if ( http_multi_get_in_flight(multi) ) {
+        if ( http_multi_perform(multi, timeout_ms, multi_completion, worker) < 0 ) {
+          fprintf(stderr, "ERROR:  failure in cURL multi interface\n");
+          exit(EIO);
+        }
+        getlist_worker_publish(worker);
+      } else if ( is_open_loop && ! at_eof && (timeout_ms > 0) ) {
+        // Idle until the next request is due:
+        usleep(1000 * timeout_ms);
+      }
+    }
+    http_multi_destroy(multi);
+    
+    if ( is_open_loop && worker->n_late ) {
+      fprintf(stderr,
+          "WARNING:  worker %u started %lu of %lu requests more than %.0lf ms behind schedule (worst %.3lf ms); the client could not sustain the requested rate\n",
+          worker->worker_id, worker->n_late, worker->n_issued, 1000.0 * GETLIST_LAG_THRESHOLD, 1000.0 * worker->max_lag
+        );
+    }
+  } else {
+    while ( next_target_url(worker) ) {
+      const char      *target_url = worker->url_buffer;
+      
+      if ( config->is_dry_run ) {
+        flockfile(stdout);
+        printf("<- %s\n", target_url);
+        funlockfile(stdout);
+      } else {
+        http_stats_record   req_stats;
+        long                http_status = -1;
+        unsigned int        retry_count = 0;
+
+retry:
+        if ( http_ops_download(worker->http_ops, target_url, NULL, worker->stats, &req_stats, &http_status) ) {
+          if ( config->trace ) http_trace_add(config->trace, worker->url_index, http_ops_method_get, http_status, &req_stats);
+          if ( config->is_verbose ) report_success(target_url, http_status, &req_stats, http_ops_curl_handle_for_request(worker->http_ops, http_ops_curl_request_get));
+        } else {
+          if ( config->trace ) http_trace_add(config->trace, worker->url_index, http_ops_method_get, 0, NULL);
+          if ( retry_count++ < config->retries ) goto retry;
+          report_failure(target_url, http_ops_get_error_buffer(worker->http_ops));
+        }
+        getlist_worker_publish(worker);
+      }
+    }
+  }
+  if ( config->report_interval > 0.0 ) {
+    pthread_mutex_lock(&config->lock);
+    config->n_running--;
+    pthread_cond_signal(&config->changed);
+    pthread_mutex_unlock(&config->lock);
+  }
+  return NULL;
+}
+
+//
+// Agent mode:  the url list, seed and start time come from the coordinator,
+// and the workers' statistics go back to it every report interval:
+//
+
+int
+getlist_agent_join(
+  const char              *address,
+  coordinator_assignment  *assignment,
+  void*                   *payload
+)
+{
+  int                     fd = coordinator_connect(address);
+  uint8_t                 hello[4];
+  coordinator_msg         type;
+  size_t                  length;
+  
+  if ( fd < 0 ) {
+    fprintf(stderr, "ERROR:  unable to connect to coordinator at %s (errno = %d)\n", address, errno);
+    exit(errno ? errno : EINVAL);
+  }
+  le_put_u32(hello, COORDINATOR_PROTOCOL_VERSION);
+  if ( ! coordinator_send(fd, coordinator_msg_hello, hello, sizeof(hello)) || ! coordinator_recv(fd, &type, payload, &length) ) {
+    fprintf(stderr, "ERROR:  no assignment received from coordinator at %s\n", address);
+    exit(EPROTO);
+  }
+  if ( (type != coordinator_msg_assign) || ! coordinator_assignment_decode(*payload, length, assignment) ) {
+    fprintf(stderr, "ERROR:  invalid assignment received from coordinator at %s\n", address);
+    exit(EPROTO);
+  }
+  return fd;
+}
+
+//
+
+void
+getlist_sleep_until(
+  double            wallclock
+)
+{
+  struct timeval    now;
+  double            delta;
+  
+  gettimeofday(&now, NULL);
+  while ( (delta = wallclock - (now.tv_sec + 1e-6 * now.tv_usec)) > 0.0 ) {
+    usleep((delta >= 1.0) ? 1000000 : (useconds_t)(1e6 * delta));
+    gettimeofday(&now, NULL);
+  }
+}
+
+//
+
+void
+getlist_agent_send(
+  int               agent_fd,
+  coordinator_msg   type,
+  http_stats_ref    stats
+)
+{
+  size_t            length;
+  void              *snapshot = http_stats_snapshot(stats, &length);
+  
+  if ( ! snapshot || ! coordinator_send(agent_fd, type, snapshot, length) ) {
+    fprintf(stderr, "WARNING:  unable to send timing statistics to the coordinator\n");
+  }
+  if ( snapshot ) free(snapshot);
+}
+
+//
+
+void
+getlist_agent_wait(
+  getlist_config    *config,
+  int               agent_fd,
+  getlist_worker    *workers
+)
+{
+  double            deadline = config->t0 + config->report_interval;
+  
+  pthread_mutex_lock(&config->lock);
+  while ( config->n_running > 0 ) {
+    struct timespec until = { .tv_sec = (time_t)deadline, .tv_nsec = (long)(1e9 * (deadline - floor(deadline))) };
+    
+    pthread_cond_timedwait(&config->changed, &config->lock, &until);
+    if ( (config->n_running > 0) && (monotonic_seconds() >= deadline) ) {
+      http_stats_ref  stats;
+      unsigned int    i_w;
+      
+      pthread_mutex_unlock(&config->lock);
+      
+      // Combine whatever each worker last published:
+      if ( (stats = http_stats_create()) ) {
+        for ( i_w = 0; i_w < config->n_workers; i_w++ ) {
+          pthread_mutex_lock(&workers[i_w].report_lock);
+          if ( workers[i_w].report ) http_stats_merge_snapshot(stats, workers[i_w].report, workers[i_w].report_len);
+          pthread_mutex_unlock(&workers[i_w].report_lock);
+        }
+        getlist_agent_send(agent_fd, coordinator_msg_stats, stats);
+        http_stats_destroy(stats);
+      }
+      while ( deadline <= monotonic_seconds() ) deadline += config->report_interval;
+      pthread_mutex_lock(&config->lock);
+    }
+  }
+  pthread_mutex_unlock(&config->lock);
+}
+
+//
+// Coordinator mode:  no requests are made here; each agent's most recent
+// (cumulative) statistics are kept and combined for the progress lines and
+// the final figures.
+//
+
+#define GETLIST_COORDINATOR_START_DELAY       2.0
+#define GETLIST_COORDINATOR_REPORT_INTERVAL   5.0
+
+typedef struct {
+  int               fd;
+  http_stats_ref    stats;
+  bool              is_done;
+} getlist_agent;
+
+//
+
+http_stats_ref
+getlist_coordinator_combine(
+  getlist_agent     *agents,
+  unsigned int      n_agents,
+  http_stats_ref    into
+)
+{
+  unsigned int      i_a;
+  
+  if ( into || (into = http_stats_create()) ) {
+    for ( i_a = 0; i_a < n_agents; i_a++ ) if ( agents[i_a].stats ) http_stats_merge(into, agents[i_a].stats);
+  }
+  return into;
+}
+
+//
+
+void
+getlist_coordinator_progress(
+  getlist_agent     *agents,
+  unsigned int      n_agents,
+  unsigned int      n_done,
+  double            elapsed,
+  double            dt,
+  unsigned int      *last_count
+)
+{
+  http_stats_ref    merged = getlist_coordinator_combine(agents, n_agents, NULL);
+  http_stats_data   total;
+  
+  if ( ! merged ) return;
+  http_stats_get(merged, http_stats_bystatus_all, http_stats_field_total, &total);
+  fprintf(stderr, "[%10.3lf s] %4u/%u agents running %10u requests %10.1lf req/s   p50 %8.3lg ms   p99 %8.3lg ms\n",
+      elapsed, n_agents - n_done, n_agents, total.count, (total.count - *last_count) / dt,
+      total.percentile[http_stats_percentile_50], total.percentile[http_stats_percentile_99]
+    );
+  *last_count = total.count;
+  http_stats_destroy(merged);
+}
+
+//
+
+int
+getlist_coordinate(
+  getlist_config    *config,
+  const char        *address,
+  unsigned int      n_agents,
+  bool              should_shuffle,
+  uint64_t          seed,
+  double            report_interval,
+  http_stats_ref    aggr_stats
+)
+{
+  int               listen_fd = coordinator_listen(address), rc = 0;
+  getlist_agent     *agents = calloc(n_agents, sizeof(getlist_agent));
+  struct pollfd     *pollfds = calloc(n_agents, sizeof(struct pollfd));
+  unsigned int      n_urls = url_list_get_count(config->urls), n_done = 0, last_count = 0, i_a;
+  double            start_time, t0, t_last, deadline;
+  struct timeval    now;
+  
+  if ( listen_fd < 0 ) {
+    fprintf(stderr, "ERROR:  unable to listen for agents on %s (errno = %d)\n", address, errno);
+    exit(errno ? errno : EINVAL);
+  }
+  if ( ! agents || ! pollfds ) {
+    fprintf(stderr, "ERROR:  unable to allocate %u agents\n", n_agents);
+    exit(ENOMEM);
+  }
+  if ( config->is_verbose ) printf("Waiting for %u agent%s on %s\n", n_agents, (n_agents == 1) ? "" : "s", address);
+  
+  for ( i_a = 0; i_a < n_agents; ) {
+    int               fd = accept(listen_fd, NULL, NULL);
+    coordinator_msg   type;
+    void              *payload = NULL;
+    size_t            length = 0;
+    const uint8_t     *p;
+    
+    if ( fd < 0 ) {
+      if ( errno == EINTR ) continue;
+      fprintf(stderr, "ERROR:  unable to accept agent connection (errno = %d)\n", errno);
+      exit(errno);
+    }
+    if ( ! coordinator_recv(fd, &type, &payload, &length) || (type != coordinator_msg_hello) || (length < 4) || ((p = payload), le_get_u32(&p) != COORDINATOR_PROTOCOL_VERSION) ) {
+      fprintf(stderr, "WARNING:  ignoring a connection that is not a compatible agent\n");
+      if ( payload ) free(payload);
+      close(fd);
+      continue;
+    }
+    free(payload);
+    agents[i_a].fd = fd;
+    if ( config->is_verbose ) printf("Agent %u of %u connected\n", i_a + 1, n_agents);
+    i_a++;
+  }
+  close(listen_fd);
+  
+  //
+  // Each agent gets a contiguous share of the list and everyone gets the
+  // same start time, far enough ahead for the shares to arrive and load:
+  //
+  gettimeofday(&now, NULL);
+  start_time = now.tv_sec + 1e-6 * now.tv_usec + GETLIST_COORDINATOR_START_DELAY;
+  t0 = monotonic_seconds() + GETLIST_COORDINATOR_START_DELAY;
+  for ( i_a = 0; i_a < n_agents; i_a++ ) {
+    unsigned int            first = (uint64_t)n_urls * i_a / n_agents, last = (uint64_t)n_urls * (i_a + 1) / n_agents, i;
+    coordinator_assignment  assignment = { .agent_id = i_a, .n_agents = n_agents, .seed = seed, .should_shuffle = should_shuffle,
+                                           .start_time = start_time, .report_interval = report_interval };
+    size_t                  shard_len = 0, length;
+    char                    *shard;
+    void                    *payload;
+    
+    for ( i = first; i < last; i++ ) {
+      size_t                url_len;
+      
+      url_list_get_url(config->urls, i, &url_len);
+      shard_len += url_len + 1;
+    }
+    if ( ! (shard = malloc(shard_len ? shard_len : 1)) ) {
+      fprintf(stderr, "ERROR:  unable to allocate url list for agent %u\n", i_a);
+      exit(ENOMEM);
+    }
+    for ( i = first, shard_len = 0; i < last; i++ ) {
+      size_t                url_len;
+      const char            *url = url_list_get_url(config->urls, i, &url_len);
+      
+      memcpy(shard + shard_len, url, url_len);
+      shard[shard_len + url_len] = '\n';
+      shard_len += url_len + 1;
+    }
+    assignment.urls = shard;
+    assignment.urls_len = shard_len;
+    payload = coordinator_assignment_encode(&assignment, &length);
+    if ( ! payload || ! coordinator_send(agents[i_a].fd, coordinator_msg_assign, payload, length) ) {
+      fprintf(stderr, "ERROR:  unable to send assignment to agent %u\n", i_a);
+      exit(EIO);
+    }
+    if ( config->is_verbose ) printf("Agent %u assigned urls %u through %u\n", i_a, first, last);
+    free(payload);
+    free((void*)shard);
+  }
+  
+  //
+  // Collect statistics until every agent has sent its final figures (or
+  // gone away, in which case its last report has to do):
+  //
+  t_last = t0;
+  deadline = t0 + report_interval;
+  while ( n_done < n_agents ) {
+    double            delta = deadline - monotonic_seconds();
+    int               n_ready;
+    
+    for ( i_a = 0; i_a < n_agents; i_a++ ) {
+      pollfds[i_a].fd = agents[i_a].is_done ? -1 : agents[i_a].fd;
+      pollfds[i_a].events = POLLIN;
+      pollfds[i_a].revents = 0;
+    }
+    n_ready = poll(pollfds, n_agents, (delta <= 0.0) ? 0 : (int)ceil(1000.0 * delta));
+    if ( (n_ready < 0) && (errno != EINTR) ) {
+      fprintf(stderr, "ERROR:  failure waiting on agents (errno = %d)\n", errno);
+      exit(errno);
+    }
+    for ( i_a = 0; (n_ready > 0) && (i_a < n_agents); i_a++ ) {
+      coordinator_msg   type;
+      void              *payload = NULL;
+      size_t            length = 0;
+      
+      if ( ! pollfds[i_a].revents ) continue;
+      if ( ! coordinator_recv(agents[i_a].fd, &type, &payload, &length) ) {
+        fprintf(stderr, "WARNING:  agent %u went away before the end of its run; its last report is used\n", i_a);
+        agents[i_a].is_done = true;
+        close(agents[i_a].fd);
+        n_done++;
+        rc = EPIPE;
+        continue;
+      }
+      if ( (type == coordinator_msg_stats) || (type == coordinator_msg_final) ) {
+        http_stats_ref  stats = http_stats_create();
+        
+        if ( stats && http_stats_merge_snapshot(stats, payload, length) ) {
+          if ( agents[i_a].stats ) http_stats_destroy(agents[i_a].stats);
+          agents[i_a].stats = stats;
+        } else {
+          fprintf(stderr, "WARNING:  invalid timing statistics from agent %u\n", i_a);
+          if ( stats ) http_stats_destroy(stats);
+        }
+        if ( type == coordinator_msg_final ) {
+          agents[i_a].is_done = true;
+          close(agents[i_a].fd);
+          n_done++;
+        }
+      }
+      if ( payload ) free(payload);
+    }
+    if ( monotonic_seconds() >= deadline ) {
+      double          t_now = monotonic_seconds();
+      
+      getlist_coordinator_progress(agents, n_agents, n_done, t_now - t0, t_now - t_last, &last_count);
+      t_last = t_now;
+      while ( deadline <= t_now ) deadline += report_interval;
+    }
+  }
+  
+  getlist_coordinator_combine(agents, n_agents, aggr_stats);
+  for ( i_a = 0; i_a < n_agents; i_a++ ) if ( agents[i_a].stats ) http_stats_destroy(agents[i_a].stats);
+  free((void*)pollfds);
+  free((void*)agents);
+  return rc;
+}
+
+//
+
+int
+getlist_show_timings(
+  http_stats_format   stats_format,
+  const char          *timing_output,
+  http_stats_ref      aggr_stats,
+  http_stats_ref      aggr_corrected_stats
+)
+{
+  int                 rc = 0;
+  
+  if ( ! timing_output ) {
+    printf("Timing information:\n\n");
+    http_stats_print(stats_format, http_stats_print_flags_percentiles, aggr_stats);
+    if ( aggr_corrected_stats ) {
+      printf("\nTiming information, corrected to intended start times:\n\n");
+      http_stats_print(stats_format, http_stats_print_flags_percentiles, aggr_corrected_stats);
+    }
+  } else {
+    FILE			*timing_fptr = fopen(timing_output, "w");
+    
+    if ( timing_fptr ) {
+      http_stats_fprint(timing_fptr, stats_format, http_stats_print_flags_percentiles, aggr_stats);
+      //
+      // For csv/tsv the corrected figures follow as a second data row
+      // under the same header:
+      //
+      if ( aggr_corrected_stats ) {
+        if ( stats_format == http_stats_format_table ) fprintf(timing_fptr, "\nCorrected to intended start times:\n\n");
+        http_stats_fprint(timing_fptr, stats_format, http_stats_print_flags_percentiles | ((stats_format == http_stats_format_table) ? 0 : http_stats_print_flags_no_header), aggr_corrected_stats);
+      }
+      fclose(timing_fptr);
+    } else {
+      fprintf(stderr, "ERROR:  unable to open timing file for writing: %s\n", timing_output);
+      rc = errno;
+    }
+  }
+  return rc;
+}
+
+//
+
+int
+getlist_write_snapshot(
+  const char        *snapshot_output,
+  http_stats_ref    aggr_stats
+)
+{
+  FILE              *snapshot_fptr = fopen(snapshot_output, "wb");
+  int               rc = 0;
+  
+  if ( snapshot_fptr ) {
+    if ( ! http_stats_fwrite_snapshot(snapshot_fptr, aggr_stats) ) {
+      fprintf(stderr, "ERROR:  unable to write timing snapshot: %s\n", snapshot_output);
+      rc = EIO;
+    }
+    fclose(snapshot_fptr);
+  } else {
+    fprintf(stderr, "ERROR:  unable to open timing snapshot for writing: %s\n", snapshot_output);
+    rc = errno;
+  }
+  return rc;
+}
+
+//
+
+const char*
+getlist_trace_url(
+  void          *context,
+  unsigned int  index,
+  size_t        *length
+)
+{
+  return url_list_get_url((url_list_ref)context, index, length);
+}
+
+//
+
 int
 main(
   int               argc,
@@ -177,22 +997,33 @@ main(
 )
 {
   int                       rc = 0, opt;
-  bool                      is_verbose = false;
-  bool                      is_dry_run = false;
+  getlist_config            config = { .is_verbose = false, .is_dry_run = false, .retries = 1, .concurrency = 0, .rate = 0.0 };
   bool                      should_show_timings = false;
   bool                      should_follow_3xx = false;
-  int                       retries = 1;
   http_stats_format					stats_format = http_stats_format_table;
   http_stats_ref            aggr_stats = http_stats_create();
+  http_stats_ref            aggr_corrected_stats = NULL;
   http_ops_ref              http_ops = http_ops_create();
   const char								*timing_output = NULL;
+  double                    series_interval = 0.0;
+  http_stats_format         series_format = http_stats_format_csv;
+  http_stats_series_ref     aggr_series = NULL;
+  const char                *series_output = NULL;
+  double                    progress_interval = 0.0;
+  http_progress_ref         progress = NULL;
+  const char                *trace_path = NULL;
+  const char                *snapshot_output = NULL;
   const char                *base_url = NULL;
-  size_t                    base_url_len;
-  bool                      does_base_url_have_terminal_slash;
   const char                *url_list = NULL;
-  FILE                      *url_stream = stdin;
-  size_t                    next_url_len;
-  const char                *next_url;
+  unsigned int              n_workers = 1, i_w;
+  bool                      should_shuffle = false;
+  uint64_t                  seed = 0, worker_id = 0;
+  const char                *coordinator_address = NULL;
+  unsigned int              n_agents = 1;
+  const char                *agent_address = NULL;
+  int                       agent_fd = -1;
+  double                    start_time = 0.0;
+  getlist_worker            *workers;
   
   if ( getenv("URLTEST_GETLIST_USER") ) {
     http_ops_set_username(http_ops, getenv("URLTEST_GETLIST_USER"));
@@ -211,11 +1042,11 @@ main(
         exit(0);
       
       case 'd':
-        is_dry_run = true;
+        config.is_dry_run = true;
         break;
       
       case 'v':
-        is_verbose = true;
+        config.is_verbose = true;
         break;
       
       case 'V':
@@ -249,6 +1080,75 @@ main(
         break;
       }
       
+      case 'e': {
+        if ( optarg && *optarg ) {
+          char      *endp;
+          
+          progress_interval = strtod(optarg, &endp);
+          if ( (endp == optarg) || *endp || (progress_interval <= 0.0) ) {
+            fprintf(stderr, "ERROR:  invalid argument to --progress/-e:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --progress/-e option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'o': {
+        if ( optarg && *optarg ) {
+          trace_path = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --trace/-o option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'j': {
+        if ( optarg && *optarg ) {
+          snapshot_output = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --snapshot/-j option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'i': {
+        if ( optarg && *optarg ) {
+          char      *endp;
+          
+          series_interval = strtod(optarg, &endp);
+          if ( (endp == optarg) || (series_interval <= 0.0) || (*endp && (*endp != ':')) ) {
+            fprintf(stderr, "ERROR:  invalid time series specification: %s\n", optarg);
+            exit(EINVAL);
+          }
+          if ( *endp == ':' ) {
+            const char  *format = endp + 1;
+            const char  *colon = strchr(format, ':');
+            size_t      format_len = colon ? (size_t)(colon - format) : strlen(format);
+            
+            if ( (format_len > 0) && (strncasecmp(format, "table", format_len) == 0) ) {
+              series_format = http_stats_format_table;
+            } else if ( (format_len > 0) && (strncasecmp(format, "csv", format_len) == 0) ) {
+              series_format = http_stats_format_csv;
+            } else if ( (format_len > 0) && (strncasecmp(format, "tsv", format_len) == 0) ) {
+              series_format = http_stats_format_tsv;
+            } else {
+              fprintf(stderr, "ERROR:  invalid time series specification: %s\n", optarg);
+              exit(EINVAL);
+            }
+            if ( colon ) series_output = colon + 1;
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --time-series/-i option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
       case 'U': {
         if ( optarg && *optarg ) {
           char      *endp = optarg + strlen(optarg) - 1;
@@ -325,7 +1225,7 @@ main(
           long          value = strtol(optarg, &endp, 10);
           
           if ( (value >= 0) && (endp > optarg) ) {
-            retries = value;
+            config.retries = value;
           } else {
             fprintf(stderr, "ERROR:  invalid argument to --retries/-r:  %s\n", optarg);
             exit(EINVAL);
@@ -340,18 +1240,143 @@ main(
       case 'k':
         http_ops_set_ssl_verify_peer(http_ops, false);
         break;
+
+      case 'X': {
+        if ( optarg && *optarg ) {
+          if ( ! http_ops_set_unix_socket_path(http_ops, optarg) ) {
+            fprintf(stderr, "ERROR:  unable to set Unix domain socket path (errno = %d)\n", errno);
+            exit(errno);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --unix-socket/-X option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
         
       case 'f':
         should_follow_3xx = true;
         break;
       
+      case 'c': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          if ( (value >= 0) && (endp > optarg) ) {
+            config.concurrency = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --concurrency/-c:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --concurrency/-c option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'w': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          if ( (value > 0) && (endp > optarg) ) {
+            n_workers = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --workers/-w:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --workers/-w option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'R': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          double        value = strtod(optarg, &endp);
+          
+          if ( (value > 0.0) && (endp > optarg) ) {
+            config.rate = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --rate/-R:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --rate/-R option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'C': {
+        if ( optarg && *optarg ) {
+          coordinator_address = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --coordinator/-C option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'A': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          if ( (value > 0) && (endp > optarg) && (*endp == '\0') ) {
+            n_agents = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --agents/-A:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --agents/-A option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'G': {
+        if ( optarg && *optarg ) {
+          agent_address = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --agent/-G option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'S':
+      case 'W': {
+        if ( optarg && *optarg ) {
+          char                *endp;
+          unsigned long long  value = strtoull(optarg, &endp, 0);
+          
+          if ( (endp > optarg) && (*endp == '\0') ) {
+            if ( opt == 'S' ) seed = value; else worker_id = value;
+            should_shuffle = true;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to %s:  %s\n", (opt == 'S') ? "--seed/-S" : "--worker-id/-W", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with %s option\n", (opt == 'S') ? "--seed/-S" : "--worker-id/-W");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
     }
   }
   
   if ( base_url ) {
-    base_url_len = strlen(base_url);
-    does_base_url_have_terminal_slash = (base_url[base_url_len - 1] == '/') ? true : false;
-    if ( is_verbose ) printf("Will prepend '%s' to all URLs\n", base_url);
+    config.base_url = base_url;
+    config.base_url_len = strlen(base_url);
+    if ( config.is_verbose ) printf("Will prepend '%s' to all URLs\n", base_url);
   }
   
   //
@@ -360,145 +1385,243 @@ main(
   http_ops_set_should_follow_redirects(http_ops, should_follow_3xx);
   
   //
-  // All set, get the url_list open:
+  // All set, load the url_list (stdin if none was given):
   //
-  if ( url_list ) {
-    url_stream = fopen(url_list, "r");
-    if ( ! url_stream ) {
+  if ( agent_address ) {
+    coordinator_assignment  assignment;
+    void                    *assignment_payload = NULL;
+    
+    agent_fd = getlist_agent_join(agent_address, &assignment, &assignment_payload);
+    config.urls = url_list_create_with_text(assignment.urls, assignment.urls_len);
+    if ( ! config.urls ) {
+      fprintf(stderr, "ERROR:  unable to load url list from coordinator\n");
+      exit(ENOMEM);
+    }
+    should_shuffle = assignment.should_shuffle;
+    seed = assignment.seed;
+    worker_id = assignment.agent_id;
+    start_time = assignment.start_time;
+    config.report_interval = (assignment.report_interval > 0.0) ? assignment.report_interval : GETLIST_COORDINATOR_REPORT_INTERVAL;
+    if ( config.is_verbose ) printf("Agent %u of %u was assigned %u URLs\n", assignment.agent_id, assignment.n_agents, url_list_get_count(config.urls));
+    free(assignment_payload);
+  } else {
+    config.urls = url_list_create_with_path(url_list);
+    if ( ! config.urls ) {
       int   rc = errno;
       
-      fprintf(stderr, "ERROR:  unable to open url list `%s` for reading (errno = %d)\n", url_list, errno);
+      fprintf(stderr, "ERROR:  unable to read url list `%s` (errno = %d)\n", url_list ? url_list : "-", errno);
       exit(rc);
     }
   }
   
-  while ( (next_url = fgetln(url_stream, &next_url_len)) ) {
-    char            *target_url = NULL;
-    
-    //
-    // Drop any trailing whitespace:
-    //
-    while ( next_url_len && isspace(next_url[next_url_len - 1]) ) next_url_len--;
-      
-    //
-    // If there's a base url provided, append next_url to that:
-    //
-    if ( base_url ) {
-      int             need_slash = 0;
-      char            *target_url_ptr;
-      size_t          target_url_len;
+  //
+  // A coordinator hands the list out to its agents and reports their
+  // combined statistics:
+  //
+  if ( coordinator_address ) {
+    rc = getlist_coordinate(&config, coordinator_address, n_agents, should_shuffle, seed, (progress_interval > 0.0) ? progress_interval : GETLIST_COORDINATOR_REPORT_INTERVAL, aggr_stats);
+    if ( ! http_stats_is_empty(aggr_stats) ) {
+      int   timing_rc = getlist_show_timings(stats_format, timing_output, aggr_stats, NULL);
       
-      if ( does_base_url_have_terminal_slash ) {
-        //
-        // Remove leading slashes from next_url:
-        //
-        while ( next_url_len && (*next_url == '/') ) next_url++, next_url_len--;
-      } else {
-        //
-        // Do we need to prepend a slash?
-        //
-        if ( next_url_len && (*next_url != '/') ) need_slash = 1;
+      if ( timing_rc ) rc = timing_rc;
+      if ( snapshot_output && (timing_rc = getlist_write_snapshot(snapshot_output, aggr_stats)) ) rc = timing_rc;
+    }
+    url_list_destroy(config.urls);
+    http_stats_destroy(aggr_stats);
+    http_ops_destroy(http_ops);
+    return rc;
+  }
+  if ( should_shuffle ) {
+    prng_state      prng;
+    
+    prng_seed(&prng, seed, worker_id);
+    url_list_shuffle(config.urls, &prng);
+    if ( config.is_verbose ) printf("Shuffled %u URLs with seed %llu for worker id %llu\n", url_list_get_count(config.urls), (unsigned long long)seed, (unsigned long long)worker_id);
+  }
+  
+  //
+  // Open-loop mode needs the multi interface so requests can be issued
+  // while others are outstanding:
+  //
+  if ( config.rate > 0.0 ) {
+    if ( config.concurrency == 0 ) config.concurrency = 64;
+    if ( ! config.is_dry_run ) {
+      aggr_corrected_stats = http_stats_create();
+      if ( ! aggr_corrected_stats ) {
+        fprintf(stderr, "ERROR:  unable to allocate timing statistics\n");
+        exit(ENOMEM);
       }
-      //
-      // Allocate the target_url buffer:
-      //
-      target_url_len = base_url_len + need_slash + next_url_len + 1;
-      target_url = malloc(target_url_len);
-      if ( target_url ) {
-        char        *target_url_ptr = target_url;
-        
-        //
-        // Compile the base_url, possible slash, and next_url into
-        // the buffer:
-        //
-        target_url_ptr = stpncpy(target_url_ptr, base_url, base_url_len + 1);
-        if ( need_slash ) target_url_ptr = stpncpy(target_url_ptr, "/", 2);
-        stpncpy(target_url_ptr, next_url, next_url_len);
-        target_url_ptr[next_url_len] = '\0';
+    }
+  }
+  
+  //
+  // All workers add to the same trace:
+  //
+  if ( trace_path && ! config.is_dry_run ) {
+    if ( ! (config.trace = http_trace_create(trace_path, 0)) ) {
+      fprintf(stderr, "ERROR:  unable to create trace file %s (errno = %d)\n", trace_path, errno);
+      exit(errno);
+    }
+  }
+  
+  //
+  // All workers report to the same progress counters:
+  //
+  if ( progress_interval > 0.0 && ! config.is_dry_run ) {
+    if ( ! (progress = http_progress_create()) ) {
+      fprintf(stderr, "ERROR:  unable to allocate progress counters\n");
+      exit(ENOMEM);
+    }
+    http_ops_set_progress(http_ops, progress);
+  }
+  
+  //
+  // Spin-up the workers; each gets its own copy of the cURL setup and its
+  // own statistics, which are merged once everyone has finished:
+  //
+  config.n_workers = n_workers;
+  if ( series_interval > 0.0 && ! config.is_dry_run ) {
+    if ( ! (aggr_series = http_stats_series_create(monotonic_seconds(), series_interval, 0)) ) {
+      fprintf(stderr, "ERROR:  unable to allocate time series\n");
+      exit(ENOMEM);
+    }
+  }
+  workers = malloc(n_workers * sizeof(getlist_worker));
+  if ( ! workers ) {
+    fprintf(stderr, "ERROR:  unable to allocate %u workers\n", n_workers);
+    exit(ENOMEM);
+  }
+  for ( i_w = 0; i_w < n_workers; i_w++ ) {
+    memset(&workers[i_w], 0, sizeof(getlist_worker));
+    workers[i_w].worker_id = i_w;
+    workers[i_w].config = &config;
+    workers[i_w].http_ops = http_ops_create_copy(http_ops);
+    workers[i_w].stats = http_stats_create();
+    if ( ! workers[i_w].http_ops || ! workers[i_w].stats || ! http_stats_enable_histograms(workers[i_w].stats) ) {
+      fprintf(stderr, "ERROR:  unable to allocate worker %u\n", i_w);
+      exit(ENOMEM);
+    }
+    if ( aggr_corrected_stats ) {
+      workers[i_w].corrected_stats = http_stats_create();
+      if ( ! workers[i_w].corrected_stats || ! http_stats_enable_histograms(workers[i_w].corrected_stats) ) {
+        fprintf(stderr, "ERROR:  unable to allocate worker %u\n", i_w);
+        exit(ENOMEM);
       }
-    } else if ( next_url_len > 0 ) {
-      //
-      // Just duplicate next_url to target_url:
-      //
-      target_url = strndup(next_url, next_url_len);
     }
-    if ( target_url ) {
-      if ( is_dry_run ) {
-        printf("<- %s\n", target_url);
-      } else {
-        http_stats_record   req_stats;
-        http_stats_field    i_f;
-        long                http_status = -1;
-        int                 retry_count = 0;
-
-retry:
-        if ( http_ops_download(http_ops, target_url, NULL, aggr_stats, &req_stats, &http_status) ) {
-          if ( is_verbose ) {
-            bool            line_done = false;
-            
-            printf("T,%ld,\"%s\"", http_status, target_url);
-            for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) printf(",%lg", req_stats[i_f]);
-            
-            if ( (http_status / 100) == 3 ) {
-              CURL    *curl_handle = http_ops_curl_handle_for_request(http_ops, http_ops_curl_request_get);
-              
-              if ( curl_handle ) {
-                char    *url = NULL;
-                
-                curl_easy_getinfo(curl_handle, CURLINFO_REDIRECT_URL, &url);
-                if ( url ) {
-                  printf(",\"%s\"\n", url);
-                  line_done = true;
-                }
-              }
-            }
-            else if ( http_status == 200 ) {
-              CURL    *curl_handle = http_ops_curl_handle_for_request(http_ops, http_ops_curl_request_get);
-              
-              if ( curl_handle ) {
-                char    *url = NULL;
-                
-                curl_easy_getinfo(curl_handle, CURLINFO_CONTENT_TYPE, &url);
-                if ( url ) {
-                  printf(",\"%s\"\n", url);
-                  line_done = true;
-                }
-              }
-            }
-            if ( ! line_done ) printf(",\n");
-          }
-        } else {
-          if ( retry_count++ < retries ) goto retry;
-          printf("F,%ld,\"%s\"", 0L, target_url);
-          for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) printf(",0");
-          printf(",\"%s\"\n", http_ops_get_error_buffer(http_ops));
-        }
+    if ( aggr_series ) {
+      if ( ! (workers[i_w].series = http_stats_series_create_like(aggr_series)) ) {
+        fprintf(stderr, "ERROR:  unable to allocate worker %u\n", i_w);
+        exit(ENOMEM);
       }
-      free(target_url);
+      http_ops_set_stats_series(workers[i_w].http_ops, workers[i_w].series);
+    }
+  }
+  
+  //
+  // Agents all start at the coordinator's appointed time; the main thread
+  // is left free to pass the workers' statistics along:
+  //
+  if ( agent_fd >= 0 ) {
+    pthread_condattr_t  attrs;
+    
+    pthread_condattr_init(&attrs);
+    pthread_condattr_setclock(&attrs, CLOCK_MONOTONIC);
+    pthread_cond_init(&config.changed, &attrs);
+    pthread_condattr_destroy(&attrs);
+    pthread_mutex_init(&config.lock, NULL);
+    config.n_running = n_workers;
+    for ( i_w = 0; i_w < n_workers; i_w++ ) pthread_mutex_init(&workers[i_w].report_lock, NULL);
+    getlist_sleep_until(start_time);
+  }
+  config.t0 = monotonic_seconds();
+  if ( progress ) http_progress_reporter_start(progress, progress_interval, stderr);
+  if ( (n_workers == 1) && (agent_fd < 0) ) {
+    getlist_worker_run(&workers[0]);
+  } else {
+    for ( i_w = 0; i_w < n_workers; i_w++ ) {
+      if ( (rc = pthread_create(&workers[i_w].thread, NULL, getlist_worker_run, &workers[i_w])) != 0 ) {
+        fprintf(stderr, "ERROR:  unable to start worker %u (errno = %d)\n", i_w, rc);
+        exit(rc);
+      }
+    }
+    if ( agent_fd >= 0 ) getlist_agent_wait(&config, agent_fd, workers);
+    for ( i_w = 0; i_w < n_workers; i_w++ ) pthread_join(workers[i_w].thread, NULL);
+  }
+  if ( progress ) {
+    http_ops_set_progress(http_ops, NULL);
+    http_progress_destroy(progress);
+  }
+  if ( config.trace ) {
+    if ( http_trace_get_dropped(config.trace) > 0 ) {
+      fprintf(stderr, "WARNING:  %llu requests were not traced because the trace writer fell behind\n", http_trace_get_dropped(config.trace));
+    }
+    if ( ! http_trace_close(config.trace, url_list_get_count(config.urls), getlist_trace_url, config.urls) ) {
+      fprintf(stderr, "ERROR:  unable to write trace file %s\n", trace_path);
+      rc = EIO;
     }
+    config.trace = NULL;
   }
+  for ( i_w = 0; i_w < n_workers; i_w++ ) {
+    http_stats_merge(aggr_stats, workers[i_w].stats);
+    http_stats_destroy(workers[i_w].stats);
+    if ( workers[i_w].corrected_stats ) {
+      http_stats_merge(aggr_corrected_stats, workers[i_w].corrected_stats);
+      http_stats_destroy(workers[i_w].corrected_stats);
+    }
+    if ( workers[i_w].series ) {
+      http_stats_series_merge(aggr_series, workers[i_w].series);
+      http_stats_series_destroy(workers[i_w].series);
+    }
+    http_ops_destroy(workers[i_w].http_ops);
+    if ( workers[i_w].url_buffer ) free((void*)workers[i_w].url_buffer);
+    if ( agent_fd >= 0 ) {
+      if ( workers[i_w].report ) free(workers[i_w].report);
+      pthread_mutex_destroy(&workers[i_w].report_lock);
+    }
+  }
+  free((void*)workers);
   
-  if ( ! is_dry_run && should_show_timings ) {
-    if ( ! timing_output ) {
-      printf("Timing information:\n\n");
-      http_stats_print(stats_format, http_stats_print_flags_none, aggr_stats);
+  if ( agent_fd >= 0 ) {
+    getlist_agent_send(agent_fd, coordinator_msg_final, aggr_stats);
+    close(agent_fd);
+    pthread_cond_destroy(&config.changed);
+    pthread_mutex_destroy(&config.lock);
+  }
+  
+  if ( ! config.is_dry_run && should_show_timings ) {
+    int         timing_rc = getlist_show_timings(stats_format, timing_output, aggr_stats, aggr_corrected_stats);
+    
+    if ( timing_rc ) rc = timing_rc;
+  }
+  
+  if ( ! config.is_dry_run && snapshot_output ) {
+    int         snapshot_rc = getlist_write_snapshot(snapshot_output, aggr_stats);
+    
+    if ( snapshot_rc ) rc = snapshot_rc;
+  }
+  
+  if ( aggr_series ) {
+    if ( http_stats_series_get_dropped(aggr_series) > 0 ) {
+      fprintf(stderr, "WARNING:  %llu requests completed too early in the run to be kept in the time series\n", http_stats_series_get_dropped(aggr_series));
+    }
+    if ( ! series_output ) {
+      printf("%sTime series (%g s intervals):\n\n", (should_show_timings && ! timing_output) ? "\n" : "", series_interval);
+      http_stats_series_print(series_format, 0, aggr_series);
     } else {
-      FILE			*timing_fptr = fopen(timing_output, "w");
+      FILE      *series_fptr = fopen(series_output, "w");
       
-      if ( timing_fptr ) {
-        http_stats_fprint(timing_fptr, stats_format, http_stats_print_flags_none, aggr_stats);
-        fclose(timing_fptr);
+      if ( series_fptr ) {
+        http_stats_series_fprint(series_fptr, series_format, 0, aggr_series);
+        fclose(series_fptr);
       } else {
-        fprintf(stderr, "ERROR:  unable to open timing file for writing: %s\n", timing_output);
+        fprintf(stderr, "ERROR:  unable to open time series file for writing: %s\n", series_output);
         rc = errno;
       }
     }
+    http_stats_series_destroy(aggr_series);
   }
   
-  //
-  // Close the url_list we opened:
-  //
-  if ( url_list && (url_stream != stdin) ) fclose(url_stream);
+  url_list_destroy(config.urls);
   
   return rc;
 }
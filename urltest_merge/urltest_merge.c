@@ -0,0 +1,164 @@
+//
+//  urltest_merge.c
+//
+//  Combine the binary timing snapshots written by urltest_getlist --snapshot
+//  (e.g. one per node of a distributed run) and display the result.
+//
+//
+
+#include "config.h"
+
+#include <getopt.h>
+
+#include "http_stats.h"
+
+//
+
+static const struct option urltest_merge_options[] = {
+    { "help",             no_argument,          NULL,       'h' },
+    //
+    { "format",           required_argument,    NULL,       'f' },
+    { "snapshot",         required_argument,    NULL,       'j' },
+    { NULL,               0,                    NULL,        0  }
+  };
+
+static const char *urltest_merge_optstring = "h" "f:j:";
+
+//
+
+void
+usage(
+  char      *exe
+)
+{
+  printf(
+      "version %s\n"
+      "built " __DATE__ " " __TIME__ "\n"
+      "usage:\n\n"
+      "  %s {options} <snapshot file> {<snapshot file> ..}\n\n"
+      " options:\n\n"
+      "  --help/-h                    show this information\n"
+      "\n"
+      "  --format/-f <format>         how to display the combined statistics (default:\n"
+      "                               table)\n"
+      "\n"
+      "                                 <format> = table | csv | tsv\n"
+      "\n"
+      "  --snapshot/-j <path>         also write the combined statistics to <path> as a\n"
+      "                               snapshot, so it can itself be merged later\n"
+      "\n"
+      " Every snapshot in each file is merged:  counts and min/max combine directly,\n"
+      " means and variances by the pairwise update of the running moments, and\n"
+      " percentile histograms bucket by bucket, so the result is the same as if a\n"
+      " single process had seen every request.\n"
+      "\n"
+      ,
+      urltest_version_string,
+      exe
+    );
+}
+
+//
+
+int
+main(
+  int               argc,
+  char* const       *argv
+)
+{
+  int               rc = 0, opt;
+  http_stats_format stats_format = http_stats_format_table;
+  const char        *snapshot_output = NULL;
+  http_stats_ref    merged = http_stats_create();
+  unsigned int      n_snapshots = 0;
+
+  if ( ! merged ) {
+    fprintf(stderr, "ERROR:  unable to allocate statistics\n");
+    exit(ENOMEM);
+  }
+
+  while ( (opt = getopt_long(argc, argv, urltest_merge_optstring, urltest_merge_options, NULL)) != -1 ) {
+    switch ( opt ) {
+
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+
+      case 'f':
+        if ( optarg && *optarg ) {
+          if ( strcasecmp(optarg, "table") == 0 ) {
+            stats_format = http_stats_format_table;
+          } else if ( strcasecmp(optarg, "csv") == 0 ) {
+            stats_format = http_stats_format_csv;
+          } else if ( strcasecmp(optarg, "tsv") == 0 ) {
+            stats_format = http_stats_format_tsv;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --format/-f:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --format/-f option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'j':
+        if ( optarg && *optarg ) {
+          snapshot_output = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --snapshot/-j option\n");
+          exit(EINVAL);
+        }
+        break;
+
+    }
+  }
+
+  if ( optind >= argc ) {
+    usage(argv[0]);
+    exit(EINVAL);
+  }
+
+  while ( optind < argc ) {
+    FILE            *fptr = fopen(argv[optind], "rb");
+
+    if ( fptr ) {
+      unsigned int  n_in_file = 0;
+      int           status;
+
+      while ( (status = http_stats_fread_snapshot(fptr, merged)) > 0 ) n_in_file++;
+      if ( status < 0 ) {
+        fprintf(stderr, "ERROR:  invalid or incompatible snapshot in %s (after %u good snapshot%s)\n", argv[optind], n_in_file, (n_in_file == 1) ? "" : "s");
+        rc = EINVAL;
+      } else if ( n_in_file == 0 ) {
+        fprintf(stderr, "WARNING:  no snapshots in %s\n", argv[optind]);
+      }
+      n_snapshots += n_in_file;
+      fclose(fptr);
+    } else {
+      fprintf(stderr, "ERROR:  unable to open snapshot file %s (errno = %d)\n", argv[optind], errno);
+      rc = errno;
+    }
+    optind++;
+  }
+
+  if ( n_snapshots > 0 ) {
+    http_stats_print(stats_format, http_stats_get_has_histograms(merged) ? http_stats_print_flags_percentiles : http_stats_print_flags_none, merged);
+    if ( snapshot_output ) {
+      FILE          *snapshot_fptr = fopen(snapshot_output, "wb");
+
+      if ( snapshot_fptr ) {
+        if ( ! http_stats_fwrite_snapshot(snapshot_fptr, merged) ) {
+          fprintf(stderr, "ERROR:  unable to write snapshot: %s\n", snapshot_output);
+          rc = EIO;
+        }
+        fclose(snapshot_fptr);
+      } else {
+        fprintf(stderr, "ERROR:  unable to open snapshot for writing: %s\n", snapshot_output);
+        rc = errno;
+      }
+    }
+  }
+  http_stats_destroy(merged);
+  return rc;
+}
@@ -0,0 +1,1316 @@
+//
+//  urltest_stubd.c
+//
+//  A small single-threaded, event-driven HTTP/1.1 server that keeps
+//  WebDAV content in memory, for measuring the urltest clients (and
+//  liburltest) without a real web farm behind them.
+//
+//
+
+#include "config.h"
+
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "util_fns.h"
+
+//
+
+static const struct option urltest_stubd_options[] = {
+    { "help",             no_argument,          NULL,       'h' },
+    //
+    { "verbose",          no_argument,          NULL,       'v' },
+    //
+    { "listen",           required_argument,    NULL,       'l' },
+    { "unix-socket",      required_argument,    NULL,       'X' },
+    { "latency",          required_argument,    NULL,       'L' },
+    { "seed",             required_argument,    NULL,       'S' },
+    { "max-connections",  required_argument,    NULL,       'c' },
+    { NULL,               0,                    NULL,        0  }
+  };
+
+static const char *urltest_stubd_optstring = "h" "v" "l:X:L:S:c:";
+
+//
+
+void
+usage(
+  char      *exe
+)
+{
+  printf(
+      "version %s\n"
+      "built " __DATE__ " " __TIME__ "\n"
+      "usage:\n\n"
+      "  %s {options}\n\n"
+      " options:\n\n"
+      "  --help/-h                    show this information\n"
+      "\n"
+      "  --verbose/-v                 display each request to stdout as it is handled\n"
+      "\n"
+      "  --listen/-l <addr>           accept TCP connections on the given address\n"
+      "                               (default: 127.0.0.1:8080)\n"
+      "\n"
+      "                                 <addr> = {<host>:}<port>\n"
+      "\n"
+      "  --unix-socket/-X <path>      accept connections on a Unix domain socket at <path>\n"
+      "                               instead of TCP\n"
+      "  --latency/-L <delay>         hold each response for the given time before sending\n"
+      "                               it; other connections are served in the meantime\n"
+      "\n"
+      "                                 <delay> = <ms>{:<jitter ms>}\n"
+      "\n"
+      "                               a uniformly-distributed random amount up to <jitter ms>\n"
+      "                               is added to each delay\n"
+      "  --seed/-S <#>                seed for the latency jitter (default: 0)\n"
+      "  --max-connections/-c <#>     maximum number of simultaneous connections\n"
+      "                               (default: 1024)\n"
+      "\n"
+      " Content is kept in memory and discarded on exit; SIGINT or SIGTERM stops\n"
+      " the server and displays request counts and throughput to stderr.\n"
+      "\n"
+      ,
+      urltest_version_string,
+      exe
+    );
+}
+
+//
+// Bodies are reference-counted so a GET can send a resource's content while
+// a PUT replaces it:
+//
+
+typedef struct {
+  unsigned int          refcount;
+  size_t                length;
+  char                  bytes[];
+} stubd_blob;
+
+//
+
+stubd_blob*
+stubd_blob_create(
+  size_t                length
+)
+{
+  stubd_blob            *new_blob = malloc(sizeof(stubd_blob) + length);
+
+  if ( new_blob ) {
+    new_blob->refcount = 1;
+    new_blob->length = length;
+  }
+  return new_blob;
+}
+
+//
+
+stubd_blob*
+stubd_blob_retain(
+  stubd_blob            *blob
+)
+{
+  if ( blob ) blob->refcount++;
+  return blob;
+}
+
+//
+
+void
+stubd_blob_release(
+  stubd_blob            *blob
+)
+{
+  if ( blob && (--blob->refcount == 0) ) free((void*)blob);
+}
+
+//
+// The content store:  a hash table of resources keyed by path, with each
+// collection also linked to its children.  Paths are kept exactly as they
+// arrive (still percent-encoded), minus any trailing slash; the root is "/".
+//
+
+typedef struct _stubd_resource {
+  struct _stubd_resource  *hash_next;
+  struct _stubd_resource  *parent, *child, *prev_sibling, *next_sibling;
+  uint32_t                hash;
+  bool                    is_collection;
+  stubd_blob              *content;
+  time_t                  modified;
+  size_t                  path_len;
+  char                    path[];
+} stubd_resource;
+
+typedef struct {
+  stubd_resource          **buckets;
+  unsigned int            n_buckets, count;
+} stubd_store;
+
+//
+
+static inline uint32_t
+__stubd_path_hash(
+  const char              *path,
+  size_t                  path_len
+)
+{
+  uint32_t                h = 0x811C9DC5;
+
+  while ( path_len-- ) {
+    h ^= (uint8_t)*path++;
+    h *= 0x01000193;
+  }
+  return h;
+}
+
+//
+
+stubd_resource*
+stubd_store_lookup(
+  stubd_store             *store,
+  const char              *path,
+  size_t                  path_len
+)
+{
+  uint32_t                h = __stubd_path_hash(path, path_len);
+  stubd_resource          *r = store->buckets[h & (store->n_buckets - 1)];
+
+  while ( r ) {
+    if ( (r->hash == h) && (r->path_len == path_len) && (memcmp(r->path, path, path_len) == 0) ) return r;
+    r = r->hash_next;
+  }
+  return NULL;
+}
+
+//
+
+stubd_resource*
+stubd_store_insert(
+  stubd_store             *store,
+  stubd_resource          *parent,
+  const char              *path,
+  size_t                  path_len,
+  bool                    is_collection
+)
+{
+  stubd_resource          *new_resource;
+  unsigned int            i;
+
+  //
+  // Keep the chains short:
+  //
+  if ( store->count >= store->n_buckets ) {
+    unsigned int          new_n_buckets = 2 * store->n_buckets;
+    stubd_resource        **new_buckets = calloc(new_n_buckets, sizeof(stubd_resource*));
+
+    if ( new_buckets ) {
+      for ( i = 0; i < store->n_buckets; i++ ) {
+        stubd_resource    *r = store->buckets[i];
+
+        while ( r ) {
+          stubd_resource  *next = r->hash_next;
+
+          r->hash_next = new_buckets[r->hash & (new_n_buckets - 1)];
+          new_buckets[r->hash & (new_n_buckets - 1)] = r;
+          r = next;
+        }
+      }
+      free((void*)store->buckets);
+      store->buckets = new_buckets;
+      store->n_buckets = new_n_buckets;
+    }
+  }
+
+  if ( (new_resource = malloc(sizeof(stubd_resource) + path_len + 1)) ) {
+    memset(new_resource, 0, sizeof(stubd_resource));
+    new_resource->hash = __stubd_path_hash(path, path_len);
+    new_resource->is_collection = is_collection;
+    new_resource->modified = time(NULL);
+    new_resource->path_len = path_len;
+    memcpy(new_resource->path, path, path_len);
+    new_resource->path[path_len] = '\0';
+
+    i = new_resource->hash & (store->n_buckets - 1);
+    new_resource->hash_next = store->buckets[i];
+    store->buckets[i] = new_resource;
+    store->count++;
+
+    if ( (new_resource->parent = parent) ) {
+      new_resource->next_sibling = parent->child;
+      if ( parent->child ) parent->child->prev_sibling = new_resource;
+      parent->child = new_resource;
+      parent->modified = new_resource->modified;
+    }
+  }
+  return new_resource;
+}
+
+//
+
+void
+stubd_store_remove(
+  stubd_store             *store,
+  stubd_resource          *resource
+)
+{
+  stubd_resource          **link = &store->buckets[resource->hash & (store->n_buckets - 1)];
+
+  // WebDAV deletes collections recursively:
+  while ( resource->child ) stubd_store_remove(store, resource->child);
+
+  while ( *link != resource ) link = &(*link)->hash_next;
+  *link = resource->hash_next;
+  store->count--;
+
+  if ( resource->parent ) {
+    if ( resource->prev_sibling ) {
+      resource->prev_sibling->next_sibling = resource->next_sibling;
+    } else {
+      resource->parent->child = resource->next_sibling;
+    }
+    if ( resource->next_sibling ) resource->next_sibling->prev_sibling = resource->prev_sibling;
+    resource->parent->modified = time(NULL);
+  }
+  stubd_blob_release(resource->content);
+  free((void*)resource);
+}
+
+//
+
+bool
+stubd_store_init(
+  stubd_store             *store
+)
+{
+  store->n_buckets = 4096;
+  store->count = 0;
+  if ( ! (store->buckets = calloc(store->n_buckets, sizeof(stubd_resource*))) ) return false;
+  return (stubd_store_insert(store, NULL, "/", 1, true) != NULL);
+}
+
+//
+
+void
+stubd_store_destroy(
+  stubd_store             *store
+)
+{
+  stubd_resource          *root = stubd_store_lookup(store, "/", 1);
+
+  if ( root ) stubd_store_remove(store, root);
+  free((void*)store->buckets);
+}
+
+//
+// Requests and connections:
+//
+
+typedef enum {
+  stubd_method_get = 0,
+  stubd_method_head,
+  stubd_method_put,
+  stubd_method_delete,
+  stubd_method_mkcol,
+  stubd_method_propfind,
+  stubd_method_options,
+  stubd_method_other,
+  stubd_method_max
+} stubd_method;
+
+static const char *stubd_method_names[] = { "GET", "HEAD", "PUT", "DELETE", "MKCOL", "PROPFIND", "OPTIONS", "other" };
+
+typedef enum {
+  stubd_conn_state_header = 0,
+  stubd_conn_state_body,
+  stubd_conn_state_delay,
+  stubd_conn_state_write
+} stubd_conn_state;
+
+#define STUBD_MAX_HEADER_SIZE     65536
+#define STUBD_READ_SIZE           65536
+
+typedef struct {
+  int                     fd;
+  stubd_conn_state        state;
+
+  char                    *in;
+  size_t                  in_len, in_capacity;
+
+  stubd_method            method;
+  char                    *path;
+  size_t                  path_len;
+  bool                    is_keepalive;
+  int                     error_status;
+  bool                    expects_continue;
+  bool                    has_range;
+  long long               range_start, range_end;
+  int                     depth;
+  size_t                  content_length;
+  stubd_blob              *body;
+  size_t                  body_len;
+
+  double                  ready_at;
+  char                    out_header[1024];
+  size_t                  out_header_len, out_header_sent;
+  stubd_blob              *out_body;
+  size_t                  out_body_offset, out_body_len, out_body_sent;
+} stubd_conn;
+
+typedef struct {
+  stubd_store             store;
+  bool                    is_verbose;
+  double                  latency, jitter;
+  prng_state              prng;
+  unsigned long long      requests[stubd_method_max];
+  unsigned long long      bytes_in, bytes_out;
+} stubd_server;
+
+//
+
+void
+stubd_conn_reset_request(
+  stubd_conn              *conn
+)
+{
+  if ( conn->path ) free((void*)conn->path);
+  conn->path = NULL;
+  stubd_blob_release(conn->body);
+  conn->body = NULL;
+  stubd_blob_release(conn->out_body);
+  conn->out_body = NULL;
+  conn->error_status = 0;
+  conn->expects_continue = conn->has_range = false;
+  conn->content_length = conn->body_len = 0;
+  conn->depth = 1;
+  conn->out_header_len = conn->out_header_sent = 0;
+  conn->out_body_offset = conn->out_body_len = conn->out_body_sent = 0;
+  conn->state = stubd_conn_state_header;
+}
+
+//
+
+void
+stubd_conn_destroy(
+  stubd_conn              *conn
+)
+{
+  stubd_conn_reset_request(conn);
+  if ( conn->in ) free((void*)conn->in);
+  close(conn->fd);
+  free((void*)conn);
+}
+
+//
+// The request target is reduced to its path:  an absolute-form target loses its
+// scheme and authority, the query is dropped, and so is any trailing slash.
+//
+
+bool
+__stubd_conn_set_path(
+  stubd_conn              *conn,
+  const char              *target,
+  size_t                  target_len
+)
+{
+  const char              *end;
+
+  if ( (target_len > 7) && (strncasecmp(target, "http://", 7) == 0) ) {
+    const char            *slash = memchr(target + 7, '/', target_len - 7);
+
+    target_len -= slash ? (size_t)(slash - target) : target_len;
+    target = slash ? slash : "/";
+    if ( ! slash ) target_len = 1;
+  }
+  if ( (end = memchr(target, '?', target_len)) ) target_len = end - target;
+  if ( (end = memchr(target, '#', target_len)) ) target_len = end - target;
+  while ( (target_len > 1) && (target[target_len - 1] == '/') ) target_len--;
+  if ( ! target_len || (*target != '/') ) return false;
+
+  if ( ! (conn->path = malloc(target_len + 1)) ) return false;
+  memcpy(conn->path, target, target_len);
+  conn->path[target_len] = '\0';
+  conn->path_len = target_len;
+  return true;
+}
+
+//
+
+void
+__stubd_conn_parse_range(
+  stubd_conn              *conn,
+  const char              *value
+)
+{
+  char                    *endp;
+
+  //
+  // Only a single byte range is honored; anything else means the whole
+  // resource is sent, which RFC 7233 allows:
+  //
+  if ( strncasecmp(value, "bytes=", 6) != 0 ) return;
+  value += 6;
+  if ( strchr(value, ',') ) return;
+  if ( *value == '-' ) {
+    conn->range_start = -1;
+    conn->range_end = strtoll(value + 1, &endp, 10);
+    if ( endp == value + 1 ) return;
+  } else {
+    conn->range_start = strtoll(value, &endp, 10);
+    if ( (endp == value) || (*endp != '-') ) return;
+    value = endp + 1;
+    if ( isdigit(*value) ) {
+      conn->range_end = strtoll(value, &endp, 10);
+      if ( conn->range_end < conn->range_start ) return;
+    } else {
+      conn->range_end = -1;
+    }
+  }
+  conn->has_range = true;
+}
+
+//
+// Returns the header length once a complete header is present, zero if more
+// is needed:
+//
+
+size_t
+__stubd_conn_header_length(
+  stubd_conn              *conn
+)
+{
+  const char              *p = conn->in, *e = conn->in + conn->in_len;
+
+  while ( p < e ) {
+    const char            *eol = memchr(p, '\n', e - p);
+
+    if ( ! eol ) break;
+    if ( (eol == p) || ((eol == p + 1) && (*p == '\r')) ) return (eol + 1) - conn->in;
+    p = eol + 1;
+  }
+  return 0;
+}
+
+//
+
+void
+__stubd_conn_parse_header(
+  stubd_conn              *conn,
+  size_t                  header_len
+)
+{
+  char                    *p = conn->in, *e = conn->in + header_len;
+  char                    *eol = memchr(p, '\n', e - p);
+  char                    *sp1, *sp2;
+  bool                    is_http_1_0;
+
+  //
+  // Request line:
+  //
+  *eol = '\0';
+  if ( (eol > p) && (*(eol - 1) == '\r') ) *(eol - 1) = '\0';
+  sp1 = strchr(p, ' ');
+  sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+  if ( ! sp1 || ! sp2 ) {
+    conn->error_status = 400;
+    conn->is_keepalive = false;
+    return;
+  }
+  *sp1 = *sp2 = '\0';
+  for ( conn->method = stubd_method_get; conn->method < stubd_method_other; conn->method++ ) {
+    if ( strcmp(p, stubd_method_names[conn->method]) == 0 ) break;
+  }
+  if ( ! __stubd_conn_set_path(conn, sp1 + 1, sp2 - (sp1 + 1)) ) conn->error_status = 400;
+  is_http_1_0 = (strcmp(sp2 + 1, "HTTP/1.0") == 0);
+  conn->is_keepalive = ! is_http_1_0;
+
+  //
+  // Headers we care about:
+  //
+  p = eol + 1;
+  while ( p < e ) {
+    char                  *value;
+
+    eol = memchr(p, '\n', e - p);
+    *eol = '\0';
+    if ( (eol > p) && (*(eol - 1) == '\r') ) *(eol - 1) = '\0';
+    if ( (value = strchr(p, ':')) ) {
+      *value++ = '\0';
+      while ( (*value == ' ') || (*value == '\t') ) value++;
+      if ( strcasecmp(p, "Content-Length") == 0 ) {
+        conn->content_length = strtoull(value, NULL, 10);
+      } else if ( strcasecmp(p, "Connection") == 0 ) {
+        if ( strcasecmp(value, "close") == 0 ) conn->is_keepalive = false;
+        else if ( strcasecmp(value, "keep-alive") == 0 ) conn->is_keepalive = true;
+      } else if ( strcasecmp(p, "Transfer-Encoding") == 0 ) {
+        // Bodies must come with a Content-Length:
+        conn->error_status = 411;
+        conn->is_keepalive = false;
+      } else if ( strcasecmp(p, "Range") == 0 ) {
+        __stubd_conn_parse_range(conn, value);
+      } else if ( strcasecmp(p, "Depth") == 0 ) {
+        conn->depth = (*value == '0') ? 0 : 1;
+      } else if ( strcasecmp(p, "Expect") == 0 ) {
+        conn->expects_continue = ((strcasecmp(value, "100-continue") == 0) && ! is_http_1_0);
+      }
+    }
+    p = eol + 1;
+  }
+}
+
+//
+
+void
+__stubd_conn_respond(
+  stubd_conn              *conn,
+  int                     status,
+  const char              *reason,
+  const char              *extra_headers,
+  stubd_blob              *body,
+  size_t                  body_offset,
+  size_t                  body_len
+)
+{
+  conn->out_header_len = snprintf(conn->out_header, sizeof(conn->out_header),
+                              "HTTP/1.1 %d %s\r\n"
+                              "Server: urltest_stubd/%s\r\n"
+                              "Content-Length: %llu\r\n"
+                              "%s"
+                              "%s"
+                              "\r\n",
+                              status, reason,
+                              urltest_version_string,
+                              (unsigned long long)body_len,
+                              extra_headers ? extra_headers : "",
+                              conn->is_keepalive ? "" : "Connection: close\r\n"
+                            );
+  if ( conn->out_header_len >= sizeof(conn->out_header) ) conn->out_header_len = sizeof(conn->out_header) - 1;
+  if ( conn->method == stubd_method_head ) body_len = 0;
+  conn->out_body = body_len ? stubd_blob_retain(body) : NULL;
+  conn->out_body_offset = body_offset;
+  conn->out_body_len = body_len;
+}
+
+//
+
+void
+__stubd_format_http_date(
+  time_t                  t,
+  char                    *buffer,
+  size_t                  buffer_size
+)
+{
+  struct tm               tm_utc;
+
+  gmtime_r(&t, &tm_utc);
+  strftime(buffer, buffer_size, "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+}
+
+//
+
+bool
+__stubd_propfind_append(
+  char*                   *xml,
+  size_t                  *xml_len,
+  size_t                  *xml_capacity,
+  stubd_resource          *r
+)
+{
+  char                    date[64];
+  size_t                  need = r->path_len + 512;
+
+  if ( *xml_len + need > *xml_capacity ) {
+    size_t                new_capacity = *xml_capacity ? 2 * *xml_capacity : 4096;
+    char                  *new_xml;
+
+    while ( *xml_len + need > new_capacity ) new_capacity *= 2;
+    if ( ! (new_xml = realloc(*xml, new_capacity)) ) return false;
+    *xml = new_xml;
+    *xml_capacity = new_capacity;
+  }
+  __stubd_format_http_date(r->modified, date, sizeof(date));
+  *xml_len += snprintf(*xml + *xml_len, *xml_capacity - *xml_len,
+                  "<D:response><D:href>%s%s</D:href><D:propstat><D:prop>"
+                  "<D:resourcetype>%s</D:resourcetype>"
+                  "<D:getcontentlength>%llu</D:getcontentlength>"
+                  "<D:getlastmodified>%s</D:getlastmodified>"
+                  "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n",
+                  r->path, (r->is_collection && (r->path_len > 1)) ? "/" : "",
+                  r->is_collection ? "<D:collection/>" : "",
+                  (unsigned long long)(r->content ? r->content->length : 0),
+                  date
+                );
+  return true;
+}
+
+//
+
+void
+stubd_conn_handle_request(
+  stubd_server            *server,
+  stubd_conn              *conn
+)
+{
+  stubd_store             *store = &server->store;
+  stubd_resource          *r = NULL, *parent = NULL;
+
+  server->requests[conn->method]++;
+  server->bytes_in += conn->body_len;
+  if ( server->is_verbose ) printf("%s %s\n", stubd_method_names[conn->method], conn->path ? conn->path : "?");
+
+  if ( conn->error_status ) {
+    conn->is_keepalive = false;
+    if ( conn->error_status == 411 ) {
+      __stubd_conn_respond(conn, 411, "Length Required", NULL, NULL, 0, 0);
+    } else {
+      __stubd_conn_respond(conn, 400, "Bad Request", NULL, NULL, 0, 0);
+    }
+    return;
+  }
+
+  r = stubd_store_lookup(store, conn->path, conn->path_len);
+  if ( ! r && (conn->path_len > 1) ) {
+    const char            *slash = conn->path + conn->path_len - 1;
+
+    while ( *slash != '/' ) slash--;
+    parent = stubd_store_lookup(store, conn->path, (slash == conn->path) ? 1 : (slash - conn->path));
+  }
+
+  switch ( conn->method ) {
+
+    case stubd_method_get:
+    case stubd_method_head: {
+      if ( ! r ) {
+        __stubd_conn_respond(conn, 404, "Not Found", NULL, NULL, 0, 0);
+      } else if ( r->is_collection ) {
+        //
+        // A plain list of the collection's members:
+        //
+        stubd_resource    *child = r->child;
+        size_t            listing_len = 0;
+        stubd_blob        *listing;
+
+        while ( child ) {
+          listing_len += child->path_len - (r->path_len > 1 ? r->path_len : 0) + (child->is_collection ? 1 : 0);
+          child = child->next_sibling;
+        }
+        if ( (listing = stubd_blob_create(listing_len)) ) {
+          char            *p = listing->bytes;
+
+          for ( child = r->child; child; child = child->next_sibling ) {
+            size_t        skip = (r->path_len > 1 ? r->path_len : 0) + 1;
+
+            memcpy(p, child->path + skip, child->path_len - skip);
+            p += child->path_len - skip;
+            if ( child->is_collection ) *p++ = '/';
+            *p++ = '\n';
+          }
+          __stubd_conn_respond(conn, 200, "OK", "Content-Type: text/plain\r\n", listing, 0, listing_len);
+          stubd_blob_release(listing);
+        } else {
+          __stubd_conn_respond(conn, 507, "Insufficient Storage", NULL, NULL, 0, 0);
+        }
+      } else {
+        size_t            length = r->content ? r->content->length : 0;
+
+        if ( conn->has_range ) {
+          long long       s = conn->range_start, e = conn->range_end;
+
+          if ( s < 0 ) {
+            // Suffix range, the last e bytes:
+            s = (e >= (long long)length) ? 0 : (long long)length - e;
+            e = (long long)length - 1;
+          } else if ( (e < 0) || (e >= (long long)length) ) {
+            e = (long long)length - 1;
+          }
+          if ( (s >= (long long)length) || (e < s) ) {
+            char          content_range[64];
+
+            snprintf(content_range, sizeof(content_range), "Content-Range: bytes */%llu\r\n", (unsigned long long)length);
+            __stubd_conn_respond(conn, 416, "Range Not Satisfiable", content_range, NULL, 0, 0);
+          } else {
+            char          content_range[128];
+
+            snprintf(content_range, sizeof(content_range), "Content-Range: bytes %lld-%lld/%llu\r\n", s, e, (unsigned long long)length);
+            __stubd_conn_respond(conn, 206, "Partial Content", content_range, r->content, s, e - s + 1);
+          }
+        } else {
+          __stubd_conn_respond(conn, 200, "OK", "Accept-Ranges: bytes\r\n", r->content, 0, length);
+        }
+      }
+      break;
+    }
+
+    case stubd_method_put: {
+      if ( r && r->is_collection ) {
+        __stubd_conn_respond(conn, 405, "Method Not Allowed", NULL, NULL, 0, 0);
+      } else if ( ! r && (! parent || ! parent->is_collection) ) {
+        __stubd_conn_respond(conn, 409, "Conflict", NULL, NULL, 0, 0);
+      } else {
+        bool              is_new = (r == NULL);
+
+        if ( is_new && ! (r = stubd_store_insert(store, parent, conn->path, conn->path_len, false)) ) {
+          __stubd_conn_respond(conn, 507, "Insufficient Storage", NULL, NULL, 0, 0);
+          break;
+        }
+        stubd_blob_release(r->content);
+        r->content = conn->body;
+        conn->body = NULL;
+        r->modified = time(NULL);
+        if ( is_new ) {
+          __stubd_conn_respond(conn, 201, "Created", NULL, NULL, 0, 0);
+        } else {
+          __stubd_conn_respond(conn, 204, "No Content", NULL, NULL, 0, 0);
+        }
+      }
+      break;
+    }
+
+    case stubd_method_mkcol: {
+      if ( r ) {
+        __stubd_conn_respond(conn, 405, "Method Not Allowed", NULL, NULL, 0, 0);
+      } else if ( conn->body_len ) {
+        __stubd_conn_respond(conn, 415, "Unsupported Media Type", NULL, NULL, 0, 0);
+      } else if ( ! parent || ! parent->is_collection ) {
+        __stubd_conn_respond(conn, 409, "Conflict", NULL, NULL, 0, 0);
+      } else if ( ! stubd_store_insert(store, parent, conn->path, conn->path_len, true) ) {
+        __stubd_conn_respond(conn, 507, "Insufficient Storage", NULL, NULL, 0, 0);
+      } else {
+        __stubd_conn_respond(conn, 201, "Created", NULL, NULL, 0, 0);
+      }
+      break;
+    }
+
+    case stubd_method_delete: {
+      if ( ! r ) {
+        __stubd_conn_respond(conn, 404, "Not Found", NULL, NULL, 0, 0);
+      } else if ( ! r->parent ) {
+        __stubd_conn_respond(conn, 403, "Forbidden", NULL, NULL, 0, 0);
+      } else {
+        stubd_store_remove(store, r);
+        __stubd_conn_respond(conn, 204, "No Content", NULL, NULL, 0, 0);
+      }
+      break;
+    }
+
+    case stubd_method_propfind: {
+      if ( ! r ) {
+        __stubd_conn_respond(conn, 404, "Not Found", NULL, NULL, 0, 0);
+      } else {
+        static const char *xml_head = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<D:multistatus xmlns:D=\"DAV:\">\n";
+        static const char *xml_tail = "</D:multistatus>\n";
+        char              *xml = NULL;
+        size_t            xml_len = 0, xml_capacity = 0;
+        bool              ok = __stubd_propfind_append(&xml, &xml_len, &xml_capacity, r);
+        stubd_blob        *response = NULL;
+
+        if ( ok && r->is_collection && (conn->depth > 0) ) {
+          stubd_resource  *child;
+
+          for ( child = r->child; ok && child; child = child->next_sibling ) ok = __stubd_propfind_append(&xml, &xml_len, &xml_capacity, child);
+        }
+        if ( ok && (response = stubd_blob_create(strlen(xml_head) + xml_len + strlen(xml_tail))) ) {
+          memcpy(response->bytes, xml_head, strlen(xml_head));
+          memcpy(response->bytes + strlen(xml_head), xml, xml_len);
+          memcpy(response->bytes + strlen(xml_head) + xml_len, xml_tail, strlen(xml_tail));
+          __stubd_conn_respond(conn, 207, "Multi-Status", "Content-Type: application/xml; charset=utf-8\r\n", response, 0, response->length);
+          stubd_blob_release(response);
+        } else {
+          __stubd_conn_respond(conn, 507, "Insufficient Storage", NULL, NULL, 0, 0);
+        }
+        if ( xml ) free((void*)xml);
+      }
+      break;
+    }
+
+    case stubd_method_options: {
+      __stubd_conn_respond(conn, 200, "OK", "Allow: OPTIONS, GET, HEAD, PUT, DELETE, MKCOL, PROPFIND\r\nDAV: 1\r\n", NULL, 0, 0);
+      break;
+    }
+
+    case stubd_method_other:
+    case stubd_method_max: {
+      __stubd_conn_respond(conn, 501, "Not Implemented", NULL, NULL, 0, 0);
+      break;
+    }
+
+  }
+}
+
+//
+// Move a connection along as far as it can go without blocking; returns false
+// once it should be closed.
+//
+
+bool
+stubd_conn_process(
+  stubd_server            *server,
+  stubd_conn              *conn,
+  bool                    is_readable
+)
+{
+  while ( true ) {
+    switch ( conn->state ) {
+
+      case stubd_conn_state_header: {
+        size_t            header_len = __stubd_conn_header_length(conn);
+
+        if ( ! header_len ) {
+          ssize_t         n_read;
+
+          if ( conn->in_len >= STUBD_MAX_HEADER_SIZE ) return false;
+          if ( ! is_readable ) return true;
+          if ( conn->in_capacity - conn->in_len < STUBD_READ_SIZE ) {
+            size_t        new_capacity = conn->in_len + STUBD_READ_SIZE;
+            char          *new_in = realloc(conn->in, new_capacity);
+
+            if ( ! new_in ) return false;
+            conn->in = new_in;
+            conn->in_capacity = new_capacity;
+          }
+          n_read = read(conn->fd, conn->in + conn->in_len, conn->in_capacity - conn->in_len);
+          if ( n_read == 0 ) return false;
+          if ( n_read < 0 ) return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR));
+          conn->in_len += n_read;
+
+          // Only one read per wakeup, so a busy connection can't starve the rest:
+          is_readable = false;
+          break;
+        }
+        __stubd_conn_parse_header(conn, header_len);
+
+        //
+        // Whatever followed the header belongs to the body (and possibly the next
+        // request):
+        //
+        if ( conn->content_length && ! conn->error_status ) {
+          size_t          have = conn->in_len - header_len;
+
+          if ( ! (conn->body = stubd_blob_create(conn->content_length)) ) return false;
+          if ( have > conn->content_length ) have = conn->content_length;
+          memcpy(conn->body->bytes, conn->in + header_len, have);
+          conn->body_len = have;
+          header_len += have;
+
+          if ( conn->expects_continue && (have < conn->content_length) ) {
+            static const char *continue_response = "HTTP/1.1 100 Continue\r\n\r\n";
+
+            //
+            // Nothing else is outstanding on the connection at this point, so
+            // the socket buffer has room for it:
+            //
+            if ( send(conn->fd, continue_response, strlen(continue_response), 0) < 0 ) return false;
+          }
+        }
+        memmove(conn->in, conn->in + header_len, conn->in_len - header_len);
+        conn->in_len -= header_len;
+        conn->state = stubd_conn_state_body;
+        break;
+      }
+
+      case stubd_conn_state_body: {
+        if ( conn->body && (conn->body_len < conn->content_length) ) {
+          ssize_t         n_read;
+
+          if ( ! is_readable ) return true;
+          n_read = read(conn->fd, conn->body->bytes + conn->body_len, conn->content_length - conn->body_len);
+          if ( n_read == 0 ) return false;
+          if ( n_read < 0 ) return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR));
+          conn->body_len += n_read;
+          is_readable = false;
+          break;
+        }
+        stubd_conn_handle_request(server, conn);
+        stubd_blob_release(conn->body);
+        conn->body = NULL;
+
+        //
+        // Hold the response for the injected latency:
+        //
+        if ( (server->latency > 0.0) || (server->jitter > 0.0) ) {
+          double          delay = server->latency;
+
+          if ( server->jitter > 0.0 ) delay += server->jitter * ((double)(prng_next(&server->prng) >> 11) / 9007199254740992.0);
+          conn->ready_at = monotonic_seconds() + delay;
+          conn->state = stubd_conn_state_delay;
+        } else {
+          conn->state = stubd_conn_state_write;
+        }
+        break;
+      }
+
+      case stubd_conn_state_delay: {
+        if ( monotonic_seconds() < conn->ready_at ) return true;
+        conn->state = stubd_conn_state_write;
+        break;
+      }
+
+      case stubd_conn_state_write: {
+        struct iovec      iov[2];
+        int               n_iov = 0;
+        ssize_t           n_written;
+
+        if ( conn->out_header_sent < conn->out_header_len ) {
+          iov[n_iov].iov_base = conn->out_header + conn->out_header_sent;
+          iov[n_iov++].iov_len = conn->out_header_len - conn->out_header_sent;
+        }
+        if ( conn->out_body_sent < conn->out_body_len ) {
+          iov[n_iov].iov_base = conn->out_body->bytes + conn->out_body_offset + conn->out_body_sent;
+          iov[n_iov++].iov_len = conn->out_body_len - conn->out_body_sent;
+        }
+        if ( n_iov == 0 ) {
+          server->bytes_out += conn->out_body_len;
+          if ( ! conn->is_keepalive ) return false;
+          stubd_conn_reset_request(conn);
+          break;
+        }
+        n_written = writev(conn->fd, iov, n_iov);
+        if ( n_written < 0 ) return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR));
+        if ( conn->out_header_sent < conn->out_header_len ) {
+          size_t          n = conn->out_header_len - conn->out_header_sent;
+
+          if ( (size_t)n_written < n ) n = n_written;
+          conn->out_header_sent += n;
+          n_written -= n;
+        }
+        conn->out_body_sent += n_written;
+        if ( (conn->out_header_sent < conn->out_header_len) || (conn->out_body_sent < conn->out_body_len) ) return true;
+        break;
+      }
+
+    }
+  }
+}
+
+//
+
+int
+stubd_listen_tcp(
+  const char              *address
+)
+{
+  const char              *port;
+  char                    *host = split_host_port(address, &port);
+  struct addrinfo         hints, *addrs = NULL, *a;
+  int                     fd = -1, rc;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if ( (rc = getaddrinfo((host && *host) ? host : "127.0.0.1", port, &hints, &addrs)) != 0 ) {
+    fprintf(stderr, "ERROR:  unable to resolve listen address %s:  %s\n", address, gai_strerror(rc));
+    exit(EINVAL);
+  }
+  for ( a = addrs; a; a = a->ai_next ) {
+    int                   on = 1;
+
+    if ( (fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol)) < 0 ) continue;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if ( (bind(fd, a->ai_addr, a->ai_addrlen) == 0) && (listen(fd, 1024) == 0) ) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  if ( host ) free((void*)host);
+  return fd;
+}
+
+//
+
+int
+stubd_listen_unix(
+  const char              *path
+)
+{
+  struct sockaddr_un      addr;
+  int                     fd;
+
+  if ( strlen(path) >= sizeof(addr.sun_path) ) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  // A socket left behind by an earlier run would make bind() fail:
+  unlink(path);
+  if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ) return -1;
+  if ( (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(fd, 1024) != 0) ) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+//
+
+static volatile sig_atomic_t stubd_should_exit = 0;
+
+void
+stubd_signal_handler(
+  int                     signum
+)
+{
+  (void)signum;
+  stubd_should_exit = 1;
+}
+
+//
+
+int
+main(
+  int                     argc,
+  char* const             *argv
+)
+{
+  int                     opt, listen_fd;
+  const char              *listen_address = "127.0.0.1:8080";
+  const char              *unix_socket_path = NULL;
+  unsigned int            max_connections = 1024;
+  unsigned long long      seed = 0;
+  stubd_server            server;
+  stubd_conn              **conns;
+  struct pollfd           *pollfds;
+  unsigned int            n_conns = 0, i;
+  double                  start_time;
+  unsigned long long      total_requests = 0;
+  stubd_method            m;
+
+  memset(&server, 0, sizeof(server));
+
+  optind = 0;
+  while ( (opt = getopt_long(argc, argv, urltest_stubd_optstring, urltest_stubd_options, NULL)) != -1 ) {
+    switch ( opt ) {
+
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+
+      case 'v':
+        server.is_verbose = true;
+        break;
+
+      case 'l':
+        if ( optarg && *optarg ) {
+          listen_address = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --listen/-l option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'X':
+        if ( optarg && *optarg ) {
+          unix_socket_path = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --unix-socket/-X option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'L': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          double        latency = strtod(optarg, &endp), jitter = 0.0;
+
+          if ( (endp > optarg) && (*endp == ':') ) {
+            char        *s = endp + 1;
+
+            jitter = strtod(s, &endp);
+            if ( endp == s ) endp = optarg;
+          }
+          if ( (endp == optarg) || (*endp != '\0') || (latency < 0.0) || (jitter < 0.0) ) {
+            fprintf(stderr, "ERROR:  invalid argument to --latency/-L:  %s\n", optarg);
+            exit(EINVAL);
+          }
+          server.latency = latency / 1000.0;
+          server.jitter = jitter / 1000.0;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --latency/-L option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+      case 'S': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+
+          seed = strtoull(optarg, &endp, 0);
+          if ( (endp == optarg) || (*endp != '\0') ) {
+            fprintf(stderr, "ERROR:  invalid argument to --seed/-S:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --seed/-S option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+      case 'c': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+
+          if ( (value > 0) && (endp > optarg) && (*endp == '\0') ) {
+            max_connections = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --max-connections/-c:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --max-connections/-c option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+
+    }
+  }
+
+  if ( ! stubd_store_init(&server.store) ) {
+    fprintf(stderr, "ERROR:  unable to allocate content store\n");
+    exit(ENOMEM);
+  }
+  prng_seed(&server.prng, seed, 0);
+
+  conns = calloc(max_connections, sizeof(stubd_conn*));
+  pollfds = calloc(max_connections + 1, sizeof(struct pollfd));
+  if ( ! conns || ! pollfds ) {
+    fprintf(stderr, "ERROR:  unable to allocate %u connections\n", max_connections);
+    exit(ENOMEM);
+  }
+
+  listen_fd = unix_socket_path ? stubd_listen_unix(unix_socket_path) : stubd_listen_tcp(listen_address);
+  if ( listen_fd < 0 ) {
+    fprintf(stderr, "ERROR:  unable to listen on %s (errno = %d)\n", unix_socket_path ? unix_socket_path : listen_address, errno);
+    exit(errno ? errno : EINVAL);
+  }
+  fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stubd_signal_handler);
+  signal(SIGTERM, stubd_signal_handler);
+
+  printf("Listening on %s\n", unix_socket_path ? unix_socket_path : listen_address);
+  fflush(stdout);
+  start_time = monotonic_seconds();
+
+  while ( ! stubd_should_exit ) {
+    int                   timeout = -1, n_ready;
+    double                now = monotonic_seconds();
+
+    //
+    // Connections holding a delayed response don't need polling, but they
+    // do bound how long we sleep:
+    //
+    pollfds[0].fd = (n_conns < max_connections) ? listen_fd : -1;
+    pollfds[0].events = POLLIN;
+    for ( i = 0; i < n_conns; i++ ) {
+      pollfds[i + 1].fd = conns[i]->fd;
+      switch ( conns[i]->state ) {
+        case stubd_conn_state_header:
+        case stubd_conn_state_body:
+          pollfds[i + 1].events = POLLIN;
+          break;
+        case stubd_conn_state_write:
+          pollfds[i + 1].events = POLLOUT;
+          break;
+        case stubd_conn_state_delay: {
+          int             ms = (int)ceil((conns[i]->ready_at - now) * 1000.0);
+
+          if ( ms < 0 ) ms = 0;
+          if ( (timeout < 0) || (ms < timeout) ) timeout = ms;
+          pollfds[i + 1].events = 0;
+          break;
+        }
+      }
+      pollfds[i + 1].revents = 0;
+    }
+    pollfds[0].revents = 0;
+
+    n_ready = poll(pollfds, n_conns + 1, timeout);
+    if ( n_ready < 0 ) {
+      if ( errno == EINTR ) continue;
+      fprintf(stderr, "ERROR:  poll() failed (errno = %d)\n", errno);
+      break;
+    }
+
+    //
+    // Service existing connections first; closed ones are swapped out of the
+    // array (walking it backwards keeps the poll results lined up):
+    //
+    i = n_conns;
+    while ( i-- > 0 ) {
+      stubd_conn          *conn = conns[i];
+      short               revents = pollfds[i + 1].revents;
+      bool                keep = true;
+
+      if ( revents & (POLLERR | POLLNVAL) ) {
+        keep = false;
+      } else if ( revents || (conn->state == stubd_conn_state_delay) ) {
+        keep = stubd_conn_process(&server, conn, (revents & (POLLIN | POLLHUP)) != 0);
+      }
+      if ( ! keep ) {
+        stubd_conn_destroy(conn);
+        conns[i] = conns[--n_conns];
+      }
+    }
+
+    if ( pollfds[0].revents & POLLIN ) {
+      int                 fd;
+
+      while ( (n_conns < max_connections) && ((fd = accept(listen_fd, NULL, NULL)) >= 0) ) {
+        stubd_conn        *conn = calloc(1, sizeof(stubd_conn));
+        int               on = 1;
+
+        if ( ! conn ) {
+          close(fd);
+          break;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if ( ! unix_socket_path ) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        conn->fd = fd;
+        conn->depth = 1;
+        conns[n_conns++] = conn;
+      }
+    }
+  }
+
+  //
+  // Summary:
+  //
+  {
+    double                elapsed = monotonic_seconds() - start_time;
+
+    for ( m = stubd_method_get; m < stubd_method_max; m++ ) total_requests += server.requests[m];
+    fprintf(stderr, "\n%llu requests in %.3f s (%.1f/s)\n", total_requests, elapsed, elapsed > 0.0 ? total_requests / elapsed : 0.0);
+    for ( m = stubd_method_get; m < stubd_method_max; m++ ) {
+      if ( server.requests[m] ) fprintf(stderr, "  %-10s %llu\n", stubd_method_names[m], server.requests[m]);
+    }
+    fprintf(stderr, "%llu bytes received (%.1f MiB/s), %llu bytes sent (%.1f MiB/s)\n",
+        server.bytes_in, elapsed > 0.0 ? server.bytes_in / elapsed / 1048576.0 : 0.0,
+        server.bytes_out, elapsed > 0.0 ? server.bytes_out / elapsed / 1048576.0 : 0.0
+      );
+    fprintf(stderr, "%u resources stored\n", server.store.count);
+  }
+
+  for ( i = 0; i < n_conns; i++ ) stubd_conn_destroy(conns[i]);
+  free((void*)conns);
+  free((void*)pollfds);
+  stubd_store_destroy(&server.store);
+  close(listen_fd);
+  if ( unix_socket_path ) unlink(unix_socket_path);
+  return 0;
+}
@@ -0,0 +1,323 @@
+//
+//  urltest_trace.c
+//
+//  Convert the binary per-request trace files written by --trace/-o to
+//  CSV or TSV.
+//
+//
+
+#include "config.h"
+
+#include <getopt.h>
+
+#include "util_fns.h"
+#include "http_ops.h"
+#include "http_stats.h"
+#include "http_trace.h"
+
+//
+
+static const struct option urltest_trace_options[] = {
+    { "help",             no_argument,          NULL,       'h' },
+    //
+    { "format",           required_argument,    NULL,       'f' },
+    { "no-header",        no_argument,          NULL,       'n' },
+    { NULL,               0,                    NULL,        0  }
+  };
+
+static const char *urltest_trace_optstring = "h" "f:n";
+
+//
+
+void
+usage(
+  char      *exe
+)
+{
+  printf(
+      "version %s\n"
+      "built " __DATE__ " " __TIME__ "\n"
+      "usage:\n\n"
+      "  %s {options} <trace file> {<trace file> ..}\n\n"
+      " options:\n\n"
+      "  --help/-h                    show this information\n"
+      "\n"
+      "  --format/-f <format>         how to display the requests (default: csv)\n"
+      "\n"
+      "                                 <format> = csv | tsv\n"
+      "\n"
+      "  --no-header/-n               do not display the column headings\n"
+      "\n"
+      " Each request is displayed as one row:  the wall-clock time it completed\n"
+      " (seconds since the epoch), its URL, method and HTTP status (0 if the request\n"
+      " failed outright) and its timings.  The rows of several trace files follow\n"
+      " one another under a single heading.\n"
+      "\n"
+      ,
+      urltest_version_string,
+      exe
+    );
+}
+
+//
+
+typedef struct {
+  const char    *url;
+  uint32_t      length;
+} trace_url;
+
+typedef struct {
+  char          delim;
+  unsigned long n_records;
+  unsigned long long  n_dropped;
+} trace_output;
+
+//
+
+void
+trace_print_header(
+  trace_output      *output
+)
+{
+  http_stats_field  i_f;
+
+  printf("time%curl%cmethod%cstatus", output->delim, output->delim, output->delim);
+  for ( i_f = http_stats_field_dns; i_f < http_stats_field_max; i_f++ ) printf("%c%s", output->delim, http_stats_field_get_label(i_f));
+  printf("\n");
+}
+
+//
+
+void
+trace_print_url(
+  trace_output      *output,
+  const char        *url,
+  uint32_t          length
+)
+{
+  //
+  // In CSV the URL is quoted, since nothing stops it from containing commas:
+  //
+  if ( output->delim == ',' ) {
+    putchar('"');
+    while ( length-- ) {
+      if ( *url == '"' ) putchar('"');
+      putchar(*url++);
+    }
+    putchar('"');
+  } else {
+    fwrite(url, 1, length, stdout);
+  }
+}
+
+//
+
+void
+trace_print_record(
+  trace_output        *output,
+  http_trace_header   *header,
+  http_trace_record   *record,
+  trace_url           *urls,
+  unsigned int        n_urls
+)
+{
+  const char          *method = http_ops_method_get_string((http_ops_method)record->method);
+  int                 method_len = 0;
+  http_stats_field    i_f;
+
+  printf("%.6lf%c", header->origin + record->timestamp, output->delim);
+  if ( (record->url_index < n_urls) && urls[record->url_index].url ) {
+    trace_print_url(output, urls[record->url_index].url, urls[record->url_index].length);
+  } else {
+    printf("%u", record->url_index);
+  }
+
+  // The method strings are padded for the verbose listings:
+  if ( method ) {
+    method_len = strlen(method);
+    while ( method_len && (method[method_len - 1] == ' ') ) method_len--;
+  }
+  printf("%c%.*s%c%d", output->delim, method_len, method ? method : "", output->delim, (int)record->http_status);
+  for ( i_f = http_stats_field_dns; i_f < HTTP_TRACE_N_TIMINGS; i_f++ ) printf("%c%g", output->delim, http_trace_record_get_field(record, i_f));
+  printf("%c%llu%c%u\n", output->delim, (unsigned long long)record->content_bytes, output->delim, record->num_connects);
+}
+
+//
+
+bool
+trace_convert(
+  trace_output        *output,
+  const char          *path
+)
+{
+  FILE                *fptr = fopen(path, "rb");
+  uint8_t             bytes[HTTP_TRACE_RECORD_LENGTH];
+  http_trace_header   header;
+  http_trace_trailer  trailer;
+  http_trace_record   record;
+  long                file_size;
+  uint64_t            records_end, n_records, i_r;
+  char                *url_table = NULL;
+  trace_url           *urls = NULL;
+  unsigned int        n_urls = 0;
+  bool                has_trailer = false, ok = false;
+
+  if ( ! fptr ) {
+    fprintf(stderr, "ERROR:  unable to open trace file %s (errno = %d)\n", path, errno);
+    return false;
+  }
+  if ( fread(bytes, HTTP_TRACE_HEADER_LENGTH, 1, fptr) != 1 ) {
+    fprintf(stderr, "ERROR:  %s is not a trace file\n", path);
+    goto early_exit;
+  }
+  http_trace_decode_header(bytes, &header);
+  if ( memcmp(header.magic, HTTP_TRACE_MAGIC, sizeof(header.magic)) ) {
+    fprintf(stderr, "ERROR:  %s is not a trace file\n", path);
+    goto early_exit;
+  }
+  if ( (header.version != HTTP_TRACE_VERSION) || (header.record_length != HTTP_TRACE_RECORD_LENGTH) ) {
+    fprintf(stderr, "ERROR:  %s is a version %u trace file with %u-byte records (expected version %u, %u-byte records)\n",
+        path, header.version, header.record_length, HTTP_TRACE_VERSION, (unsigned int)HTTP_TRACE_RECORD_LENGTH
+      );
+    goto early_exit;
+  }
+  if ( (fseek(fptr, 0, SEEK_END) != 0) || ((file_size = ftell(fptr)) < 0) ) {
+    fprintf(stderr, "ERROR:  unable to determine the size of %s\n", path);
+    goto early_exit;
+  }
+
+  //
+  // Find the URL table by way of the trailer; a trace that was cut short has
+  // neither, and every whole record up to the end of the file is shown:
+  //
+  records_end = file_size;
+  if ( (file_size >= (long)(HTTP_TRACE_HEADER_LENGTH + HTTP_TRACE_TRAILER_LENGTH)) &&
+       (fseek(fptr, file_size - HTTP_TRACE_TRAILER_LENGTH, SEEK_SET) == 0) &&
+       (fread(bytes, HTTP_TRACE_TRAILER_LENGTH, 1, fptr) == 1)
+  ) {
+    http_trace_decode_trailer(bytes, &trailer);
+    has_trailer = (memcmp(trailer.magic, HTTP_TRACE_TRAILER_MAGIC, sizeof(trailer.magic)) == 0) &&
+                  (trailer.url_table_offset >= HTTP_TRACE_HEADER_LENGTH) &&
+                  (trailer.url_table_offset <= file_size - HTTP_TRACE_TRAILER_LENGTH);
+  }
+  if ( has_trailer ) {
+    uint64_t          table_size = file_size - HTTP_TRACE_TRAILER_LENGTH - trailer.url_table_offset;
+
+    records_end = trailer.url_table_offset;
+    output->n_dropped += trailer.dropped;
+    if ( table_size ) {
+      uint64_t        offset = 0, n_alloc = 0;
+
+      if ( ! (url_table = malloc(table_size)) ) {
+        fprintf(stderr, "ERROR:  unable to allocate URL table for %s\n", path);
+        goto early_exit;
+      }
+      if ( (fseek(fptr, trailer.url_table_offset, SEEK_SET) != 0) || (fread(url_table, 1, table_size, fptr) != table_size) ) {
+        fprintf(stderr, "ERROR:  unable to read URL table from %s\n", path);
+        goto early_exit;
+      }
+      while ( offset + sizeof(uint32_t) <= table_size ) {
+        const uint8_t *p = (const uint8_t*)url_table + offset;
+        uint32_t      length = le_get_u32(&p);
+
+        offset += sizeof(length);
+        if ( length > table_size - offset ) break;
+        if ( n_urls == n_alloc ) {
+          trace_url   *new_urls = realloc(urls, (n_alloc += 1024) * sizeof(trace_url));
+
+          if ( ! new_urls ) {
+            fprintf(stderr, "ERROR:  unable to allocate URL table for %s\n", path);
+            goto early_exit;
+          }
+          urls = new_urls;
+        }
+        urls[n_urls].url = length ? url_table + offset : NULL;
+        urls[n_urls].length = length;
+        n_urls++;
+        offset += length;
+      }
+    }
+  } else {
+    fprintf(stderr, "WARNING:  %s has no URL table (the trace was not closed), showing URL indices\n", path);
+  }
+
+  n_records = (records_end - HTTP_TRACE_HEADER_LENGTH) / HTTP_TRACE_RECORD_LENGTH;
+  if ( fseek(fptr, HTTP_TRACE_HEADER_LENGTH, SEEK_SET) != 0 ) {
+    fprintf(stderr, "ERROR:  unable to read records from %s\n", path);
+    goto early_exit;
+  }
+  for ( i_r = 0; i_r < n_records; i_r++ ) {
+    if ( fread(bytes, HTTP_TRACE_RECORD_LENGTH, 1, fptr) != 1 ) {
+      fprintf(stderr, "ERROR:  unable to read record %llu from %s\n", (unsigned long long)i_r, path);
+      goto early_exit;
+    }
+    http_trace_decode_record(bytes, &record);
+    trace_print_record(output, &header, &record, urls, n_urls);
+  }
+  output->n_records += n_records;
+  ok = true;
+
+early_exit:
+  if ( urls ) free((void*)urls);
+  if ( url_table ) free((void*)url_table);
+  fclose(fptr);
+  return ok;
+}
+
+//
+
+int
+main(
+  int               argc,
+  char* const       *argv
+)
+{
+  int               rc = 0, opt;
+  bool              should_show_header = true;
+  trace_output      output = { .delim = ',', .n_records = 0, .n_dropped = 0 };
+
+  while ( (opt = getopt_long(argc, argv, urltest_trace_optstring, urltest_trace_options, NULL)) != -1 ) {
+    switch ( opt ) {
+
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+
+      case 'f':
+        if ( optarg && *optarg ) {
+          if ( strcasecmp(optarg, "csv") == 0 ) {
+            output.delim = ',';
+          } else if ( strcasecmp(optarg, "tsv") == 0 ) {
+            output.delim = '\t';
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --format/-f:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --format/-f option\n");
+          exit(EINVAL);
+        }
+        break;
+
+      case 'n':
+        should_show_header = false;
+        break;
+
+    }
+  }
+
+  if ( optind >= argc ) {
+    usage(argv[0]);
+    exit(EINVAL);
+  }
+
+  if ( should_show_header ) trace_print_header(&output);
+  while ( optind < argc ) {
+    if ( ! trace_convert(&output, argv[optind]) ) rc = EIO;
+    optind++;
+  }
+  if ( output.n_dropped > 0 ) {
+    fprintf(stderr, "WARNING:  %llu requests were dropped from the trace when it was recorded\n", output.n_dropped);
+  }
+  return rc;
+}
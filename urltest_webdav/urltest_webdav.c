@@ -9,12 +9,15 @@
 #include "config.h"
 
 #include <getopt.h>
+#include <pthread.h>
 
 #include <curl/curl.h>
 
 #include "util_fns.h"
 #include "fs_entity.h"
 #include "http_ops.h"
+#include "http_trace.h"
+#include "payload.h"
 
 //
 
@@ -30,6 +33,9 @@ static const struct option urltest_webdav_options[] = {
     { "verbose-curl",     no_argument,          NULL,       'V' },
     { "dry-run",          no_argument,          NULL,       'd' },
     { "show-timings",     optional_argument,    NULL,       't' },
+    { "time-series",      required_argument,    NULL,       'i' },
+    { "progress",         required_argument,    NULL,       'e' },
+    { "trace",            required_argument,    NULL,       'o' },
     { "generations",      required_argument,    NULL,       'g' },
     //
     { "base-url",         required_argument,    NULL,       'U' },
@@ -37,15 +43,21 @@ static const struct option urltest_webdav_options[] = {
     { "username",         required_argument,    NULL,       'u' },
     { "password",         required_argument,    NULL,       'p' },
     { "no-cert-verify",   no_argument,          NULL,       'k' },
+    { "unix-socket",      required_argument,    NULL,       'X' },
     { "no-random-walk",   no_argument,          NULL,       'W' },
     { "no-follow-3xx",    no_argument,          NULL,       'F' },
     { "no-delete",        no_argument,          NULL,       'D' },
     { "ranged-ops",       no_argument,          NULL,       'r' },
     { "no-options",       no_argument,          NULL,       'O' },
+    { "upload-buffer-size", required_argument,  NULL,       'B' },
+    { "synthetic-payload", required_argument,   NULL,       'P' },
+    { "workers",          required_argument,    NULL,       'w' },
+    { "scan-threads",     required_argument,    NULL,       'T' },
+    { "scan-index",       required_argument,    NULL,       'I' },
     { NULL,               0,                    NULL,        0  }
   };
 
-static const char *urltest_webdav_optstring = "h" "lsna" "vVdtg:" "U:m:u:p:kWFDrO";
+static const char *urltest_webdav_optstring = "h" "lsna" "vVdti:e:o:g:" "U:m:u:p:kX:WFDrOB:P:w:T:I:";
 
 //
 
@@ -81,6 +93,20 @@ usage(
       "                                 <out> = <format>{:<path>}\n"
       "                                 <format> = table | csv | tsv\n"
       "\n"
+      "  --time-series/-i <series>    also keep timing statistics per interval of the run and\n"
+      "                               show them as a time series at the end of the run (the\n"
+      "                               most recent 3600 intervals are kept)\n"
+      "\n"
+      "                                 <series> = <seconds>{:<format>{:<path>}}\n"
+      "                                 <format> = table | csv | tsv (default: csv)\n"
+      "\n"
+      "  --progress/-e <seconds>      every <seconds> print the request rate, requests in\n"
+      "                               flight, errors and p50/p99 total time over the last\n"
+      "                               interval to stderr\n"
+      "  --trace/-o <path>            record every request (time, status, timings) to a\n"
+      "                               binary trace file at <path>, written in the background;\n"
+      "                               see urltest_trace to convert it to CSV/TSV (with more\n"
+      "                               than one <entity>, later runs add .2, .3, ... to <path>)\n"
       "  --generations/-g <#>         maximum number of generations to iterate\n"
       "\n"
       "  --base-url/-U <remote URL>   the base URL to which the content should be mirrored;\n"
@@ -103,11 +129,32 @@ usage(
       "                               the password\n"
       "  --no-cert-verify/-k          do not require SSL certificate verfication for connections\n"
       "                               to succeed\n"
+      "  --unix-socket/-X <path>      connect to the server on this Unix domain socket rather\n"
+      "                               than the host and port in each URL\n"
       "  --no-random-walk/-W          process the file list as a simple depth-first traversal\n"
       "  --no-follow-3xx/-F           do not automatically follow HTTP 3XX redirects\n"
       "  --no-delete/-D               do not delete anything on the remote side\n"
       "  --ranged-ops/-r              enable ranged GET operations\n"
       "  --no-options/-O              disable OPTIONS operations\n"
+      "  --upload-buffer-size/-B <#>  size (in bytes) of the buffer cURL uses to send PUT\n"
+      "                               bodies; a k, M, or G suffix scales by powers of 1024\n"
+      "                               (default: cURL's own)\n"
+      "  --synthetic-payload/-P <gen> do not read file content from disk; PUT bodies are\n"
+      "                               instead generated on the fly, seeded by each URL, with\n"
+      "                               the size of the local file\n"
+      "\n"
+      "                                 <gen> = <seed>{:<compressibility>}\n"
+      "                                 <compressibility> = 0.0 (default, incompressible)\n"
+      "                                                     through 1.0\n"
+      "\n"
+      "  --workers/-w <#>             number of operations to keep in flight at once; a\n"
+      "                               directory is never operated on while one of its\n"
+      "                               children is, and vice versa (default: 1)\n"
+      "  --scan-threads/-T <#>        number of threads reading local directories at once\n"
+      "                               (default: number of CPUs)\n"
+      "  --scan-index/-I <path>       save the scanned file hierarchy to <path> and reuse\n"
+      "                               it on later runs, re-reading only directories that\n"
+      "                               have been modified\n"
       "\n"
       " environment:\n"
       "\n"
@@ -197,6 +244,509 @@ http_error_exit(
 typedef fs_entity* (*fs_entity_list_node_selector_fn)(fs_entity_list *the_list, unsigned int max_generation);
 
 //
+// Everything an operation needs to know about the run; when several workers
+// are running, lock serializes their access to the entity list and stdout:
+//
+
+typedef struct {
+  fs_entity_list            *fslist;
+  payload_generator_ref     payload;
+  bool                      is_verbose;
+  bool                      is_dry_run;
+  bool                      is_random_walk;
+  fs_entity_print_format    print_format;
+  unsigned int              generations;
+  unsigned int              current_generation;
+  http_stats_series_ref     series;
+  http_trace_ref            trace;
+  pthread_mutex_t           *lock;
+  pthread_cond_t            *released;
+  bool                      is_done;
+} webdav_context;
+
+//
+
+http_stats_ref
+webdav_entity_stats(
+  webdav_context    *ctx,
+  fs_entity         *e,
+  http_ops_method   method
+)
+{
+  http_stats_ref    stats;
+  
+  if ( ctx->lock ) pthread_mutex_lock(ctx->lock);
+  stats = fs_entity_list_stats_for_entity(ctx->fslist, e, method);
+  if ( ctx->lock ) pthread_mutex_unlock(ctx->lock);
+  return stats;
+}
+
+//
+
+void
+webdav_entity_apply_options(
+  webdav_context    *ctx,
+  fs_entity         *e,
+  bool              has_propfind,
+  bool              has_delete
+)
+{
+  if ( ctx->lock ) pthread_mutex_lock(ctx->lock);
+  if ( ! has_propfind ) {
+    // If this was the root entity, then disable in general:
+    if ( e == ctx->fslist->root_entity ) {
+      fs_entity_list_set_state_is_enabled(ctx->fslist, fs_entity_state_getinfo, false);
+    } else {
+      fs_entity_set_state_is_enabled(e, fs_entity_state_getinfo, false);
+    }
+  }
+  if ( ! has_delete ) {
+    // If this was the root entity, then disable in general:
+    if ( e == ctx->fslist->root_entity ) {
+      fs_entity_list_set_state_is_enabled(ctx->fslist, fs_entity_state_delete, false);
+      fs_entity_list_set_state_is_enabled(ctx->fslist, fs_entity_state_delete_sub, false);
+    } else {
+      fs_entity_set_state_is_enabled(e, fs_entity_state_delete, false);
+      fs_entity_set_state_is_enabled(e, fs_entity_state_delete_sub, false);
+    }
+  }
+  if ( ctx->lock ) pthread_mutex_unlock(ctx->lock);
+}
+
+//
+
+void
+webdav_entity_trace(
+  webdav_context    *ctx,
+  fs_entity         *e,
+  http_ops_method   method,
+  long              http_status,
+  http_stats_record *req_stats
+)
+{
+  //
+  // A positive status means the request completed and req_stats was filled-in:
+  //
+  if ( ctx->trace ) {
+    http_trace_add(ctx->trace, (unsigned int)(e - ctx->fslist->root_entity), method, http_status, (http_status > 0) ? req_stats : NULL);
+  }
+}
+
+//
+
+bool
+webdav_entity_perform(
+  webdav_context    *ctx,
+  http_ops_ref      http_ops,
+  fs_entity         *e
+)
+{
+  const char        *url;
+  bool              ok = false;
+  long              http_status = -1L;
+  http_stats_record req_stats;
+  
+  if ( ctx->is_dry_run ) {
+    if ( ctx->print_format ) {
+      if ( ctx->lock ) pthread_mutex_lock(ctx->lock);
+      fs_entity_print(ctx->print_format, ctx->fslist, e);
+      if ( ctx->lock ) pthread_mutex_unlock(ctx->lock);
+    }
+    return true;
+  }
+  
+  url = fs_entity_list_url_for_entity(ctx->fslist, e);
+  if ( ! url ) {
+    fprintf(stderr, "CATASTROPHIC ERROR:  unable to generate URL for %s (errno = %d)\n", fs_entity_list_name_for_entity(ctx->fslist, e), errno);
+    exit(errno);
+  }
+  
+  switch ( e->kind ) {
+    
+    case fs_entity_kind_directory: {
+      switch ( e->state ) {
+        case fs_entity_state_upload: {
+          ok = http_ops_mkdir(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_mkcol), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_mkcol, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+                if ( http_status == 405 ) {
+                  // Directory already exists, that's okay:
+                  break;
+                }
+                // fallthrough
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_options: {
+          bool    has_propfind = false, has_delete = false;
+          
+          ok = http_ops_options(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_options), &req_stats, &http_status, &has_propfind, &has_delete);
+          webdav_entity_trace(ctx, e, http_ops_method_options, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+              case 2:
+                webdav_entity_apply_options(ctx, e, has_propfind, has_delete);
+                break;
+                
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_getinfo: {
+          ok = http_ops_getinfo(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_propfind), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_propfind, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_download: {
+          ok = http_ops_download(http_ops, url, NULL, webdav_entity_stats(ctx, e, http_ops_method_get), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_get, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_delete: {
+          ok = http_ops_delete(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_delete), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_delete, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_download_range:
+        case fs_entity_state_download_sub:
+        case fs_entity_state_upload_sub:
+        case fs_entity_state_delete_sub:
+        case fs_entity_state_max:
+          fprintf(stderr, "CATASTOPHIC ERROR:  directory state flow should not reach this state!!\n");
+          exit(EINVAL);
+          break;
+      }
+      break;
+    }
+    
+    case fs_entity_kind_file: {
+      switch ( e->state ) {
+        case fs_entity_state_upload: {
+          if ( ctx->payload ) {
+            ok = http_ops_upload_payload(http_ops, ctx->payload, (long long)e->size, url, webdav_entity_stats(ctx, e, http_ops_method_put), &req_stats, &http_status);
+            webdav_entity_trace(ctx, e, http_ops_method_put, http_status, &req_stats);
+          } else {
+            const char  *path = fs_entity_list_path_for_entity(ctx->fslist, e);
+            
+            ok = path && http_ops_upload_with_length(http_ops, path, (long long)e->size, url, webdav_entity_stats(ctx, e, http_ops_method_put), &req_stats, &http_status);
+            webdav_entity_trace(ctx, e, http_ops_method_put, http_status, &req_stats);
+            if ( path ) free((void*)path);
+          }
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+                
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_options: {
+          bool    has_propfind = false, has_delete = false;
+          
+          ok = http_ops_options(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_options), &req_stats, &http_status, &has_propfind, &has_delete);
+          webdav_entity_trace(ctx, e, http_ops_method_options, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+              case 2:
+                webdav_entity_apply_options(ctx, e, has_propfind, has_delete);
+                break;
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_getinfo: {
+          ok = http_ops_getinfo(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_propfind), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_propfind, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_download: {
+          ok = http_ops_download(http_ops, url, NULL, webdav_entity_stats(ctx, e, http_ops_method_get), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_get, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_download_range: {
+          ok = http_ops_download_range(http_ops, url, NULL, webdav_entity_stats(ctx, e, http_ops_method_get), &req_stats, &http_status, (long int)e->size);
+          webdav_entity_trace(ctx, e, http_ops_method_get, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_delete: {
+          ok = http_ops_delete(http_ops, url, webdav_entity_stats(ctx, e, http_ops_method_delete), &req_stats, &http_status);
+          webdav_entity_trace(ctx, e, http_ops_method_delete, http_status, &req_stats);
+          if ( ok ) {
+            switch ( http_status / 100 ) {
+            
+              case 4:
+              case 5:
+                http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
+                ok = false;
+                break;
+                
+            }
+          }
+          break;
+        }
+        
+        case fs_entity_state_upload_sub:
+        case fs_entity_state_download_sub:
+        case fs_entity_state_delete_sub:
+        case fs_entity_state_max:
+          fprintf(stderr, "CATASTOPHIC ERROR:  file state flow should not reach this state!!\n");
+          exit(EINVAL);
+          break;
+      }
+      break;
+    }
+    
+    case fs_entity_kind_max:
+      break;
+  
+  }
+  
+  if ( ctx->is_verbose ) {
+    if ( ctx->lock ) pthread_mutex_lock(ctx->lock);
+    printf("%-3ld ", http_status);
+    if ( ctx->print_format ) {
+      fs_entity_print(ctx->print_format, ctx->fslist, e);
+    } else {
+      printf("%s\n", url);
+    }
+    if ( ctx->lock ) pthread_mutex_unlock(ctx->lock);
+  }
+  return ok;
+}
+
+//
+
+typedef struct {
+  webdav_context    *ctx;
+  http_ops_ref      http_ops;
+  http_stats_series_ref series;
+  pthread_t         thread;
+} webdav_worker;
+
+//
+
+void*
+webdav_worker_run(
+  void              *context
+)
+{
+  webdav_worker     *worker = (webdav_worker*)context;
+  webdav_context    *ctx = worker->ctx;
+  
+  pthread_mutex_lock(ctx->lock);
+  while ( ! ctx->is_done ) {
+    bool            is_blocked;
+    fs_entity       *e = fs_entity_list_claim_node(ctx->fslist, ctx->generations, ctx->is_random_walk, &is_blocked);
+    
+    if ( e ) {
+      bool          ok;
+      
+      if ( ctx->is_verbose && (ctx->fslist->generation == ctx->current_generation) ) {
+        printf("Generation %u completed\n", ctx->current_generation++);
+      }
+      pthread_mutex_unlock(ctx->lock);
+      ok = webdav_entity_perform(ctx, worker->http_ops, e);
+      pthread_mutex_lock(ctx->lock);
+      fs_entity_list_release_node(ctx->fslist, e, ok);
+      pthread_cond_broadcast(ctx->released);
+    } else if ( is_blocked ) {
+      //
+      // Everything that's ready is already in flight, wait for something
+      // to finish:
+      //
+      pthread_cond_wait(ctx->released, ctx->lock);
+    } else {
+      ctx->is_done = true;
+      pthread_cond_broadcast(ctx->released);
+    }
+  }
+  pthread_mutex_unlock(ctx->lock);
+  return NULL;
+}
+
+//
+
+void
+webdav_run_workers(
+  webdav_context    *ctx,
+  http_ops_ref      http_ops,
+  unsigned int      n_workers
+)
+{
+  webdav_worker     *workers = malloc(n_workers * sizeof(webdav_worker));
+  pthread_mutex_t   lock = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t    released = PTHREAD_COND_INITIALIZER;
+  unsigned int      i_w;
+  int               rc;
+  
+  if ( ! workers ) {
+    fprintf(stderr, "ERROR:  unable to allocate %u workers\n", n_workers);
+    exit(ENOMEM);
+  }
+  ctx->lock = &lock;
+  ctx->released = &released;
+  ctx->is_done = false;
+  
+  //
+  // Each worker gets its own copy of the cURL setup and of the time series,
+  // which is merged back into the context's when the worker is done:
+  //
+  for ( i_w = 0; i_w < n_workers; i_w++ ) {
+    workers[i_w].ctx = ctx;
+    workers[i_w].series = NULL;
+    if ( ! (workers[i_w].http_ops = http_ops_create_copy(http_ops)) ) {
+      fprintf(stderr, "ERROR:  unable to allocate worker %u\n", i_w);
+      exit(ENOMEM);
+    }
+    if ( ctx->series ) {
+      if ( ! (workers[i_w].series = http_stats_series_create_like(ctx->series)) ) {
+        fprintf(stderr, "ERROR:  unable to allocate worker %u\n", i_w);
+        exit(ENOMEM);
+      }
+      http_ops_set_stats_series(workers[i_w].http_ops, workers[i_w].series);
+    }
+  }
+  for ( i_w = 0; i_w < n_workers; i_w++ ) {
+    if ( (rc = pthread_create(&workers[i_w].thread, NULL, webdav_worker_run, &workers[i_w])) != 0 ) {
+      fprintf(stderr, "ERROR:  unable to start worker %u (errno = %d)\n", i_w, rc);
+      exit(rc);
+    }
+  }
+  for ( i_w = 0; i_w < n_workers; i_w++ ) {
+    pthread_join(workers[i_w].thread, NULL);
+    http_ops_destroy(workers[i_w].http_ops);
+    if ( workers[i_w].series ) {
+      http_stats_series_merge(ctx->series, workers[i_w].series);
+      http_stats_series_destroy(workers[i_w].series);
+    }
+  }
+  free((void*)workers);
+  ctx->lock = NULL;
+  ctx->released = NULL;
+  pthread_mutex_destroy(&lock);
+  pthread_cond_destroy(&released);
+}
+
+//
+
+const char*
+webdav_trace_url(
+  void              *context,
+  unsigned int      index,
+  size_t            *length
+)
+{
+  fs_entity_list    *fslist = (fs_entity_list*)context;
+  const char        *url = fs_entity_list_url_for_entity(fslist, &fslist->root_entity[index]);
+  
+  *length = url ? strlen(url) : 0;
+  return url;
+}
+
 
 int
 main(
@@ -220,6 +770,18 @@ main(
   const char                *base_url = NULL;
   http_ops_ref              http_ops = http_ops_create();
   const char								*timing_output = NULL;
+  double                    series_interval = 0.0;
+  http_stats_format         series_format = http_stats_format_csv;
+  const char                *series_output = NULL;
+  double                    progress_interval = 0.0;
+  http_progress_ref         progress = NULL;
+  const char                *trace_path = NULL;
+  unsigned int              trace_run = 0;
+  payload_generator_ref     payload = NULL;
+  unsigned int              n_workers = 1;
+  unsigned int              scan_threads = 0;
+  const char                *scan_index = NULL;
+  webdav_context            ctx;
   
   if ( getenv("URLTEST_WEBDAV_USER") ) {
     http_ops_set_username(http_ops, getenv("URLTEST_WEBDAV_USER"));
@@ -292,6 +854,65 @@ main(
         break;
       }
       
+      case 'e': {
+        if ( optarg && *optarg ) {
+          char      *endp;
+          
+          progress_interval = strtod(optarg, &endp);
+          if ( (endp == optarg) || *endp || (progress_interval <= 0.0) ) {
+            fprintf(stderr, "ERROR:  invalid argument to --progress/-e:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --progress/-e option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'o': {
+        if ( optarg && *optarg ) {
+          trace_path = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --trace/-o option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'i': {
+        if ( optarg && *optarg ) {
+          char      *endp;
+          
+          series_interval = strtod(optarg, &endp);
+          if ( (endp == optarg) || (series_interval <= 0.0) || (*endp && (*endp != ':')) ) {
+            fprintf(stderr, "ERROR:  invalid time series specification: %s\n", optarg);
+            exit(EINVAL);
+          }
+          if ( *endp == ':' ) {
+            const char  *format = endp + 1;
+            const char  *colon = strchr(format, ':');
+            size_t      format_len = colon ? (size_t)(colon - format) : strlen(format);
+            
+            if ( (format_len > 0) && (strncasecmp(format, "table", format_len) == 0) ) {
+              series_format = http_stats_format_table;
+            } else if ( (format_len > 0) && (strncasecmp(format, "csv", format_len) == 0) ) {
+              series_format = http_stats_format_csv;
+            } else if ( (format_len > 0) && (strncasecmp(format, "tsv", format_len) == 0) ) {
+              series_format = http_stats_format_tsv;
+            } else {
+              fprintf(stderr, "ERROR:  invalid time series specification: %s\n", optarg);
+              exit(EINVAL);
+            }
+            if ( colon ) series_output = colon + 1;
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --time-series/-i option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
       case 'g': {
         if ( optarg && *optarg ) {
           char          *endp;
@@ -369,6 +990,19 @@ main(
       case 'k':
         http_ops_set_ssl_verify_peer(http_ops, false);
         break;
+
+      case 'X': {
+        if ( optarg && *optarg ) {
+          if ( ! http_ops_set_unix_socket_path(http_ops, optarg) ) {
+            fprintf(stderr, "ERROR:  unable to set Unix domain socket path (errno = %d)\n", errno);
+            exit(errno);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --unix-socket/-X option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
         
       case 'W':
         should_do_random_walk = false;
@@ -390,6 +1024,113 @@ main(
         should_do_options = false;
         break;
       
+      case 'P': {
+        if ( optarg && *optarg ) {
+          char                *endp;
+          unsigned long long  seed = strtoull(optarg, &endp, 0);
+          double              compressibility = 0.0;
+          
+          if ( (endp > optarg) && (*endp == ':') ) {
+            char              *s = endp + 1;
+            
+            compressibility = strtod(s, &endp);
+            if ( (endp == s) || (compressibility < 0.0) || (compressibility > 1.0) ) endp = s;
+          }
+          if ( (endp == optarg) || (*endp != '\0') ) {
+            fprintf(stderr, "ERROR:  invalid argument to --synthetic-payload/-P:  %s\n", optarg);
+            exit(EINVAL);
+          }
+          if ( payload ) payload_generator_destroy(payload);
+          if ( ! (payload = payload_generator_create(seed, 0, compressibility)) ) {
+            fprintf(stderr, "ERROR:  unable to allocate synthetic payload buffer\n");
+            exit(ENOMEM);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --synthetic-payload/-P option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'w': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          if ( (value > 0) && (endp > optarg) && (*endp == '\0') ) {
+            n_workers = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --workers/-w:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --workers/-w option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'T': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          if ( (value > 0) && (endp > optarg) && (*endp == '\0') ) {
+            scan_threads = value;
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --scan-threads/-T:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --scan-threads/-T option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'I': {
+        if ( optarg && *optarg ) {
+          scan_index = optarg;
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --scan-index/-I option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
+      case 'B': {
+        if ( optarg && *optarg ) {
+          char          *endp;
+          long          value = strtol(optarg, &endp, 10);
+          
+          switch ( *endp ) {
+            case 'g':
+            case 'G':
+              value *= 1024;
+              // fallthrough
+            case 'm':
+            case 'M':
+              value *= 1024;
+              // fallthrough
+            case 'k':
+            case 'K':
+              value *= 1024;
+              endp++;
+              break;
+          }
+          if ( (value > 0) && (endp > optarg) && (*endp == '\0') ) {
+            http_ops_set_upload_buffer_size(http_ops, value);
+          } else {
+            fprintf(stderr, "ERROR:  invalid argument to --upload-buffer-size/-B:  %s\n", optarg);
+            exit(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "ERROR:  no argument provided with --upload-buffer-size/-B option\n");
+          exit(EINVAL);
+        }
+        break;
+      }
+      
     }
   }
   
@@ -400,17 +1141,24 @@ main(
   
   if ( should_do_random_walk ) init_random_long();
   
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.payload = payload;
+  ctx.is_verbose = is_verbose;
+  ctx.is_dry_run = is_dry_run;
+  ctx.is_random_walk = should_do_random_walk;
+  ctx.print_format = print_format | print_charset;
+  ctx.generations = generations;
+  
   if ( is_verbose && base_url ) {
     printf("\nMirroring content to '%s'\n", base_url);
   }
   
   while ( optind < argc ) {
     int                                   delta_optind = 1;
-    fs_entity_list                        *fslist = fs_entity_list_create_with_path(argv[optind]);
+    fs_entity_list                        *fslist = fs_entity_list_create_with_path(argv[optind], scan_threads, scan_index);
     
     if ( fslist ) {
       fs_entity                           *e;
-      unsigned int                        current_generation = 1;
       const char                          *real_base_url = base_url;
       bool                                is_local_real_base_url = false;
       fs_entity_list_node_selector_fn     node_selector = should_do_random_walk ? fs_entity_list_random_node : fs_entity_list_next_node;
@@ -477,295 +1225,57 @@ main(
         printf("\nCommencing %u iteration%s...\n", generations, (generations == 1) ? "" : "s");
       }
       
-      while ( (e = node_selector(fslist, generations)) ) {
-        if ( is_verbose && (fslist->generation == current_generation) ) {
-          printf("Generation %u completed\n", current_generation++);
+      if ( ! is_dry_run && ! fs_entity_list_set_base_url(fslist, real_base_url) ) {
+        fprintf(stderr, "ERROR:  unable to allocate URLs for %s\n", argv[optind]);
+        exit(ENOMEM);
+      }
+      ctx.fslist = fslist;
+      ctx.current_generation = 1;
+      ctx.series = NULL;
+      if ( series_interval > 0.0 && ! is_dry_run ) {
+        if ( ! (ctx.series = http_stats_series_create(monotonic_seconds(), series_interval, 0)) ) {
+          fprintf(stderr, "ERROR:  unable to allocate time series\n");
+          exit(ENOMEM);
         }
-        if ( ! is_dry_run ) {
-          const char  *url = fs_entity_list_url_for_entity(fslist, real_base_url, e);
-          
-          if ( url ) {
-            bool      ok = false;
-            long      http_status = -1L;
-            
-            switch ( e->kind ) {
-              
-              case fs_entity_kind_directory: {
-                switch ( e->state ) {
-                  case fs_entity_state_upload: {
-                    ok = http_ops_mkdir(http_ops, url, e->http_stats[http_ops_method_mkcol], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                          if ( http_status == 405 ) {
-                            // Directory already exists, that's okay:
-                            break;
-                          }
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_options: {
-                    bool    has_propfind = false, has_delete = false;
-                    
-                    ok = http_ops_options(http_ops, url, e->http_stats[http_ops_method_options], NULL, &http_status, &has_propfind, &has_delete);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                        case 2:
-                          if ( ! has_propfind ) {
-                            // If this was the root entity, then disable in general:
-                            if ( e == fslist->root_entity ) {
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_getinfo, false);
-                            } else {
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_getinfo, false);
-                            }
-                          }
-                          if ( ! has_delete ) {
-                            // If this was the root entity, then disable in general:
-                            if ( e == fslist->root_entity ) {
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_delete, false);
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_delete_sub, false);
-                            } else {
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_delete, false);
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_delete_sub, false);
-                            }
-                          }
-                          break;
-                          
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_getinfo: {
-                    ok = http_ops_getinfo(http_ops, url, e->http_stats[http_ops_method_propfind], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_download: {
-                    ok = http_ops_download(http_ops, url, NULL, e->http_stats[http_ops_method_get], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_delete: {
-                    ok = http_ops_delete(http_ops, url, e->http_stats[http_ops_method_delete], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_download_range:
-                  case fs_entity_state_download_sub:
-                  case fs_entity_state_upload_sub:
-                  case fs_entity_state_delete_sub:
-                  case fs_entity_state_max:
-                    fprintf(stderr, "CATASTOPHIC ERROR:  directory state flow should not reach this state!!\n");
-                    exit(EINVAL);
-                    break;
-                }
-                break;
-              }
-              
-              case fs_entity_kind_file: {
-                switch ( e->state ) {
-                  case fs_entity_state_upload: {
-                    ok = http_ops_upload(http_ops, e->path, url, e->http_stats[http_ops_method_put], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                          
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_options: {
-                    bool    has_propfind = false, has_delete = false;
-                    
-                    ok = http_ops_options(http_ops, url, e->http_stats[http_ops_method_options], NULL, &http_status, &has_propfind, &has_delete);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                        case 2:
-                          if ( ! has_propfind ) {
-                            // If this was the root entity, then disable in general:
-                            if ( e == fslist->root_entity ) {
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_getinfo, false);
-                            } else {
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_getinfo, false);
-                            }
-                          }
-                          if ( ! has_delete ) {
-                            // If this was the root entity, then disable in general:
-                            if ( e == fslist->root_entity ) {
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_delete, false);
-                              fs_entity_list_set_state_is_enabled(fslist, fs_entity_state_delete_sub, false);
-                            } else {
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_delete, false);
-                              fs_entity_set_state_is_enabled(e, fs_entity_state_delete_sub, false);
-                            }
-                          }
-                          break;
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_getinfo: {
-                    ok = http_ops_getinfo(http_ops, url, e->http_stats[http_ops_method_propfind], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_download: {
-                    ok = http_ops_download(http_ops, url, NULL, e->http_stats[http_ops_method_get], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_download_range: {
-                    ok = http_ops_download_range(http_ops, url, NULL, e->http_stats[http_ops_method_get], NULL, &http_status, (long int)e->size);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_delete: {
-                    ok = http_ops_delete(http_ops, url, e->http_stats[http_ops_method_delete], NULL, &http_status);
-                    if ( ok ) {
-                      switch ( http_status / 100 ) {
-                      
-                        case 4:
-                        case 5:
-                          http_error_exit(url, http_status, http_ops_get_error_buffer(http_ops));
-                          ok = false;
-                          break;
-                          
-                      }
-                    }
-                    break;
-                  }
-                  
-                  case fs_entity_state_upload_sub:
-                  case fs_entity_state_download_sub:
-                  case fs_entity_state_delete_sub:
-                  case fs_entity_state_max:
-                    fprintf(stderr, "CATASTOPHIC ERROR:  file state flow should not reach this state!!\n");
-                    exit(EINVAL);
-                    break;
-                }
-                break;
-              }
-              
-              case fs_entity_kind_max:
-                break;
-            
-            }
-            if ( is_verbose ) {
-              printf("%-3ld ", http_status);
-              if ( print_format ) {
-                fs_entity_print(print_format | print_charset, e);
-              } else {
-                printf("%s\n", url);
-              }
-            }
-            free((void*)url);
-            if ( ok ) fs_entity_list_advance_entity_state(fslist, e);
-          } else {
-            fprintf(stderr, "CATASTROPHIC ERROR:  unable to generate URL for %s (errno = %d)\n", e->path, errno);
-            exit(errno);
+      }
+      ctx.trace = NULL;
+      if ( trace_path && ! is_dry_run ) {
+        char        *run_trace_path = NULL;
+        
+        if ( trace_run++ == 0 ) {
+          ctx.trace = http_trace_create(trace_path, 0);
+        } else if ( asprintf(&run_trace_path, "%s.%u", trace_path, trace_run) > 0 ) {
+          ctx.trace = http_trace_create(run_trace_path, 0);
+          free((void*)run_trace_path);
+        }
+        if ( ! ctx.trace ) {
+          fprintf(stderr, "ERROR:  unable to create trace file for %s (errno = %d)\n", argv[optind], errno);
+          exit(errno ? errno : ENOMEM);
+        }
+      }
+      if ( progress_interval > 0.0 && ! is_dry_run ) {
+        if ( ! progress && ! (progress = http_progress_create()) ) {
+          fprintf(stderr, "ERROR:  unable to allocate progress counters\n");
+          exit(ENOMEM);
+        }
+        http_ops_set_progress(http_ops, progress);
+        http_progress_reporter_start(progress, progress_interval, stderr);
+      }
+      if ( n_workers > 1 ) {
+        webdav_run_workers(&ctx, http_ops, n_workers);
+      } else {
+        http_ops_set_stats_series(http_ops, ctx.series);
+        while ( (e = node_selector(fslist, generations)) ) {
+          if ( is_verbose && (fslist->generation == ctx.current_generation) ) {
+            printf("Generation %u completed\n", ctx.current_generation++);
           }
-        } else {
-          if ( print_format ) fs_entity_print(print_format | print_charset, e);
-          fs_entity_list_advance_entity_state(fslist, e);
+          if ( webdav_entity_perform(&ctx, http_ops, e) ) fs_entity_list_advance_entity_state(fslist, e);
         }
+        http_ops_set_stats_series(http_ops, NULL);
       }
+      if ( progress ) http_progress_reporter_stop(progress);
       if ( is_verbose ) {
-        printf("Generation %u completed\n", current_generation);
+        printf("Generation %u completed\n", ctx.current_generation);
       }
       if ( ! is_dry_run && should_show_timings ) {
 				if ( ! timing_output ) {
@@ -783,10 +1293,46 @@ main(
         	}
         }
       }
+      if ( ctx.series ) {
+        if ( http_stats_series_get_dropped(ctx.series) > 0 ) {
+          fprintf(stderr, "WARNING:  %llu requests completed too early in the run to be kept in the time series\n", http_stats_series_get_dropped(ctx.series));
+        }
+        if ( ! series_output ) {
+          printf("\nTime series (%g s intervals):\n\n", series_interval);
+          http_stats_series_print(series_format, 0, ctx.series);
+        } else {
+          FILE      *series_fptr = fopen(series_output, "w");
+          
+          if ( series_fptr ) {
+            http_stats_series_fprint(series_fptr, series_format, 0, ctx.series);
+            fclose(series_fptr);
+          } else {
+            fprintf(stderr, "ERROR:  unable to open time series file for writing: %s\n", series_output);
+            rc = errno;
+          }
+        }
+        http_stats_series_destroy(ctx.series);
+        ctx.series = NULL;
+      }
+      if ( ctx.trace ) {
+        if ( http_trace_get_dropped(ctx.trace) > 0 ) {
+          fprintf(stderr, "WARNING:  %llu requests were not traced because the trace writer fell behind\n", http_trace_get_dropped(ctx.trace));
+        }
+        if ( ! http_trace_close(ctx.trace, fslist->count, webdav_trace_url, fslist) ) {
+          fprintf(stderr, "ERROR:  unable to write trace file for %s\n", argv[optind]);
+          rc = EIO;
+        }
+        ctx.trace = NULL;
+      }
       fs_entity_list_destroy(fslist);
       if ( is_local_real_base_url ) free((void*)real_base_url);
     }
     optind += delta_optind;
   }
+  if ( payload ) payload_generator_destroy(payload);
+  if ( progress ) {
+    http_ops_set_progress(http_ops, NULL);
+    http_progress_destroy(progress);
+  }
   return rc;
 }